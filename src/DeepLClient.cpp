@@ -0,0 +1,204 @@
+#include "DeepLClient.h"
+#include <iostream>
+#include <stdexcept>
+
+DeepLClient& DeepLClient::shared() {
+    static DeepLClient client;
+    return client;
+}
+
+DeepLClient::DeepLClient() {
+    curl_global_init(CURL_GLOBAL_ALL);
+    multi = curl_multi_init();
+    if (!multi) {
+        throw std::runtime_error("Failed to initialize curl multi handle.");
+    }
+    // Let several requests to the same host share one connection when HTTP/2 is available
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    worker = std::thread([this]() { eventLoop(); });
+}
+
+DeepLClient::~DeepLClient() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    curl_multi_wakeup(multi);
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    // Anything still pending fails instead of leaving a future that never resolves
+    for (auto& entry : active) {
+        curl_multi_remove_handle(multi, entry.first);
+        entry.second->response.curlCode = CURLE_ABORTED_BY_CALLBACK;
+        entry.second->response.error = "DeepL client shut down";
+        entry.second->promise.set_value(entry.second->response);
+        releaseRequest(*entry.second);
+    }
+    for (auto& request : queued) {
+        request->response.curlCode = CURLE_ABORTED_BY_CALLBACK;
+        request->response.error = "DeepL client shut down";
+        request->promise.set_value(request->response);
+        releaseRequest(*request);
+    }
+
+    curl_multi_cleanup(multi);
+    curl_global_cleanup();
+}
+
+size_t DeepLClient::writeCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
+    size_t totalSize = size * nmemb;
+    output->append((char*)contents, totalSize);
+    return totalSize;
+}
+
+std::unique_ptr<DeepLClient::Request> DeepLClient::createRequest(const std::string& url, const std::string& deepLKey, const DeepLTransferLimits& limits) {
+    auto request = std::make_unique<Request>();
+    request->easy = curl_easy_init();
+    if (!request->easy) {
+        return request;
+    }
+
+    request->headers = curl_slist_append(request->headers, ("Authorization: DeepL-Auth-Key " + deepLKey).c_str());
+
+    curl_easy_setopt(request->easy, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(request->easy, CURLOPT_WRITEFUNCTION, writeCallback);
+    curl_easy_setopt(request->easy, CURLOPT_WRITEDATA, &request->response.body);
+    curl_easy_setopt(request->easy, CURLOPT_PRIVATE, request.get());
+    curl_easy_setopt(request->easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(request->easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(request->easy, CURLOPT_NOSIGNAL, 1L);
+
+    // A stalled connection would otherwise never finish its transfer
+    curl_easy_setopt(request->easy, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(limits.connectTimeout.count()));
+    curl_easy_setopt(request->easy, CURLOPT_TIMEOUT_MS, static_cast<long>(limits.timeout.count()));
+    const long stallSeconds = static_cast<long>(std::chrono::duration_cast<std::chrono::seconds>(limits.stallTimeout).count());
+    if (stallSeconds > 0) {
+        curl_easy_setopt(request->easy, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        curl_easy_setopt(request->easy, CURLOPT_LOW_SPEED_TIME, stallSeconds);
+    }
+    return request;
+}
+
+std::future<DeepLResponse> DeepLClient::uploadDocument(const std::string& url, const std::string& deepLKey, const std::string& filePath, const std::string& targetLang, const DeepLTransferLimits& limits) {
+    auto request = createRequest(url, deepLKey, limits);
+    if (request->easy) {
+        // Prepare the multipart form data
+        request->form = curl_mime_init(request->easy);
+        curl_mimepart* field = curl_mime_addpart(request->form);
+        curl_mime_name(field, "target_lang");
+        curl_mime_data(field, targetLang.c_str(), CURL_ZERO_TERMINATED);
+        field = curl_mime_addpart(request->form);
+        curl_mime_name(field, "file");
+        curl_mime_filedata(field, filePath.c_str());
+
+        curl_easy_setopt(request->easy, CURLOPT_HTTPHEADER, request->headers);
+        curl_easy_setopt(request->easy, CURLOPT_MIMEPOST, request->form);
+    }
+    return submit(std::move(request));
+}
+
+std::future<DeepLResponse> DeepLClient::postJson(const std::string& url, const std::string& deepLKey, const std::string& jsonBody, const DeepLTransferLimits& limits) {
+    auto request = createRequest(url, deepLKey, limits);
+    if (request->easy) {
+        request->headers = curl_slist_append(request->headers, "Content-Type: application/json");
+        request->postBody = jsonBody;
+
+        curl_easy_setopt(request->easy, CURLOPT_HTTPHEADER, request->headers);
+        curl_easy_setopt(request->easy, CURLOPT_POSTFIELDS, request->postBody.c_str());
+        curl_easy_setopt(request->easy, CURLOPT_POSTFIELDSIZE, static_cast<long>(request->postBody.size()));
+    }
+    return submit(std::move(request));
+}
+
+std::future<DeepLResponse> DeepLClient::submit(std::unique_ptr<Request> request) {
+    std::future<DeepLResponse> future = request->promise.get_future();
+
+    if (!request->easy) {
+        request->response.curlCode = CURLE_FAILED_INIT;
+        request->response.error = "Failed to initialize CURL.";
+        request->promise.set_value(request->response);
+        releaseRequest(*request);
+        return future;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queued.push_back(std::move(request));
+    }
+    curl_multi_wakeup(multi);
+    return future;
+}
+
+void DeepLClient::eventLoop() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                return;
+            }
+            // Easy handles are only touched by this thread once queued
+            while (!queued.empty()) {
+                std::unique_ptr<Request> request = std::move(queued.front());
+                queued.pop_front();
+                curl_multi_add_handle(multi, request->easy);
+                active.emplace(request->easy, std::move(request));
+            }
+        }
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        int messagesLeft = 0;
+        while (CURLMsg* message = curl_multi_info_read(multi, &messagesLeft)) {
+            if (message->msg == CURLMSG_DONE) {
+                finishRequest(message->easy_handle, message->data.result);
+            }
+        }
+
+        curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+    }
+}
+
+void DeepLClient::finishRequest(CURL* easy, CURLcode result) {
+    curl_multi_remove_handle(multi, easy);
+
+    std::unique_ptr<Request> request;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = active.find(easy);
+        if (it == active.end()) {
+            return;
+        }
+        request = std::move(it->second);
+        active.erase(it);
+    }
+
+    request->response.curlCode = result;
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &request->response.httpStatus);
+    if (result != CURLE_OK) {
+        request->response.error = curl_easy_strerror(result);
+    }
+
+    // The connection stays in the multi handle's cache for the next request
+    DeepLResponse response = std::move(request->response);
+    releaseRequest(*request);
+    request->promise.set_value(std::move(response));
+}
+
+void DeepLClient::releaseRequest(Request& request) {
+    if (request.form) {
+        curl_mime_free(request.form);
+        request.form = nullptr;
+    }
+    if (request.easy) {
+        curl_easy_cleanup(request.easy);
+        request.easy = nullptr;
+    }
+    if (request.headers) {
+        curl_slist_free_all(request.headers);
+        request.headers = nullptr;
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+struct DeepLResponse {
+    CURLcode curlCode = CURLE_OK;
+    long httpStatus = 0;
+    std::string body;
+    std::string error;
+
+    bool ok() const { return curlCode == CURLE_OK && httpStatus >= 200 && httpStatus < 300; }
+};
+
+// Per-request limits, a transfer that exceeds one fails with
+// CURLE_OPERATION_TIMEDOUT instead of leaving its future pending forever
+struct DeepLTransferLimits {
+    std::chrono::milliseconds connectTimeout{30000};
+    // Aborts when less than a byte per second moves for this long
+    std::chrono::milliseconds stallTimeout{60000};
+    // Whole transfer, 0 for no limit
+    std::chrono::milliseconds timeout{0};
+};
+
+// HTTP client shared by every translator for DeepL calls. Requests are driven
+// by one curl multi handle on a background thread, so connections (and their
+// TLS sessions) are kept alive and reused between calls, and any number of
+// requests can be in flight at once. Each call returns a future that is
+// fulfilled when the transfer finishes.
+class DeepLClient {
+public:
+    static DeepLClient& shared();
+
+    DeepLClient();
+    ~DeepLClient();
+    DeepLClient(const DeepLClient&) = delete;
+    DeepLClient& operator=(const DeepLClient&) = delete;
+
+    // Multipart upload of a file to the document endpoint
+    std::future<DeepLResponse> uploadDocument(const std::string& url, const std::string& deepLKey, const std::string& filePath, const std::string& targetLang, const DeepLTransferLimits& limits = DeepLTransferLimits());
+    // POST with a JSON body, used for status checks and downloads
+    std::future<DeepLResponse> postJson(const std::string& url, const std::string& deepLKey, const std::string& jsonBody, const DeepLTransferLimits& limits = DeepLTransferLimits());
+
+protected:
+    struct Request {
+        CURL* easy = nullptr;
+        curl_slist* headers = nullptr;
+        curl_mime* form = nullptr;
+        std::string postBody;
+        DeepLResponse response;
+        std::promise<DeepLResponse> promise;
+    };
+
+    std::unique_ptr<Request> createRequest(const std::string& url, const std::string& deepLKey, const DeepLTransferLimits& limits);
+    std::future<DeepLResponse> submit(std::unique_ptr<Request> request);
+    void eventLoop();
+    void finishRequest(CURL* easy, CURLcode result);
+    static void releaseRequest(Request& request);
+    static size_t writeCallback(void* contents, size_t size, size_t nmemb, std::string* output);
+
+    CURLM* multi = nullptr;
+    std::thread worker;
+    std::mutex mutex;
+    std::deque<std::unique_ptr<Request>> queued;
+    std::unordered_map<CURL*, std::unique_ptr<Request>> active;
+    bool stopping = false;
+};
@@ -0,0 +1,98 @@
+#include "DeepLDocumentScheduler.h"
+#include <algorithm>
+
+DeepLDocumentScheduler::DeepLDocumentScheduler(size_t maxInFlight, const DeepLPollPolicy::Settings& pollSettings)
+    : maxInFlight(maxInFlight == 0 ? 1 : maxInFlight), pollSettings(pollSettings) {}
+
+bool DeepLDocumentScheduler::run(const std::vector<Job>& jobs, const UploadFunction& upload, const StatusFunction& status, const DownloadFunction& download) {
+    using Clock = std::chrono::steady_clock;
+
+    std::deque<Job> pending(jobs.begin(), jobs.end());
+    std::vector<InFlightDocument> inFlight;
+    peakInFlight = 0;
+
+    while (!pending.empty() || !inFlight.empty()) {
+        // Fill every free slot before polling
+        while (!pending.empty() && inFlight.size() < maxInFlight) {
+            Job job = pending.front();
+            pending.pop_front();
+
+            DocumentInfo document = upload(job);
+            if (document.id.empty()) {
+                std::cerr << "Failed to upload document to DeepL: " << job.filePath << "\n";
+                return false;
+            }
+            std::cout << "Uploaded document " << job.index << ". Document ID: " << document.id << "\n";
+            inFlight.push_back({job, document, DeepLPollPolicy(pollSettings), Clock::now()});
+        }
+        peakInFlight = std::max(peakInFlight, inFlight.size());
+
+        Clock::time_point now = Clock::now();
+        std::vector<size_t> due;
+        std::vector<std::future<DeepLResponse>> statusChecks;
+        for (size_t i = 0; i < inFlight.size(); ++i) {
+            if (inFlight[i].nextPoll <= now) {
+                due.push_back(i);
+                statusChecks.push_back(status(inFlight[i].document));
+            }
+        }
+
+        std::vector<bool> finished(inFlight.size(), false);
+        bool failed = false;
+        for (size_t j = 0; j < due.size(); ++j) {
+            // Always drain the future, even after a failure, so no request outlives this call
+            DeepLResponse response = statusChecks[j].get();
+            if (failed) {
+                continue;
+            }
+
+            InFlightDocument& entry = inFlight[due[j]];
+            std::cout << "Document status response: " << response.body << "\n";
+            DeepLPollPolicy::Status documentStatus = DeepLPollPolicy::interpret(response);
+
+            if (documentStatus.outcome == DeepLPollPolicy::Outcome::Done) {
+                if (!download(entry.job, entry.document)) {
+                    std::cerr << "Failed to download translated document: " << entry.job.filePath << "\n";
+                    failed = true;
+                }
+                finished[due[j]] = true;
+                continue;
+            }
+            if (documentStatus.outcome == DeepLPollPolicy::Outcome::Failed) {
+                std::cerr << "DeepL failed to translate document " << entry.job.filePath << ": " << documentStatus.message << "\n";
+                failed = true;
+                continue;
+            }
+
+            std::optional<std::chrono::milliseconds> delay = entry.policy.nextDelay(documentStatus);
+            if (!delay) {
+                failed = true;
+                continue;
+            }
+            entry.nextPoll = Clock::now() + *delay;
+        }
+        if (failed) {
+            return false;
+        }
+
+        std::vector<InFlightDocument> stillTranslating;
+        for (size_t i = 0; i < inFlight.size(); ++i) {
+            if (!finished[i]) {
+                stillTranslating.push_back(std::move(inFlight[i]));
+            }
+        }
+        bool anyCompleted = stillTranslating.size() < inFlight.size();
+        inFlight.swap(stillTranslating);
+
+        // Freed slots are refilled straight away, otherwise sleep until the next document is due
+        if (!anyCompleted && !inFlight.empty()) {
+            auto nextPoll = std::min_element(inFlight.begin(), inFlight.end(), [](const InFlightDocument& a, const InFlightDocument& b) {
+                return a.nextPoll < b.nextPoll;
+            })->nextPoll;
+            std::cout << "Translation in progress... (" << inFlight.size() << " documents)" << "\n";
+            std::this_thread::sleep_until(nextPoll);
+        }
+    }
+
+    return true;
+}
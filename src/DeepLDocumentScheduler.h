@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <thread>
+#include "Document.h"
+#include "DeepLClient.h"
+#include "DeepLPollPolicy.h"
+
+// Keeps up to maxInFlight DeepL documents translating at once. Each document
+// is polled on its own schedule from DeepLPollPolicy, documents that are done
+// are downloaded straight away and their slots refilled, so a book finishes in
+// roughly the time of its slowest chapter instead of the sum of all of them.
+class DeepLDocumentScheduler {
+public:
+    struct Job {
+        size_t index;
+        std::string filePath;
+    };
+
+    // Returns an empty id on failure
+    using UploadFunction = std::function<DocumentInfo(const Job& job)>;
+    // Every document that is due is asked before any answer is awaited
+    using StatusFunction = std::function<std::future<DeepLResponse>(const DocumentInfo& document)>;
+    using DownloadFunction = std::function<bool(const Job& job, const DocumentInfo& document)>;
+
+    DeepLDocumentScheduler(size_t maxInFlight, const DeepLPollPolicy::Settings& pollSettings);
+
+    bool run(const std::vector<Job>& jobs, const UploadFunction& upload, const StatusFunction& status, const DownloadFunction& download);
+
+    size_t getPeakInFlight() const { return peakInFlight; }
+
+protected:
+    struct InFlightDocument {
+        Job job;
+        DocumentInfo document;
+        DeepLPollPolicy policy;
+        std::chrono::steady_clock::time_point nextPoll;
+    };
+
+    size_t maxInFlight;
+    DeepLPollPolicy::Settings pollSettings;
+    size_t peakInFlight = 0;
+};
@@ -0,0 +1,117 @@
+#include "DeepLPollPolicy.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+DeepLPollPolicy::DeepLPollPolicy(const Settings& settings)
+    : settings(settings), start(std::chrono::steady_clock::now()), rng(std::random_device{}()) {}
+
+bool DeepLPollPolicy::isTransientHttpStatus(long httpStatus) {
+    return httpStatus == 429 || httpStatus >= 500;
+}
+
+DeepLPollPolicy::Status DeepLPollPolicy::interpret(const DeepLResponse& response) {
+    Status status;
+
+    if (response.curlCode != CURLE_OK) {
+        status.outcome = Outcome::Transient;
+        status.message = response.error;
+        return status;
+    }
+    if (isTransientHttpStatus(response.httpStatus)) {
+        status.outcome = Outcome::Transient;
+        status.message = "HTTP " + std::to_string(response.httpStatus);
+        return status;
+    }
+    if (!response.ok()) {
+        status.outcome = Outcome::Failed;
+        status.message = "HTTP " + std::to_string(response.httpStatus) + ": " + response.body;
+        return status;
+    }
+
+    nlohmann::json jsonResponse = nlohmann::json::parse(response.body, nullptr, false);
+    if (jsonResponse.is_discarded() || !jsonResponse.is_object() || !jsonResponse.contains("status") || !jsonResponse["status"].is_string()) {
+        // A proxy or load balancer error page, try again
+        status.outcome = Outcome::Transient;
+        status.message = "Unexpected status response: " + response.body;
+        return status;
+    }
+
+    std::string state = jsonResponse["status"];
+    if (state == "done") {
+        status.outcome = Outcome::Done;
+    } else if (state == "error") {
+        status.outcome = Outcome::Failed;
+        status.message = jsonResponse.value("error_message", jsonResponse.value("message", std::string("unknown error")));
+    } else {
+        status.outcome = Outcome::InProgress;
+        if (jsonResponse.contains("seconds_remaining") && jsonResponse["seconds_remaining"].is_number()) {
+            status.secondsRemaining = jsonResponse["seconds_remaining"].get<double>();
+        }
+    }
+    return status;
+}
+
+std::chrono::milliseconds DeepLPollPolicy::backoff() {
+    long long base = settings.initialDelay.count() << std::min(attempt, 20);
+    base = std::min<long long>(base, settings.maxDelay.count());
+    attempt++;
+
+    // Equal jitter: somewhere between half and all of the backoff
+    std::uniform_int_distribution<long long> jitter(base / 2, std::max<long long>(base, 1));
+    return std::chrono::milliseconds(jitter(rng));
+}
+
+std::optional<std::chrono::milliseconds> DeepLPollPolicy::nextDelay(const Status& status) {
+    std::chrono::milliseconds delay;
+
+    switch (status.outcome) {
+    case Outcome::Done:
+    case Outcome::Failed:
+        return std::nullopt;
+    case Outcome::Transient:
+        if (++transientFailures > settings.maxTransientFailures) {
+            std::cerr << "Giving up on DeepL status checks after " << settings.maxTransientFailures << " failures: " << status.message << "\n";
+            return std::nullopt;
+        }
+        delay = backoff();
+        break;
+    case Outcome::InProgress:
+        transientFailures = 0;
+        if (status.secondsRemaining) {
+            auto estimate = std::chrono::milliseconds(static_cast<long long>(*status.secondsRemaining * 1000.0));
+            delay = std::clamp(estimate, settings.initialDelay, settings.maxDelay);
+        } else {
+            delay = backoff();
+        }
+        break;
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    if (elapsed >= settings.timeout) {
+        std::cerr << "Timed out waiting for DeepL after " << elapsed.count() / 1000 << " seconds." << "\n";
+        return std::nullopt;
+    }
+    return std::min(delay, settings.timeout - elapsed);
+}
+
+bool DeepLPollPolicy::waitUntilDone(const std::function<DeepLResponse()>& checkStatus) {
+    while (true) {
+        Status status = interpret(checkStatus());
+        if (status.outcome == Outcome::Done) {
+            return true;
+        }
+        if (status.outcome == Outcome::Failed) {
+            std::cerr << "DeepL failed to translate document: " << status.message << "\n";
+            return false;
+        }
+
+        std::optional<std::chrono::milliseconds> delay = nextDelay(status);
+        if (!delay) {
+            return false;
+        }
+        std::cout << "Translation in progress... Checking again in " << delay->count() << " ms." << "\n";
+        std::this_thread::sleep_for(*delay);
+    }
+}
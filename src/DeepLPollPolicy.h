@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <random>
+#include <string>
+#include "DeepLClient.h"
+
+struct DeepLPollSettings {
+    std::chrono::milliseconds initialDelay{1000};
+    std::chrono::milliseconds maxDelay{30000};
+    std::chrono::milliseconds timeout{std::chrono::minutes(60)};
+    int maxTransientFailures = 5;
+    // Limits of each request, so a hung transfer fails and counts as transient
+    std::chrono::milliseconds connectTimeout{30000};
+    std::chrono::milliseconds stallTimeout{60000};
+
+    // No single request may outlast the overall timeout either
+    DeepLTransferLimits transferLimits() const {
+        return DeepLTransferLimits{connectTimeout, stallTimeout, timeout};
+    }
+};
+
+// Decides how long to wait between DeepL document status checks. Uses the
+// seconds_remaining estimate when the API gives one, otherwise backs off
+// exponentially with jitter. Transport errors, 429 and 5xx responses and
+// unreadable bodies are retried a limited number of times, and polling gives
+// up once the overall timeout has passed.
+class DeepLPollPolicy {
+public:
+    using Settings = DeepLPollSettings;
+
+    enum class Outcome { InProgress, Done, Failed, Transient };
+
+    struct Status {
+        Outcome outcome = Outcome::Transient;
+        std::optional<double> secondsRemaining;
+        std::string message;
+    };
+
+    explicit DeepLPollPolicy(const Settings& settings = Settings());
+
+    static Status interpret(const DeepLResponse& response);
+    static bool isTransientHttpStatus(long httpStatus);
+
+    // Wait before the next status check, or nullopt once polling should stop
+    std::optional<std::chrono::milliseconds> nextDelay(const Status& status);
+
+    // Polls checkStatus until the document is done. Returns false when it
+    // failed, timed out or kept failing transiently.
+    bool waitUntilDone(const std::function<DeepLResponse()>& checkStatus);
+
+protected:
+    std::chrono::milliseconds backoff();
+
+    Settings settings;
+    int attempt = 0;
+    int transientFailures = 0;
+    std::chrono::steady_clock::time_point start;
+    std::mt19937 rng;
+};
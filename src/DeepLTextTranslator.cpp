@@ -0,0 +1,160 @@
+#include "DeepLTextTranslator.h"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+// Everything in the request body except the texts themselves
+constexpr size_t kRequestEnvelopeBytes = 256;
+
+size_t encodedTextSize(const std::string& text) {
+    // Quotes, escapes and the separating comma as they end up in the JSON array
+    return nlohmann::json(text).dump().size() + 1;
+}
+
+} // namespace
+
+DeepLTextTranslator::DeepLTextTranslator(const std::string& apiUrl, const std::string& deepLKey, const std::string& targetLang)
+    : apiUrl(apiUrl), deepLKey(deepLKey), targetLang(targetLang) {}
+
+void DeepLTextTranslator::setMaxConcurrentRequests(size_t maxRequests) {
+    maxConcurrentRequests = maxRequests == 0 ? 1 : maxRequests;
+}
+
+void DeepLTextTranslator::setRetrySettings(const DeepLPollPolicy::Settings& settings) {
+    retrySettings = settings;
+}
+
+std::vector<std::pair<size_t, size_t>> DeepLTextTranslator::planBatches(const std::vector<std::string>& texts) const {
+    std::vector<std::pair<size_t, size_t>> batches;
+    size_t begin = 0;
+    size_t bytes = kRequestEnvelopeBytes;
+
+    for (size_t i = 0; i < texts.size(); ++i) {
+        size_t textBytes = encodedTextSize(texts[i]);
+        bool full = (i - begin) >= maxTextsPerRequest || bytes + textBytes > maxRequestBytes;
+
+        // An oversized text still goes out, on its own
+        if (full && i > begin) {
+            batches.emplace_back(begin, i);
+            begin = i;
+            bytes = kRequestEnvelopeBytes;
+        }
+        bytes += textBytes;
+    }
+    if (begin < texts.size()) {
+        batches.emplace_back(begin, texts.size());
+    }
+    return batches;
+}
+
+std::string DeepLTextTranslator::buildRequestBody(const std::vector<std::string>& texts, size_t begin, size_t end) const {
+    nlohmann::json payload;
+    payload["text"] = nlohmann::json::array();
+    for (size_t i = begin; i < end; ++i) {
+        payload["text"].push_back(texts[i]);
+    }
+    payload["target_lang"] = targetLang;
+    payload["tag_handling"] = "html";
+    return payload.dump();
+}
+
+bool DeepLTextTranslator::parseResponse(const std::string& body, size_t begin, size_t end, std::vector<std::string>& translations) const {
+    nlohmann::json jsonResponse = nlohmann::json::parse(body, nullptr, false);
+    if (jsonResponse.is_discarded() || !jsonResponse.contains("translations") || !jsonResponse["translations"].is_array()) {
+        std::cerr << "Unexpected DeepL translate response: " << body << "\n";
+        return false;
+    }
+
+    const auto& results = jsonResponse["translations"];
+    if (results.size() != end - begin) {
+        std::cerr << "DeepL returned " << results.size() << " translations for " << end - begin << " texts." << "\n";
+        return false;
+    }
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (!results[i].contains("text") || !results[i]["text"].is_string()) {
+            std::cerr << "DeepL translation without text: " << results[i].dump() << "\n";
+            return false;
+        }
+        translations[begin + i] = results[i]["text"].get<std::string>();
+    }
+    return true;
+}
+
+DeepLResponse DeepLTextTranslator::sendWithRetries(const std::string& requestBody, std::future<DeepLResponse> firstAttempt) {
+    DeepLPollPolicy policy(retrySettings);
+    DeepLResponse response = firstAttempt.get();
+
+    while (response.curlCode != CURLE_OK || DeepLPollPolicy::isTransientHttpStatus(response.httpStatus)) {
+        DeepLPollPolicy::Status status;
+        status.outcome = DeepLPollPolicy::Outcome::Transient;
+        status.message = response.curlCode != CURLE_OK ? response.error : "HTTP " + std::to_string(response.httpStatus);
+
+        std::optional<std::chrono::milliseconds> delay = policy.nextDelay(status);
+        if (!delay) {
+            break;
+        }
+        std::cerr << "DeepL translate request failed (" << status.message << "), retrying in " << delay->count() << " ms." << "\n";
+        std::this_thread::sleep_for(*delay);
+        response = DeepLClient::shared().postJson(apiUrl, deepLKey, requestBody, retrySettings.transferLimits()).get();
+    }
+    return response;
+}
+
+bool DeepLTextTranslator::translate(const std::vector<std::string>& texts, std::vector<std::string>& translations) {
+    translations = texts;
+
+    // Empty segments are left alone instead of spending part of a request on them
+    std::vector<size_t> sourceIndex;
+    std::vector<std::string> pendingTexts;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        if (!texts[i].empty()) {
+            sourceIndex.push_back(i);
+            pendingTexts.push_back(texts[i]);
+        }
+    }
+
+    std::vector<std::pair<size_t, size_t>> batches = planBatches(pendingTexts);
+    std::vector<std::string> results(pendingTexts.size());
+    std::cout << "Translating " << pendingTexts.size() << " segments in " << batches.size() << " DeepL requests." << "\n";
+
+    for (size_t windowStart = 0; windowStart < batches.size(); windowStart += maxConcurrentRequests) {
+        size_t windowEnd = std::min(batches.size(), windowStart + maxConcurrentRequests);
+
+        std::vector<std::string> bodies;
+        std::vector<std::future<DeepLResponse>> requests;
+        for (size_t b = windowStart; b < windowEnd; ++b) {
+            bodies.push_back(buildRequestBody(pendingTexts, batches[b].first, batches[b].second));
+            requests.push_back(DeepLClient::shared().postJson(apiUrl, deepLKey, bodies.back(), retrySettings.transferLimits()));
+        }
+
+        bool failed = false;
+        for (size_t b = windowStart; b < windowEnd; ++b) {
+            if (failed) {
+                // Still wait for it so no request outlives this call
+                requests[b - windowStart].get();
+                continue;
+            }
+            DeepLResponse response = sendWithRetries(bodies[b - windowStart], std::move(requests[b - windowStart]));
+            if (!response.ok()) {
+                std::cerr << "DeepL translate request failed: " << (response.curlCode != CURLE_OK ? response.error : "HTTP " + std::to_string(response.httpStatus) + " " + response.body) << "\n";
+                failed = true;
+                continue;
+            }
+            if (!parseResponse(response.body, batches[b].first, batches[b].second, results)) {
+                failed = true;
+            }
+        }
+        if (failed) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < sourceIndex.size(); ++i) {
+        translations[sourceIndex[i]] = results[i];
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "DeepLClient.h"
+#include "DeepLPollPolicy.h"
+
+// Translates segments through DeepL's /v2/translate text endpoint with HTML
+// tag handling. Segments are packed into as few requests as the API limits
+// allow (50 texts and 128 KiB per request) and several requests are sent at
+// once, so there is no document upload, polling or download.
+class DeepLTextTranslator {
+public:
+    static constexpr size_t maxTextsPerRequest = 50;
+    static constexpr size_t maxRequestBytes = 128 * 1024;
+
+    DeepLTextTranslator(const std::string& apiUrl, const std::string& deepLKey, const std::string& targetLang = "EN");
+
+    void setMaxConcurrentRequests(size_t maxRequests);
+    void setRetrySettings(const DeepLPollPolicy::Settings& settings);
+
+    // translations gets one entry per input text, in the same order
+    bool translate(const std::vector<std::string>& texts, std::vector<std::string>& translations);
+
+    // Half-open [begin, end) ranges of texts that fit in one request each
+    std::vector<std::pair<size_t, size_t>> planBatches(const std::vector<std::string>& texts) const;
+
+protected:
+    std::string buildRequestBody(const std::vector<std::string>& texts, size_t begin, size_t end) const;
+    bool parseResponse(const std::string& body, size_t begin, size_t end, std::vector<std::string>& translations) const;
+    DeepLResponse sendWithRetries(const std::string& requestBody, std::future<DeepLResponse> firstAttempt);
+
+    std::string apiUrl;
+    std::string deepLKey;
+    std::string targetLang;
+    size_t maxConcurrentRequests = 4;
+    DeepLPollPolicy::Settings retrySettings;
+};
@@ -33,65 +33,72 @@ int DocxTranslator::run(const std::string& inputPath, const std::string& outputP
     }
 
 
-    // Unzip the DOCX file
-    std::string unzippedPath = "unzipped";
-
-    std::filesystem::path unzipppedPathU8 = std::filesystem::u8path(unzippedPath);
-
-    // Check if the unzipped directory already exists
-    if (std::filesystem::exists(unzipppedPathU8)) {
-        std::cout << "Unzipped directory already exists. Deleting it..." << "\n";
-        std::filesystem::remove_all(unzipppedPathU8);
-    }
-
     // Start the timer
     auto start = std::chrono::high_resolution_clock::now();
     std::cout << "START" << "\n";
 
-    // Create the output directory if it doesn't exist
-    if (!make_directory(unzippedPath)) {
-        std::cerr << "Failed to create output directory: " << unzippedPath << "\n";
-        return 1;
-    }
+    std::string unzippedPath = "unzipped";
 
-    // Unzip the DOCX file
-    if (!unzip_file(inputPath, unzippedPath)) {
-        std::cerr << "Failed to unzip DOCX file: " << inputPath << "\n";
-        return 1;
-    }
+    // Headers, footers, footnotes, endnotes and comments are translated along with the body
+    std::vector<DocxPart> parts;
 
-    std::cout << "DOCX file unzipped successfully to: " << unzippedPath << "\n";
+    if (inMemoryRepack) {
+        // Only the text parts are read, everything else is copied from the archive when repacking
+        if (!readTextParts(inputPath, parts)) {
+            return 1;
+        }
+    } else {
+        std::filesystem::path unzipppedPathU8 = std::filesystem::u8path(unzippedPath);
 
-    // Get the path to the document.xml file
-    std::string documentXmlPath = unzippedPath + "/word/document.xml";
+        // Check if the unzipped directory already exists
+        if (std::filesystem::exists(unzipppedPathU8)) {
+            std::cout << "Unzipped directory already exists. Deleting it..." << "\n";
+            std::filesystem::remove_all(unzipppedPathU8);
+        }
 
-    std::filesystem::path documentXmlPathU8 = std::filesystem::u8path(documentXmlPath);
+        // Create the output directory if it doesn't exist
+        if (!make_directory(unzippedPath)) {
+            std::cerr << "Failed to create output directory: " << unzippedPath << "\n";
+            return 1;
+        }
 
-    // Check if the document.xml file exists
-    if (!std::filesystem::exists(documentXmlPathU8)) {
-        std::cerr << "document.xml file not found in DOCX archive." << "\n";
-        return 1;
-    }
+        // Unzip the DOCX file
+        if (!unzip_file(inputPath, unzippedPath)) {
+            std::cerr << "Failed to unzip DOCX file: " << inputPath << "\n";
+            return 1;
+        }
 
-    // Parse the document.xml file
-    xmlDocPtr doc = xmlReadFile(documentXmlPath.c_str(), NULL, 0);
+        std::cout << "DOCX file unzipped successfully to: " << unzippedPath << "\n";
 
-    if (doc == NULL) {
-        std::cerr << "Failed to parse document.xml file." << "\n";
-        return 1;
-    }
+        // Check if the document.xml file exists
+        if (!std::filesystem::exists(std::filesystem::u8path(unzippedPath + "/word/document.xml"))) {
+            std::cerr << "document.xml file not found in DOCX archive." << "\n";
+            return 1;
+        }
 
-    // Get the root element of the XML document
-    xmlNodePtr root = xmlDocGetRootElement(doc);
+        for (const std::string& partName : findTextParts(unzippedPath)) {
+            DocxPart part;
+            part.name = partName;
+            part.xmlPath = unzippedPath + "/" + partName;
+            parts.push_back(std::move(part));
+        }
+    }
 
-    // Extract text nodes from the XML document
-    std::vector<TextNode> textNodes = extractTextNodes(root);
+    if (!forEachPart(parts, [this](DocxPart& part) { return extractPart(part); })) {
+        for (DocxPart& part : parts) {
+            xmlFreeDoc(part.doc);
+        }
+        return 1;
+    }
 
     // Save the extracted text to a file
     std::string textFilePath = "extracted_text.txt";
-    std::string positionFilePath = "position_tags.txt";
 
-    saveTextToFile(textNodes, positionFilePath, textFilePath, langcode);
+    // One line per distinct segment over all parts, repeated headers and footers are translated once
+    std::vector<std::string> batch = buildTranslationBatch(parts);
+    std::cout << "Translating " << parts.size() << " parts as " << batch.size() << " distinct segments" << "\n";
+
+    saveTextToFile(batch, textFilePath, langcode);
 
     std::string chapterNumberMode = "1";
     
@@ -172,33 +179,19 @@ int DocxTranslator::run(const std::string& inputPath, const std::string& outputP
     std::cout << "After call to translation.exe" << '\n';
 
     // Load the translations
-    std::unordered_multimap<std::string, std::string> translations = loadTranslations(positionFilePath, "translatedTags.txt");
-    
-    escapeTranslations(translations);
+    std::vector<std::string> batchTranslations = loadTranslations("translatedTags.txt", batch.size());
 
-    // Print the translations
-    for (const auto& [path, text] : translations) {
-        std::cout << path << " -> " << text << "\n";
-    }
-    try{
-        // Reinsert the translations into the XML document
-        reinsertTranslations(root, translations);
-    } catch (const std::exception& ex) {
-        std::cerr << "Exception: " << ex.what() << "\n";
-    }
-
-    // Save the modified XML document to a file
-    if (xmlSaveFileEnc(documentXmlPath.c_str(), doc, "UTF-8") == -1) {
-        std::cerr << "Failed to save modified XML document." << "\n";
+    if (!forEachPart(parts, [this, &batchTranslations](DocxPart& part) { return writePart(part, batchTranslations); })) {
         return 1;
     }
 
-    // Free the XML document
-    xmlFreeDoc(doc);
-
-    std::cout << "Modified XML document saved to: " << documentXmlPath << "\n";
-
-    exportDocx(unzippedPath, outputPath);
+    if (inMemoryRepack) {
+        if (!repackDocx(inputPath, outputPath + "/output.docx", parts)) {
+            return 1;
+        }
+    } else {
+        exportDocx(unzippedPath, outputPath);
+    }
 
     
     // End timer
@@ -206,9 +199,10 @@ int DocxTranslator::run(const std::string& inputPath, const std::string& outputP
     std::chrono::duration<double> elapsed = end - start;
     std::cout << "Time taken: " << elapsed.count() << "s" << "\n";
 
-    // Cleanup
-    std::filesystem::remove_all(unzippedPath);
-    std::filesystem::remove(positionFilePath);
+    // Cleanup, the unzipped directory only exists when this job created it
+    if (!inMemoryRepack) {
+        std::filesystem::remove_all(unzippedPath);
+    }
     std::filesystem::remove(textFilePath);
     std::filesystem::remove("translatedTags.txt");
 
@@ -296,169 +290,815 @@ bool DocxTranslator::unzip_file(const std::string& zipPath, const std::string& o
     return true;
 }
 
-std::string DocxTranslator::getNodePath(xmlNode *node) {
-    std::string path;
-    while (node) {
-        if (node->name) {
-            path = "/" + std::string((const char*)node->name) + path;
+void DocxTranslator::appendTextNode(xmlNode *node, std::vector<DocxTextNode> &nodes) {
+    if (node->type == XML_ELEMENT_NODE && xmlStrcmp(node->name, BAD_CAST "t") == 0) {
+        xmlChar *content = xmlNodeGetContent(node);
+        if (content && xmlStrlen(content) > 0) {
+            nodes.push_back({node, (const char*)content});
+        }
+        if (content) {
+            xmlFree(content);
         }
-        node = node->parent;
     }
-    return path;
 }
 
-void DocxTranslator::extractTextNodesRecursive(xmlNode *node, std::vector<TextNode> &nodes) {
+void DocxTranslator::extractTextNodesRecursive(xmlNode *node, std::vector<DocxTextNode> &nodes) {
     for (; node; node = node->next) {
-        if (node->type == XML_ELEMENT_NODE && xmlStrcmp(node->name, BAD_CAST "t") == 0) {
-            xmlChar *content = xmlNodeGetContent(node);
-            if (content && xmlStrlen(content) > 0) {
-                nodes.push_back({getNodePath(node), (const char*)content});
-                xmlFree(content);
-            }
-        }
+        appendTextNode(node, nodes);
         extractTextNodesRecursive(node->children, nodes);
     }
 }
 
 // Wrapper function to start the extraction (Needs namespace in the XML)
-std::vector<TextNode> DocxTranslator::extractTextNodes(xmlNode *root) {
-    std::vector<TextNode> nodes;
+std::vector<DocxTextNode> DocxTranslator::extractTextNodes(xmlNode *root) {
+    std::vector<DocxTextNode> nodes;
     nodes.reserve(10000);  // Reserve large space to avoid multiple allocations
     extractTextNodesRecursive(root, nodes);
+    size_t nextParagraph = 0;
+    numberParagraphs(nodes, 0, nextParagraph);
     return nodes;
 }
 
+xmlNode* DocxTranslator::enclosingParagraph(xmlNode *node) {
+    for (; node; node = node->parent) {
+        if (node->type == XML_ELEMENT_NODE && xmlStrcmp(node->name, BAD_CAST "p") == 0) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+// Nodes from `first` on get paragraph numbers, a node outside any w:p is a
+// paragraph of its own
+void DocxTranslator::numberParagraphs(std::vector<DocxTextNode> &nodes, size_t first, size_t &nextParagraph) {
+    xmlNode* previous = NULL;
+    for (size_t i = first; i < nodes.size(); ++i) {
+        xmlNode* paragraph = enclosingParagraph(nodes[i].node);
+        if (i == first || paragraph == NULL || paragraph != previous) {
+            ++nextParagraph;
+        }
+        nodes[i].paragraph = nextParagraph;
+        previous = paragraph;
+    }
+}
 
-void DocxTranslator::saveTextToFile(const std::vector<TextNode> &nodes, const std::string &positionFilename, const std::string &textFilename, const std::string &langcode) {
-    std::ofstream positionFile(positionFilename);
+std::vector<DocxSegment> DocxTranslator::buildSegments(const std::vector<DocxTextNode> &nodes) const {
+    std::vector<DocxSegment> segments;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (paragraphSegments && !segments.empty() && nodes[i].paragraph == nodes[i - 1].paragraph) {
+            // Runs follow each other without a separator in the document
+            segments.back().text += nodes[i].text;
+            ++segments.back().nodeCount;
+        } else {
+            segments.push_back({i, 1, nodes[i].text});
+        }
+    }
+    return segments;
+}
+
+
+void DocxTranslator::saveTextToFile(const std::vector<std::string> &texts, const std::string &textFilename, const std::string &langcode) {
     std::ofstream textFile(textFilename);
 
-    if (!positionFile.is_open() || !textFile.is_open()) {
+    if (!textFile.is_open()) {
         std::cerr << "Error opening output files.\n";
         return;
     }
 
     int counterNum = 1;
-    for (const auto &node : nodes) {
-        // Write to positionTags.txt: "counterNum,node.path"
-        positionFile << counterNum << "," << node.path << "\n";
-        // Write to extracted_text.txt: "counterNum,node.text"
-        textFile << counterNum << ",>>" << langcode << "<< " << node.text << "\n";
+    for (const auto &text : texts) {
+        // Write to extracted_text.txt: "counterNum,text"
+        textFile << counterNum << ",>>" << langcode << "<< " << text << "\n";
         ++counterNum;
     }
 
-    positionFile.close();
     textFile.close();
 
-    std::cout << "Positions saved to " << positionFilename << std::endl;
     std::cout << "Texts saved to " << textFilename << std::endl;
 }
 
 
-std::unordered_multimap<std::string, std::string> DocxTranslator::loadTranslations(const std::string &positionFilename, const std::string &textFilename) {
+std::vector<std::string> DocxTranslator::loadTranslations(const std::string &textFilename, size_t segmentCount) {
 
-    std::unordered_multimap<std::string, std::string> translations;
+    std::vector<std::string> translations(segmentCount);
 
-    std::ifstream positionFile(positionFilename);
     std::ifstream textFile(textFilename);
 
-    if (!positionFile.is_open() || !textFile.is_open()) {
+    if (!textFile.is_open()) {
         std::cerr << "Error opening translation files.\n";
         return translations;
     }
 
-    std::string positionLine, textLine;
-
-    while (std::getline(positionFile, positionLine) && std::getline(textFile, textLine)) {
-        // Parse position line: "counterNum,node.path"
-        size_t posDelimiter = positionLine.find(',');
-        if (posDelimiter == std::string::npos) continue;
-
-        std::string posCounter = positionLine.substr(0, posDelimiter);
-        std::string nodePath = positionLine.substr(posDelimiter + 1);
+    std::string textLine;
+    size_t loaded = 0;
 
+    while (std::getline(textFile, textLine)) {
         // Parse text line: "counterNum,node.text"
         size_t textDelimiter = textLine.find(',');
         if (textDelimiter == std::string::npos) continue;
 
-        std::string textCounter = textLine.substr(0, textDelimiter);
-        std::string nodeText = textLine.substr(textDelimiter + 1);
+        size_t counter = 0;
+        try {
+            counter = std::stoul(textLine.substr(0, textDelimiter));
+        } catch (const std::exception&) {
+            continue;
+        }
 
-        // Match counterNum before inserting
-        if (posCounter == textCounter) {
-            translations.insert({nodePath, nodeText});
-        } else {
-            std::cerr << "Mismatched counters: Position " << posCounter 
-                      << " vs Text " << textCounter << "\n";
+        // Counters are 1-based ordinals of the saved segments
+        if (counter == 0 || counter > segmentCount) {
+            std::cerr << "Translation for unknown segment " << counter << "\n";
+            continue;
         }
+
+        translations[counter - 1] = textLine.substr(textDelimiter + 1);
+        ++loaded;
     }
 
-    positionFile.close();
     textFile.close();
 
-    std::cout << "Loaded " << translations.size() << " translations.\n";
+    std::cout << "Loaded " << loaded << " translations.\n";
     return translations;
 }
 
+std::vector<std::optional<std::string>> DocxTranslator::distributeTranslations(const std::vector<DocxTextNode> &nodes, const std::vector<DocxSegment> &segments, const std::vector<std::string> &translations) const {
+    std::vector<std::optional<std::string>> nodeTranslations(nodes.size());
+    std::vector<size_t> weights;
+
+    size_t count = std::min(segments.size(), translations.size());
+    for (size_t i = 0; i < count; ++i) {
+        const DocxSegment& segment = segments[i];
+        const std::string& translation = translations[i];
+        if (translation.empty()) {
+            continue;
+        }
+
+        if (segment.nodeCount == 1 || runDistribution == DocxRunDistribution::FirstRun) {
+            nodeTranslations[segment.firstNode] = translation;
+            for (size_t j = 1; j < segment.nodeCount; ++j) {
+                nodeTranslations[segment.firstNode + j] = std::string();
+            }
+            continue;
+        }
+
+        // Shares follow the number of characters each run had in the original
+        weights.clear();
+        for (size_t j = 0; j < segment.nodeCount; ++j) {
+            const std::string& text = nodes[segment.firstNode + j].text;
+            weights.push_back(std::count_if(text.begin(), text.end(), [](char c) { return (c & 0xC0) != 0x80; }));
+        }
+
+        std::vector<std::string> pieces = splitProportionally(translation, weights);
+        for (size_t j = 0; j < segment.nodeCount; ++j) {
+            nodeTranslations[segment.firstNode + j] = std::move(pieces[j]);
+        }
+    }
+
+    return nodeTranslations;
+}
+
+// Piece k ends at the space closest to its share of the translation and keeps
+// that space. Text without spaces (CJK) is cut at any character.
+std::vector<std::string> DocxTranslator::splitProportionally(const std::string &translation, const std::vector<size_t> &weights) {
+    std::vector<std::string> pieces(weights.size());
+    if (pieces.empty()) {
+        return pieces;
+    }
+
+    size_t totalWeight = 0;
+    for (size_t weight : weights) {
+        totalWeight += weight;
+    }
+    if (totalWeight == 0) {
+        pieces[0] = translation;
+        return pieces;
+    }
+
+    const bool bySpaces = translation.find(' ') != std::string::npos;
+    size_t start = 0;
+    size_t cumulative = 0;
+    for (size_t k = 0; k + 1 < pieces.size(); ++k) {
+        cumulative += weights[k];
+        size_t target = std::max(translation.size() * cumulative / totalWeight, start);
+        if (target == start) {
+            // No share left for this run, e.g. its original text was empty
+            continue;
+        }
+
+        size_t end;
+        if (bySpaces) {
+            size_t after = translation.find(' ', target);
+            size_t before = target > start ? translation.rfind(' ', target - 1) : std::string::npos;
+            if (before != std::string::npos && before < start) {
+                before = std::string::npos;
+            }
+
+            if (after == std::string::npos && before == std::string::npos) {
+                end = target - start < translation.size() - target ? start : translation.size();
+            } else if (after == std::string::npos || (before != std::string::npos && target - before <= after - target)) {
+                end = before + 1;
+            } else {
+                end = after + 1;
+            }
+        } else {
+            end = target;
+            while (end < translation.size() && (translation[end] & 0xC0) == 0x80) {
+                ++end;
+            }
+        }
+
+        pieces[k] = translation.substr(start, end - start);
+        start = end;
+    }
+    pieces.back() = translation.substr(start);
+
+    return pieces;
+}
+
 // Helper function to update text content and language attribute
 void DocxTranslator::updateNodeWithTranslation(xmlNode *node, const std::string &translation) {
     // Replace text content
     xmlNodeSetContent(node, BAD_CAST translation.c_str());
 
+    // Word drops spaces at either end of a w:t unless it is told to keep them,
+    // pieces of a split paragraph usually end with one
+    if (!translation.empty() && (translation.front() == ' ' || translation.back() == ' ')) {
+        xmlSetProp(node, BAD_CAST "xml:space", BAD_CAST "preserve");
+    }
+
     // Update parent's language attribute to English
     if (xmlNode *parent = node->parent) {
         xmlNewProp(parent, BAD_CAST "xml:lang", BAD_CAST "en-US");
     }
 }
 
-// Recursive function to traverse nodes and insert translations
-void DocxTranslator::traverseAndReinsert(xmlNode *node, std::unordered_multimap<std::string, std::string> &translations, std::unordered_map<std::string, std::unordered_multimap<std::string, std::string>::iterator> &lastUsed) {
-    for (; node; node = node->next) {
-        if (node->type == XML_ELEMENT_NODE && xmlStrcmp(node->name, BAD_CAST "t") == 0) {
-            std::string path = getNodePath(node);
-
-            // Find available translations for this path
-            auto range = translations.equal_range(path);
-            if (range.first != range.second) {
-                // Initialize iterator if not set
-                if (lastUsed.find(path) == lastUsed.end()) {
-                    lastUsed[path] = range.first;
-                } else {
-                    // Increment and loop if needed
-                    auto &it = lastUsed[path];
-                    ++it;
-                    if (it == range.second) {
-                        it = range.first; // Cycle back to the first translation
-                    }
-                }
-
-                // Insert the translation
-                updateNodeWithTranslation(node, lastUsed[path]->second);
+// Each translation goes to the node extracted at the same index, nodes
+// without one keep their original text
+void DocxTranslator::reinsertTranslations(const std::vector<DocxTextNode> &nodes, const std::vector<std::optional<std::string>> &translations) {
+    if (translations.size() != nodes.size()) {
+        std::cerr << "Got " << translations.size() << " translations for " << nodes.size() << " text nodes.\n";
+    }
+
+    size_t count = std::min(nodes.size(), translations.size());
+    for (size_t i = 0; i < count; ++i) {
+        if (translations[i]) {
+            updateNodeWithTranslation(nodes[i].node, *translations[i]);
+        }
+    }
+}
+
+void DocxTranslator::setStreamingXml(bool streaming) {
+    streamingXml = streaming;
+}
+
+void DocxTranslator::setStreamingThreshold(size_t bytes) {
+    streamingThreshold = bytes;
+}
+
+void DocxTranslator::setParagraphSegments(bool enabled, DocxRunDistribution distribution) {
+    paragraphSegments = enabled;
+    runDistribution = distribution;
+}
+
+// Paragraphs are expanded into a small DOM of their own and handled with the
+// same functions as the full document. A w:t outside any paragraph is
+// expanded on its own, so both passes count the same elements.
+bool DocxTranslator::isStreamingUnit(xmlTextReaderPtr reader) {
+    if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT) {
+        return false;
+    }
+    const xmlChar* name = xmlTextReaderConstLocalName(reader);
+    return xmlStrcmp(name, BAD_CAST "p") == 0 || xmlStrcmp(name, BAD_CAST "t") == 0;
+}
+
+bool DocxTranslator::extractTextNodesStreaming(const std::string &xmlPath, std::vector<DocxTextNode> &nodes) {
+    xmlTextReaderPtr reader = xmlReaderForFile(xmlPath.c_str(), NULL, XML_PARSE_HUGE | XML_PARSE_NONET);
+    if (reader == NULL) {
+        std::cerr << "Failed to open " << xmlPath << "\n";
+        return false;
+    }
+
+    bool extracted = extractTextNodesStreaming(reader, nodes);
+    xmlFreeTextReader(reader);
+    if (!extracted) {
+        std::cerr << "Failed to parse " << xmlPath << "\n";
+    }
+    return extracted;
+}
+
+bool DocxTranslator::extractTextNodesStreaming(xmlTextReaderPtr reader, std::vector<DocxTextNode> &nodes) {
+    size_t nextParagraph = 0;
+    int ret = xmlTextReaderRead(reader);
+    while (ret == 1) {
+        if (!isStreamingUnit(reader)) {
+            ret = xmlTextReaderRead(reader);
+            continue;
+        }
+
+        xmlNode* unit = xmlTextReaderExpand(reader);
+        if (unit == NULL) {
+            ret = -1;
+            break;
+        }
+
+        size_t first = nodes.size();
+        appendTextNode(unit, nodes);
+        extractTextNodesRecursive(unit->children, nodes);
+        numberParagraphs(nodes, first, nextParagraph);
+        // The reader frees the paragraph once it moves past it
+        for (size_t i = first; i < nodes.size(); ++i) {
+            nodes[i].node = NULL;
+        }
+
+        ret = xmlTextReaderNext(reader);
+    }
+
+    return ret == 0;
+}
+
+// Writes the node the reader is on, elements are only opened here and
+// closed again when the reader reaches their end
+bool DocxTranslator::copyReaderNode(xmlTextReaderPtr reader, xmlTextWriterPtr writer) {
+    int rc = 0;
+    switch (xmlTextReaderNodeType(reader)) {
+        case XML_READER_TYPE_ELEMENT: {
+            bool isEmpty = xmlTextReaderIsEmptyElement(reader) == 1;
+            rc = xmlTextWriterStartElement(writer, xmlTextReaderConstName(reader));
+            // Namespace declarations come through as attributes as well
+            while (rc >= 0 && xmlTextReaderMoveToNextAttribute(reader) == 1) {
+                rc = xmlTextWriterWriteAttribute(writer, xmlTextReaderConstName(reader), xmlTextReaderConstValue(reader));
+            }
+            xmlTextReaderMoveToElement(reader);
+            if (rc >= 0 && isEmpty) {
+                rc = xmlTextWriterEndElement(writer);
             }
+            break;
         }
-        // Recurse into child nodes
-        traverseAndReinsert(node->children, translations, lastUsed);
+        case XML_READER_TYPE_END_ELEMENT:
+            rc = xmlTextWriterEndElement(writer);
+            break;
+        case XML_READER_TYPE_TEXT:
+        case XML_READER_TYPE_WHITESPACE:
+        case XML_READER_TYPE_SIGNIFICANT_WHITESPACE:
+            rc = xmlTextWriterWriteString(writer, xmlTextReaderConstValue(reader));
+            break;
+        case XML_READER_TYPE_CDATA:
+            rc = xmlTextWriterWriteCDATA(writer, xmlTextReaderConstValue(reader));
+            break;
+        case XML_READER_TYPE_COMMENT:
+            rc = xmlTextWriterWriteComment(writer, xmlTextReaderConstValue(reader));
+            break;
+        case XML_READER_TYPE_PROCESSING_INSTRUCTION:
+            rc = xmlTextWriterWritePI(writer, xmlTextReaderConstName(reader), xmlTextReaderConstValue(reader));
+            break;
+        default:
+            break;
     }
+    return rc >= 0;
 }
 
-// Main function to reinsert translations using multimap
-void DocxTranslator::reinsertTranslations(xmlNode *root, std::unordered_multimap<std::string, std::string> &translations) {
-    if (!root) {
-        std::cerr << "Error: XML root node is null.\n";
-        return;
+bool DocxTranslator::rewriteDocumentStreaming(const std::string &inputXmlPath, const std::string &outputXmlPath, const std::vector<std::optional<std::string>> &translations) {
+    xmlTextReaderPtr reader = xmlReaderForFile(inputXmlPath.c_str(), NULL, XML_PARSE_HUGE | XML_PARSE_NONET);
+    if (reader == NULL) {
+        std::cerr << "Failed to open " << inputXmlPath << "\n";
+        return false;
+    }
+
+    xmlTextWriterPtr writer = xmlNewTextWriterFilename(outputXmlPath.c_str(), 0);
+    if (writer == NULL) {
+        std::cerr << "Failed to create " << outputXmlPath << "\n";
+        xmlFreeTextReader(reader);
+        return false;
     }
 
-    // Track which translation was last used for each node path
-    std::unordered_map<std::string, std::unordered_multimap<std::string, std::string>::iterator> lastUsed;
+    bool rewritten = rewriteDocumentStreaming(reader, writer, inputXmlPath, translations);
+    xmlFreeTextWriter(writer);
+    xmlFreeTextReader(reader);
+    return rewritten;
+}
 
-    // Begin recursive traversal and reinsertion
-    try {
-        traverseAndReinsert(root, translations, lastUsed);
-    } catch (const std::exception &e) {
-        std::cerr << "Exception during reinsert: " << e.what() << "\n";
-    } catch (...) {
-        std::cerr << "Unknown error during reinsert.\n";
+bool DocxTranslator::rewriteDocumentStreaming(xmlTextReaderPtr reader, xmlTextWriterPtr writer, const std::string &name, const std::vector<std::optional<std::string>> &translations) {
+    bool ok = true;
+    std::vector<DocxTextNode> unitNodes;
+    xmlBufferPtr unitBuffer = xmlBufferCreate();
+    size_t ordinal = 0;
+
+    int ret = xmlTextReaderRead(reader);
+    if (ret == 1) {
+        // The standalone flag is only known once the declaration has been read
+        int standalone = xmlTextReaderStandalone(reader);
+        ok = xmlTextWriterStartDocument(writer, NULL, "UTF-8", standalone == 1 ? "yes" : standalone == 0 ? "no" : NULL) >= 0;
+    }
+
+    while (ok && ret == 1) {
+        if (!isStreamingUnit(reader)) {
+            ok = copyReaderNode(reader, writer);
+            ret = xmlTextReaderRead(reader);
+            continue;
+        }
+
+        xmlNode* unit = xmlTextReaderExpand(reader);
+        if (unit == NULL) {
+            ret = -1;
+            break;
+        }
+
+        // Ordinals continue across paragraphs, so translation i still goes to w:t number i
+        unitNodes.clear();
+        appendTextNode(unit, unitNodes);
+        extractTextNodesRecursive(unit->children, unitNodes);
+        for (const DocxTextNode& textNode : unitNodes) {
+            if (ordinal < translations.size() && translations[ordinal]) {
+                updateNodeWithTranslation(textNode.node, *translations[ordinal]);
+            }
+            ++ordinal;
+        }
+
+        xmlBufferEmpty(unitBuffer);
+        if (xmlNodeDump(unitBuffer, xmlTextReaderCurrentDoc(reader), unit, 0, 0) < 0 ||
+            xmlTextWriterWriteRaw(writer, xmlBufferContent(unitBuffer)) < 0) {
+            ok = false;
+            break;
+        }
+
+        ret = xmlTextReaderNext(reader);
     }
+
+    if (ok && ret == 0) {
+        ok = xmlTextWriterEndDocument(writer) >= 0;
+    }
+
+    xmlBufferFree(unitBuffer);
+
+    if (ret != 0 || !ok) {
+        std::cerr << "Failed to rewrite " << name << "\n";
+        return false;
+    }
+    if (ordinal != translations.size()) {
+        std::cerr << "Got " << translations.size() << " translations for " << ordinal << " text nodes.\n";
+    }
+    return true;
+}
+
+// Text parts are listed in [Content_Types].xml, word/document.xml always comes first
+std::vector<std::string> DocxTranslator::findTextParts(const std::string& unzippedDir) {
+    std::string contentTypesPath = unzippedDir + "/[Content_Types].xml";
+    std::ifstream contentTypesFile(std::filesystem::u8path(contentTypesPath), std::ios::binary);
+    if (!contentTypesFile.is_open()) {
+        std::cerr << "[Content_Types].xml not found, only translating word/document.xml" << "\n";
+        return {"word/document.xml"};
+    }
+
+    std::string contentTypes((std::istreambuf_iterator<char>(contentTypesFile)), std::istreambuf_iterator<char>());
+    return parseTextParts(contentTypes, [&unzippedDir](const std::string& name) {
+        return std::filesystem::exists(std::filesystem::u8path(unzippedDir + "/" + name));
+    });
+}
+
+std::vector<std::string> DocxTranslator::parseTextParts(const std::string& contentTypesXml, const std::function<bool(const std::string&)>& partExists) {
+    static const std::unordered_set<std::string> textContentTypes = {
+        "application/vnd.openxmlformats-officedocument.wordprocessingml.document.main+xml",
+        "application/vnd.ms-word.document.macroEnabled.main+xml",
+        "application/vnd.openxmlformats-officedocument.wordprocessingml.template.main+xml",
+        "application/vnd.openxmlformats-officedocument.wordprocessingml.header+xml",
+        "application/vnd.openxmlformats-officedocument.wordprocessingml.footer+xml",
+        "application/vnd.openxmlformats-officedocument.wordprocessingml.footnotes+xml",
+        "application/vnd.openxmlformats-officedocument.wordprocessingml.endnotes+xml",
+        "application/vnd.openxmlformats-officedocument.wordprocessingml.comments+xml"
+    };
+
+    std::vector<std::string> parts = {"word/document.xml"};
+
+    xmlDocPtr doc = XmlParsingService::forCurrentThread().parseXmlMemory(contentTypesXml, NULL, XML_PARSE_NONET);
+    if (doc == NULL) {
+        std::cerr << "Failed to parse [Content_Types].xml, only translating word/document.xml" << "\n";
+        return parts;
+    }
+
+    xmlNode* root = xmlDocGetRootElement(doc);
+    for (xmlNode* node = root ? root->children : NULL; node; node = node->next) {
+        if (node->type != XML_ELEMENT_NODE || xmlStrcmp(node->name, BAD_CAST "Override") != 0) {
+            continue;
+        }
+
+        xmlChar* partName = xmlGetProp(node, BAD_CAST "PartName");
+        xmlChar* contentType = xmlGetProp(node, BAD_CAST "ContentType");
+        if (partName && contentType && textContentTypes.count((const char*)contentType) > 0) {
+            // Part names are absolute inside the package: "/word/header1.xml"
+            std::string name = (const char*)partName;
+            if (!name.empty() && name[0] == '/') {
+                name.erase(0, 1);
+            }
+            // Nothing outside word/ is rewritten, and a name must not leave the unzipped directory
+            bool inWordDir = name.rfind("word/", 0) == 0 && name.find("..") == std::string::npos;
+            if (inWordDir && std::find(parts.begin(), parts.end(), name) == parts.end() && partExists(name)) {
+                parts.push_back(name);
+            }
+        }
+        xmlFree(partName);
+        xmlFree(contentType);
+    }
+
+    xmlFreeDoc(doc);
+    return parts;
+}
+
+bool DocxTranslator::readZipEntry(zip_t* archive, const std::string& name, std::string& content) {
+    zip_stat_t stat;
+    if (zip_stat(archive, name.c_str(), 0, &stat) != 0 || !(stat.valid & ZIP_STAT_SIZE)) {
+        return false;
+    }
+
+    zip_file_t* file = zip_fopen(archive, name.c_str(), 0);
+    if (file == nullptr) {
+        return false;
+    }
+
+    content.resize(stat.size);
+    zip_int64_t bytesRead = zip_fread(file, content.data(), stat.size);
+    zip_fclose(file);
+    return bytesRead == static_cast<zip_int64_t>(stat.size);
+}
+
+// Reads the text parts straight from the DOCX, nothing is unzipped to disk
+bool DocxTranslator::readTextParts(const std::string& docxPath, std::vector<DocxPart>& parts) {
+    int err = 0;
+    zip_t* archive = zip_open(docxPath.c_str(), ZIP_RDONLY, &err);
+    if (archive == nullptr) {
+        std::cerr << "Error opening ZIP archive: " << docxPath << "\n";
+        return false;
+    }
+
+    std::vector<std::string> partNames = {"word/document.xml"};
+    std::string contentTypes;
+    if (readZipEntry(archive, "[Content_Types].xml", contentTypes)) {
+        partNames = parseTextParts(contentTypes, [archive](const std::string& name) {
+            return zip_name_locate(archive, name.c_str(), 0) >= 0;
+        });
+    } else {
+        std::cerr << "[Content_Types].xml not found, only translating word/document.xml" << "\n";
+    }
+
+    for (const std::string& name : partNames) {
+        DocxPart part;
+        part.name = name;
+        if (!readZipEntry(archive, name, part.xml)) {
+            std::cerr << (name == "word/document.xml" ? "document.xml file not found in DOCX archive." : "Failed to read " + name) << "\n";
+            zip_close(archive);
+            return false;
+        }
+        parts.push_back(std::move(part));
+    }
+
+    zip_close(archive);
+    return true;
+}
+
+// Entries are written in their original order. Parts in `parts` come from
+// their buffers, every other entry is copied compressed as it is, so media
+// is never inflated and deflated again.
+bool DocxTranslator::repackDocx(const std::string& inputPath, const std::string& docxPath, const std::vector<DocxPart>& parts) {
+    std::unordered_map<std::string, const DocxPart*> replacedParts;
+    for (const DocxPart& part : parts) {
+        replacedParts[part.name] = &part;
+    }
+
+    int err = 0;
+    zip_t* source = zip_open(inputPath.c_str(), ZIP_RDONLY, &err);
+    if (source == nullptr) {
+        std::cerr << "Error opening ZIP archive: " << inputPath << "\n";
+        return false;
+    }
+
+    zip_t* archive = zip_open(docxPath.c_str(), ZIP_CREATE | ZIP_TRUNCATE, &err);
+    if (archive == nullptr) {
+        std::cerr << "Error creating ZIP archive: " << docxPath << "\n";
+        zip_close(source);
+        return false;
+    }
+
+    zip_int64_t numEntries = zip_get_num_entries(source, 0);
+    for (zip_uint64_t i = 0; i < static_cast<zip_uint64_t>(numEntries); ++i) {
+        const char* name = zip_get_name(source, i, 0);
+        if (name == nullptr) {
+            std::cerr << "Error getting file name in ZIP archive." << "\n";
+            zip_discard(archive);
+            zip_close(source);
+            return false;
+        }
+
+        std::string entryName = name;
+        zip_int64_t index = -1;
+        if (!entryName.empty() && entryName.back() == '/') {
+            index = zip_dir_add(archive, name, ZIP_FL_ENC_UTF_8);
+        } else {
+            auto replaced = replacedParts.find(entryName);
+            // The buffers stay alive until zip_close below, the source archive as well
+            zip_source_t* entrySource = replaced != replacedParts.end()
+                ? zip_source_buffer(archive, replaced->second->xml.data(), replaced->second->xml.size(), 0)
+                : zip_source_zip_file(archive, source, i, ZIP_FL_COMPRESSED, 0, -1, nullptr);
+            if (entrySource == nullptr) {
+                std::cerr << "Error creating zip_source_t for file: " << entryName << "\n";
+                zip_discard(archive);
+                zip_close(source);
+                return false;
+            }
+
+            index = zip_file_add(archive, name, entrySource, ZIP_FL_ENC_UTF_8);
+            if (index < 0) {
+                zip_source_free(entrySource);
+            }
+        }
+
+        if (index < 0) {
+            std::cerr << "Error adding file to ZIP archive: " << entryName << "\n";
+            zip_discard(archive);
+            zip_close(source);
+            return false;
+        }
+    }
+
+    bool closed = zip_close(archive) == 0;
+    if (!closed) {
+        std::cerr << "Error closing ZIP archive: " << docxPath << "\n";
+        zip_discard(archive);
+    }
+    zip_close(source);
+
+    if (closed) {
+        std::cout << "DOCX file created: " << docxPath << "\n";
+    }
+    return closed;
+}
+
+bool DocxTranslator::extractPart(DocxPart& part) {
+    // Parts read from the archive have no path on disk
+    bool inMemory = part.xmlPath.empty();
+
+    // A body too large to hold as a DOM is streamed whatever the setting
+    std::error_code sizeError;
+    size_t partSize = inMemory ? part.xml.size() : static_cast<size_t>(std::filesystem::file_size(std::filesystem::u8path(part.xmlPath), sizeError));
+    part.streaming = streamingXml || (streamingThreshold > 0 && !sizeError && partSize >= streamingThreshold);
+    if (part.streaming && !streamingXml) {
+        std::cout << "Streaming " << part.name << " (" << partSize / (1024 * 1024) << " MB)" << "\n";
+    }
+
+    if (part.streaming) {
+        // Only the text is kept, the part is read again when the translations go in
+        bool extracted = false;
+        if (inMemory) {
+            xmlTextReaderPtr reader = xmlReaderForMemory(part.xml.data(), static_cast<int>(part.xml.size()), part.name.c_str(), NULL, XML_PARSE_HUGE | XML_PARSE_NONET);
+            if (reader != NULL) {
+                extracted = extractTextNodesStreaming(reader, part.nodes);
+                xmlFreeTextReader(reader);
+            }
+        } else {
+            extracted = extractTextNodesStreaming(part.xmlPath, part.nodes);
+        }
+        if (!extracted) {
+            std::cerr << "Failed to read " << part.name << "\n";
+            return false;
+        }
+    } else {
+        // Without its own dictionary the document can be changed and freed on
+        // another thread than the one that parsed it
+        XmlParsingService& parser = XmlParsingService::forCurrentThread();
+        part.doc = inMemory ? parser.parseXmlMemory(part.xml, NULL, XML_PARSE_NODICT | XML_PARSE_HUGE)
+                            : parser.parseXmlFile(part.xmlPath, NULL, XML_PARSE_NODICT);
+        // The document is serialized again from the DOM, no need to hold both
+        std::string().swap(part.xml);
+        if (part.doc == NULL) {
+            std::cerr << "Failed to parse " << part.name << "\n";
+            return false;
+        }
+
+        // The nodes stay valid until the document is freed in writePart
+        part.nodes = extractTextNodes(xmlDocGetRootElement(part.doc));
+    }
+
+    // Runs of one paragraph go to the model together
+    part.segments = buildSegments(part.nodes);
+    return true;
+}
+
+std::vector<std::string> DocxTranslator::buildTranslationBatch(std::vector<DocxPart>& parts) {
+    std::vector<std::string> batch;
+    std::unordered_map<std::string, size_t> lineOfText;
+
+    for (DocxPart& part : parts) {
+        part.batchLines.clear();
+        part.batchLines.reserve(part.segments.size());
+        for (const DocxSegment& segment : part.segments) {
+            auto inserted = lineOfText.emplace(segment.text, batch.size());
+            if (inserted.second) {
+                batch.push_back(segment.text);
+            }
+            part.batchLines.push_back(inserted.first->second);
+        }
+    }
+    return batch;
+}
+
+bool DocxTranslator::writePart(DocxPart& part, const std::vector<std::string>& batchTranslations) {
+    std::vector<std::string> segmentTranslations;
+    segmentTranslations.reserve(part.batchLines.size());
+    for (size_t line : part.batchLines) {
+        segmentTranslations.push_back(line < batchTranslations.size() ? batchTranslations[line] : std::string());
+    }
+
+    std::vector<std::optional<std::string>> translations = distributeTranslations(part.nodes, part.segments, segmentTranslations);
+    escapeTranslations(translations);
+
+    bool inMemory = part.xmlPath.empty();
+
+    if (part.streaming && inMemory) {
+        xmlTextReaderPtr reader = xmlReaderForMemory(part.xml.data(), static_cast<int>(part.xml.size()), part.name.c_str(), NULL, XML_PARSE_HUGE | XML_PARSE_NONET);
+        xmlBufferPtr buffer = xmlBufferCreate();
+        xmlTextWriterPtr writer = buffer ? xmlNewTextWriterMemory(buffer, 0) : NULL;
+
+        bool rewritten = reader != NULL && writer != NULL && rewriteDocumentStreaming(reader, writer, part.name, translations);
+        // Freeing the writer flushes the rest of the output into the buffer
+        if (writer) xmlFreeTextWriter(writer);
+        if (reader) xmlFreeTextReader(reader);
+
+        if (rewritten) {
+            part.xml.assign((const char*)xmlBufferContent(buffer), xmlBufferLength(buffer));
+        } else {
+            std::cerr << "Failed to save " << part.name << "\n";
+        }
+        if (buffer) xmlBufferFree(buffer);
+        return rewritten;
+    }
+
+    if (part.streaming) {
+        std::string rewrittenXmlPath = part.xmlPath + ".translated";
+        if (!rewriteDocumentStreaming(part.xmlPath, rewrittenXmlPath, translations)) {
+            std::cerr << "Failed to save " << part.name << "\n";
+            return false;
+        }
+        std::filesystem::rename(std::filesystem::u8path(rewrittenXmlPath), std::filesystem::u8path(part.xmlPath));
+        return true;
+    }
+
+    // Reinsert the translations into the XML document
+    reinsertTranslations(part.nodes, translations);
+
+    bool saved = false;
+    if (inMemory) {
+        xmlChar* xml = NULL;
+        int size = 0;
+        xmlDocDumpMemoryEnc(part.doc, &xml, &size, "UTF-8");
+        if (xml != NULL) {
+            part.xml.assign((const char*)xml, size);
+            xmlFree(xml);
+            saved = true;
+        }
+    } else {
+        saved = xmlSaveFileEnc(part.xmlPath.c_str(), part.doc, "UTF-8") != -1;
+    }
+    if (!saved) {
+        std::cerr << "Failed to save " << part.name << "\n";
+    }
+
+    xmlFreeDoc(part.doc);
+    part.doc = NULL;
+    part.nodes.clear();
+    return saved;
+}
+
+// Parts are handed out one at a time, the body is usually far larger than the rest
+bool DocxTranslator::forEachPart(std::vector<DocxPart>& parts, const std::function<bool(DocxPart&)>& work) {
+    size_t workerCount = partThreads > 0 ? partThreads : std::thread::hardware_concurrency();
+    workerCount = std::max<size_t>(1, std::min(workerCount, parts.size()));
+
+    std::atomic<size_t> nextPart{0};
+    std::atomic<bool> failed{false};
+
+    auto worker = [&]() {
+        for (size_t i = nextPart++; i < parts.size(); i = nextPart++) {
+            if (!work(parts[i])) {
+                failed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < workerCount; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    return !failed;
+}
+
+void DocxTranslator::setPartThreads(size_t threads) {
+    partThreads = threads;
+}
+
+void DocxTranslator::setInMemoryRepack(bool enabled) {
+    inMemoryRepack = enabled;
 }
 
 void DocxTranslator::exportDocx(const std::string& exportPath, const std::string& outputDir) {
@@ -566,9 +1206,11 @@ std::string DocxTranslator::escapeForDocx(const std::string& input) {
     return escaped;
 }
 
-void DocxTranslator::escapeTranslations(std::unordered_multimap<std::string, std::string>& translations) {
-    for (auto& pair : translations) {
-        pair.second = escapeForDocx(pair.second);
+void DocxTranslator::escapeTranslations(std::vector<std::optional<std::string>>& translations) {
+    for (auto& translation : translations) {
+        if (translation) {
+            *translation = escapeForDocx(*translation);
+        }
     }
 }
 
@@ -580,50 +1222,15 @@ size_t DocxTranslator::writeCallback(void* contents, size_t size, size_t nmemb,
 }
 
 DocumentInfo DocxTranslator::uploadDocumentToDeepL(const std::string& filePath, const std::string& deepLKey) {
-    CURL* curl;
-    CURLcode res;
-    std::string response_string;
-    std::string api_url = "https://api-free.deepl.com/v2/document";
-    std::string auth_key = "DeepL-Auth-Key " + deepLKey;
-
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl = curl_easy_init();
+    DeepLResponse response = DeepLClient::shared().uploadDocument(deepLApiUrl, deepLKey, filePath, "EN", deepLPollSettings.transferLimits()).get();
 
-    if (curl) {
-        struct curl_slist* headers = nullptr;
-        headers = curl_slist_append(headers, ("Authorization: " + auth_key).c_str());
-
-        // Prepare the multipart form data
-        curl_mime* form = curl_mime_init(curl);
-        curl_mimepart* field = curl_mime_addpart(form);
-        curl_mime_name(field, "target_lang");
-        curl_mime_data(field, "EN", CURL_ZERO_TERMINATED); // Change to desired target language
-        field = curl_mime_addpart(form);
-        curl_mime_name(field, "file");
-        curl_mime_filedata(field, filePath.c_str());  // Path to the file you want to upload
-
-        curl_easy_setopt(curl, CURLOPT_URL, api_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_MIMEPOST, form);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
-
-        // Perform the request
-        res = curl_easy_perform(curl);
-
-        if (res != CURLE_OK) {
-            std::cerr << "Curl upload request failed: " << curl_easy_strerror(res) << std::endl;
-        }
-
-        curl_mime_free(form);
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
+    if (response.curlCode != CURLE_OK) {
+        std::cerr << "Curl upload request failed: " << response.error << std::endl;
     }
-    curl_global_cleanup();
 
     try {
-        std::cout << "Document upload response: " << response_string << std::endl;
-        nlohmann::json jsonResponse = nlohmann::json::parse(response_string);
+        std::cout << "Document upload response: " << response.body << std::endl;
+        nlohmann::json jsonResponse = nlohmann::json::parse(response.body);
         DocumentInfo docInfo;
         docInfo.id = jsonResponse["document_id"];
         docInfo.key = jsonResponse["document_key"];
@@ -634,48 +1241,22 @@ DocumentInfo DocxTranslator::uploadDocumentToDeepL(const std::string& filePath,
     }
 }
 
-std::string DocxTranslator::checkDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey) {
-    CURL* curl;
-    CURLcode res;
-    std::string response_string;
-    std::string api_url = "https://api-free.deepl.com/v2/document/" + document_id;
-    std::string auth_key = "DeepL-Auth-Key " + deepLKey;
-
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl = curl_easy_init();
-
-    if (curl) {
-        struct curl_slist* headers = nullptr;
-        headers = curl_slist_append(headers, ("Authorization: " + auth_key).c_str());
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-
-        // Create JSON payload
-        nlohmann::json jsonPayload;
-        jsonPayload["document_key"] = document_key;
-        std::string json_data = jsonPayload.dump();
-
-        curl_easy_setopt(curl, CURLOPT_URL, api_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_POST, 1);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
-
-        // Perform the request
-        res = curl_easy_perform(curl);
-
-        if (res != CURLE_OK) {
-            std::cerr << "Curl status check request failed: " << curl_easy_strerror(res) << std::endl;
-        }
+std::future<DeepLResponse> DocxTranslator::requestDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey) {
+    nlohmann::json jsonPayload;
+    jsonPayload["document_key"] = document_key;
+    return DeepLClient::shared().postJson(deepLApiUrl + "/" + document_id, deepLKey, jsonPayload.dump(), deepLPollSettings.transferLimits());
+}
 
-        std::cout << "Document status response: " << response_string << std::endl;
+std::string DocxTranslator::checkDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey) {
+    DeepLResponse response = requestDocumentStatus(document_id, document_key, deepLKey).get();
 
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
+    if (response.curlCode != CURLE_OK) {
+        std::cerr << "Curl status check request failed: " << response.error << std::endl;
     }
-    curl_global_cleanup();
 
-    return response_string;  // You can parse this response to check if status == "done"
+    std::cout << "Document status response: " << response.body << std::endl;
+
+    return response.body;  // You can parse this response to check if status == "done"
 }
 
 int DocxTranslator::handleDeepLRequest(const std::string& inputPath, const std::string& outputPath, const std::string& deepLKey) {
@@ -687,14 +1268,14 @@ int DocxTranslator::handleDeepLRequest(const std::string& inputPath, const std::
     }
 
     // Poll the status until translation is complete
-    while (true) {
-        std::string status = checkDocumentStatus(document.id, document.key, deepLKey);
-        nlohmann::json jsonResponse = nlohmann::json::parse(status);
-        if (jsonResponse["status"] == "done") {
-            break;
-        }
-        std::cout << "Translation in progress... Retrying in 5 seconds." << std::endl;
-        std::this_thread::sleep_for(std::chrono::seconds(5));
+    DeepLPollPolicy pollPolicy(deepLPollSettings);
+    bool isTranslationComplete = pollPolicy.waitUntilDone([&]() {
+        return requestDocumentStatus(document.id, document.key, deepLKey).get();
+    });
+
+    if (!isTranslationComplete) {
+        std::cerr << "DeepL did not finish translating the document." << std::endl;
+        return 1;
     }
 
     // Download and save the translated document
@@ -709,58 +1290,24 @@ int DocxTranslator::handleDeepLRequest(const std::string& inputPath, const std::
 }
 
 bool DocxTranslator::downloadTranslatedDocument(const std::string& document_id, const std::string& document_key, const std::string& deepLKey, const std::string& outputPath) {
-    CURL* curl;
-    CURLcode res;
-    std::string api_url = "https://api-free.deepl.com/v2/document/" + document_id + "/result";
-    std::string auth_key = "DeepL-Auth-Key " + deepLKey;
-
-    curl = curl_easy_init();
-    if (!curl) {
-        std::cerr << "Failed to initialize CURL." << std::endl;
-        return false;
-    }
-
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, ("Authorization: " + auth_key).c_str());
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-
     // Create JSON payload
     nlohmann::json jsonPayload;
     jsonPayload["document_key"] = document_key;
-    std::string json_data = jsonPayload.dump();
 
-    // Open file to write the binary content
-    FILE* file = fopen(outputPath.c_str(), "wb");
-    if (!file) {
-        std::cerr << "Failed to open file for writing: " << outputPath << std::endl;
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
-        fclose(file);
+    DeepLResponse response = DeepLClient::shared().postJson(deepLApiUrl + "/" + document_id + "/result", deepLKey, jsonPayload.dump(), deepLPollSettings.transferLimits()).get();
 
+    if (response.curlCode != CURLE_OK) {
+        std::cerr << "Curl download request failed: " << response.error << std::endl;
         return false;
     }
 
-    curl_easy_setopt(curl, CURLOPT_URL, api_url.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POST, 1);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data.c_str());
-
     // Write response as binary to file
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
-
-    res = curl_easy_perform(curl);
-
-    fclose(file);  // Ensure file is closed even on failure
-
-    if (res != CURLE_OK) {
-        std::cerr << "Curl download request failed: " << curl_easy_strerror(res) << std::endl;
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
+    std::ofstream file(outputPath, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open file for writing: " << outputPath << std::endl;
         return false;
     }
-
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    file.write(response.body.data(), response.body.size());
 
     return true;  // Successfully downloaded and saved the document
 }
@@ -6,12 +6,15 @@
 #include <filesystem>
 #include <string>
 #include <regex>
+#include <optional>
 #include <vector>
 #include <libxml/HTMLparser.h>
 #include <libxml/xpath.h>
 #include <libxml/uri.h>
 #include <libxml/xmlstring.h>
 #include <libxml/encoding.h>
+#include <libxml/xmlreader.h>
+#include <libxml/xmlwriter.h>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
@@ -24,35 +27,134 @@
 #include "Translator.h"
 #include <nlohmann/json.hpp>
 #include <unordered_set>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+#include <algorithm>
 #include "Document.h"
+#include "DeepLClient.h"
+#include "DeepLPollPolicy.h"
+#include "XmlParsingService.h"
 
 #ifdef _WIN32
 #include <boost/process/windows.hpp>
 #endif
 
+// A w:t element with text, kept in document order. Its 1-based index in the
+// extracted list is the number written in front of its text, so the
+// translation of line N goes straight back to element N. Streaming
+// extraction leaves node null, the element is gone once its paragraph is read.
+struct DocxTextNode {
+    xmlNode* node;
+    std::string text;
+    // Consecutive nodes in the same w:p share a number
+    size_t paragraph = 0;
+};
+
+// Consecutive text nodes sent to the model as one line: the runs of a
+// paragraph, or a single run when paragraph segments are turned off
+struct DocxSegment {
+    size_t firstNode;
+    size_t nodeCount;
+    std::string text;
+};
+
+// Where a paragraph's translation goes when its runs are translated together
+// Proportional: split at spaces so each run gets a share matching its original length (default)
+// FirstRun: all of it in the first run, the other runs are emptied
+enum class DocxRunDistribution {
+    Proportional,
+    FirstRun
+};
+
+// A word/*.xml part with text: the document body, a header, footer, footnotes,
+// endnotes or comments. In DOM mode doc stays open from extraction until the
+// translations are written back.
+struct DocxPart {
+    std::string name;
+    // Empty for parts read from the archive, their XML is kept in xml instead
+    std::string xmlPath;
+    std::string xml;
+    xmlDocPtr doc = NULL;
+    std::vector<DocxTextNode> nodes;
+    std::vector<DocxSegment> segments;
+    // Line of the translation batch holding the text of each segment
+    std::vector<size_t> batchLines;
+    // Read and rewritten one paragraph at a time, decided when the part is extracted
+    bool streaming = false;
+};
 
 class DocxTranslator : public Translator {
 public:
     int run(const std::string& inputPath, const std::string& outputPath, int localModel, const std::string& deepLKey, std::string langcode);
     static size_t writeCallback(void* contents, size_t size, size_t nmemb, std::string* output);
 
+    // Reads and rewrites word/document.xml one paragraph at a time instead of
+    // loading it as a whole, for documents too large to keep in memory as a DOM
+    void setStreamingXml(bool streaming);
+    // Parts at least this many bytes are streamed even when streaming is off,
+    // 0 never switches (default 64 MB)
+    void setStreamingThreshold(size_t bytes);
+    // Translates each paragraph as one segment instead of one segment per formatting run
+    void setParagraphSegments(bool enabled, DocxRunDistribution distribution = DocxRunDistribution::Proportional);
+    // Threads used to read and write the text parts, 0 uses one per core
+    void setPartThreads(size_t threads);
+    // Reads the text parts from the DOCX and writes the output straight from
+    // memory, copying every other entry without recompressing it (default).
+    // When off the package is unzipped to disk and zipped again as a whole.
+    void setInMemoryRepack(bool enabled);
+
 
 protected:
     DocumentInfo uploadDocumentToDeepL(const std::string& filePath, const std::string& deepLKey);
+    std::future<DeepLResponse> requestDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey);
     std::string checkDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey);
     int handleDeepLRequest(const std::string& inputPath, const std::string& outputPath, const std::string& deepLKey);
     bool unzip_file(const std::string& zipPath, const std::string& outputDir);
     bool make_directory(const std::filesystem::path& path);
-    std::string getNodePath(xmlNode *node);
-    void extractTextNodesRecursive(xmlNode *node, std::vector<TextNode> &nodes);
-    std::vector<TextNode> extractTextNodes(xmlNode *root);
-    void saveTextToFile(const std::vector<TextNode> &nodes, const std::string &positionFilename, const std::string &textFilename, const std::string &langcode);
-    std::unordered_multimap<std::string, std::string> loadTranslations(const std::string &positionFilename, const std::string &textFilename);
+    void appendTextNode(xmlNode *node, std::vector<DocxTextNode> &nodes);
+    void extractTextNodesRecursive(xmlNode *node, std::vector<DocxTextNode> &nodes);
+    std::vector<DocxTextNode> extractTextNodes(xmlNode *root);
+    static xmlNode* enclosingParagraph(xmlNode *node);
+    void numberParagraphs(std::vector<DocxTextNode> &nodes, size_t first, size_t &nextParagraph);
+    std::vector<DocxSegment> buildSegments(const std::vector<DocxTextNode> &nodes) const;
+    void saveTextToFile(const std::vector<std::string> &texts, const std::string &textFilename, const std::string &langcode);
+    // Entry i holds the translation of segment i, segments without a translation get an empty string
+    std::vector<std::string> loadTranslations(const std::string &textFilename, size_t segmentCount);
+    // Per node text to write back, nullopt keeps the original
+    std::vector<std::optional<std::string>> distributeTranslations(const std::vector<DocxTextNode> &nodes, const std::vector<DocxSegment> &segments, const std::vector<std::string> &translations) const;
+    static std::vector<std::string> splitProportionally(const std::string &translation, const std::vector<size_t> &weights);
     void updateNodeWithTranslation(xmlNode *node, const std::string &translation);
-    void traverseAndReinsert(xmlNode *node, std::unordered_multimap<std::string, std::string> &translations, std::unordered_map<std::string, std::unordered_multimap<std::string, std::string>::iterator> &lastUsed);
-    void reinsertTranslations(xmlNode *root, std::unordered_multimap<std::string, std::string> &translations);
+    void reinsertTranslations(const std::vector<DocxTextNode> &nodes, const std::vector<std::optional<std::string>> &translations);
+    // Both passes visit the w:t elements in the same order as extractTextNodes
+    bool extractTextNodesStreaming(const std::string &xmlPath, std::vector<DocxTextNode> &nodes);
+    bool extractTextNodesStreaming(xmlTextReaderPtr reader, std::vector<DocxTextNode> &nodes);
+    bool rewriteDocumentStreaming(const std::string &inputXmlPath, const std::string &outputXmlPath, const std::vector<std::optional<std::string>> &translations);
+    bool rewriteDocumentStreaming(xmlTextReaderPtr reader, xmlTextWriterPtr writer, const std::string &name, const std::vector<std::optional<std::string>> &translations);
+    static bool isStreamingUnit(xmlTextReaderPtr reader);
+    bool copyReaderNode(xmlTextReaderPtr reader, xmlTextWriterPtr writer);
+    std::vector<std::string> findTextParts(const std::string& unzippedDir);
+    std::vector<std::string> parseTextParts(const std::string& contentTypesXml, const std::function<bool(const std::string&)>& partExists);
+    bool readZipEntry(zip_t* archive, const std::string& name, std::string& content);
+    bool readTextParts(const std::string& docxPath, std::vector<DocxPart>& parts);
+    bool repackDocx(const std::string& inputPath, const std::string& docxPath, const std::vector<DocxPart>& parts);
+    bool extractPart(DocxPart& part);
+    // Distinct segment texts over all parts, each part's batchLines point into the result
+    std::vector<std::string> buildTranslationBatch(std::vector<DocxPart>& parts);
+    bool writePart(DocxPart& part, const std::vector<std::string>& batchTranslations);
+    // Runs work on every part concurrently, false when it failed for any of them
+    bool forEachPart(std::vector<DocxPart>& parts, const std::function<bool(DocxPart&)>& work);
     void exportDocx(const std::string& exportPath, const std::string& outputDir);
     std::string escapeForDocx(const std::string& input);
-    void escapeTranslations(std::unordered_multimap<std::string, std::string>& translations);
+    void escapeTranslations(std::vector<std::optional<std::string>>& translations);
     bool downloadTranslatedDocument(const std::string& document_id, const std::string& document_key, const std::string& deepLKey, const std::string& outputPath);
+
+    std::string deepLApiUrl = "https://api-free.deepl.com/v2/document";
+    DeepLPollPolicy::Settings deepLPollSettings;
+    bool streamingXml = false;
+    size_t streamingThreshold = 64 * 1024 * 1024;
+    bool paragraphSegments = true;
+    DocxRunDistribution runDistribution = DocxRunDistribution::Proportional;
+    size_t partThreads = 0;
+    bool inMemoryRepack = true;
 };
\ No newline at end of file
@@ -90,23 +90,109 @@ bool EpubTranslator::containsJapanese(const std::string& text) {
     return false;
 }
 
+bool EpubTranslator::isWordChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+bool EpubTranslator::isSpaceChar(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+bool EpubTranslator::findElementBlock(const std::string& content, const std::string& tagName, std::string& innerContent) {
+    // Hand-written equivalent of <tagName\b[^>]*>([\s\S]*?)</tagName>
+    const std::string openTag = "<" + tagName;
+    const std::string closeTag = "</" + tagName + ">";
+
+    size_t start = content.find(openTag);
+    while (start != std::string::npos) {
+        size_t afterName = start + openTag.size();
+        // \b after the tag name: the next character must not continue the word
+        if (afterName >= content.size() || !isWordChar(content[afterName])) {
+            break;
+        }
+        start = content.find(openTag, start + 1);
+    }
+
+    if (start == std::string::npos) {
+        return false;
+    }
+
+    size_t openEnd = content.find('>', start + openTag.size());
+    if (openEnd == std::string::npos) {
+        return false;
+    }
+
+    size_t closeStart = content.find(closeTag, openEnd + 1);
+    if (closeStart == std::string::npos) {
+        return false;
+    }
+
+    innerContent.assign(content, openEnd + 1, closeStart - openEnd - 1);
+    return true;
+}
+
+std::vector<std::string> EpubTranslator::collectTags(const std::string& content) {
+    // Hand-written equivalent of iterating <[^>]+> over the content
+    std::vector<std::string> tags;
+    size_t pos = 0;
+
+    while ((pos = content.find('<', pos)) != std::string::npos) {
+        size_t end = content.find('>', pos + 1);
+        if (end == std::string::npos) {
+            break;  // No later '<' can be closed either
+        }
+        if (end == pos + 1) {
+            pos++;  // "<>" is not a tag, retry from the next character
+            continue;
+        }
+        tags.emplace_back(content, pos, end - pos + 1);
+        pos = end + 1;
+    }
+
+    return tags;
+}
+
+bool EpubTranslator::findQuotedAttribute(const std::string& text, const std::string& name, bool requireWordBoundary, bool allowEmptyValue, size_t& pos, std::string& value) {
+    // Hand-written equivalent of (\b)name\s*=\s*"([^"]*)" searching from pos
+    for (size_t start = text.find(name, pos); start != std::string::npos; start = text.find(name, start + 1)) {
+        if (requireWordBoundary && start > 0 && isWordChar(text[start - 1])) {
+            continue;
+        }
+
+        size_t i = start + name.size();
+        while (i < text.size() && isSpaceChar(text[i])) i++;
+        if (i >= text.size() || text[i] != '=') continue;
+        i++;
+        while (i < text.size() && isSpaceChar(text[i])) i++;
+        if (i >= text.size() || text[i] != '"') continue;
+
+        size_t valueStart = i + 1;
+        size_t valueEnd = text.find('"', valueStart);
+        if (valueEnd == std::string::npos) continue;
+        if (valueEnd == valueStart && !allowEmptyValue) continue;
+
+        value.assign(text, valueStart, valueEnd - valueStart);
+        pos = valueEnd + 1;
+        return true;
+    }
+
+    return false;
+}
+
 std::string EpubTranslator::extractSpineContent(const std::string& content) {
-    std::regex spinePattern(R"(<spine\b[^>]*>([\s\S]*?)<\/spine>)");
-    std::smatch match;
-    if (std::regex_search(content, match, spinePattern)) {
-        return match[1].str();
+    std::string spineContent;
+    if (findElementBlock(content, "spine", spineContent)) {
+        return spineContent;
     }
     throw std::runtime_error("No <spine> tag found in the OPF file.");
 }
 
 std::vector<std::string> EpubTranslator::extractIdrefs(const std::string& spineContent) {
     std::vector<std::string> idrefs;
-    std::regex idrefPattern(R"(idref\s*=\s*"([^\"]*)\")");
-    auto begin = std::sregex_iterator(spineContent.begin(), spineContent.end(), idrefPattern);
-    auto end = std::sregex_iterator();
+    std::string idref;
+    size_t pos = 0;
 
-    for (auto it = begin; it != end; ++it) {
-        std::string idref = (*it)[1].str();
+    while (findQuotedAttribute(spineContent, "idref", false, true, pos, idref)) {
         idrefs.push_back(idref);
     }
     return idrefs;
@@ -191,23 +277,15 @@ std::vector<std::filesystem::path> EpubTranslator::sortXHTMLFilesBySpineOrder(co
 std::vector<std::pair<std::string, std::string>> EpubTranslator::extractManifestIds(const std::vector<std::string>& manifestItems) {
     std::vector<std::pair<std::string, std::string>> idToFileMapping;
 
-    // Separate regex patterns for extracting id and href
-    std::regex idPattern(R"(\bid\s*=\s*\"([^\"]+)\")");
-    std::regex hrefPattern(R"(\bhref\s*=\s*\"([^\"]+)\")");
-
     for (const std::string& item : manifestItems) {
-        std::smatch idMatch, hrefMatch;
         std::string id, href;
+        size_t idPos = 0, hrefPos = 0;
 
         // Extract id attribute
-        if (std::regex_search(item, idMatch, idPattern)) {
-            id = idMatch[1].str();
-        }
+        findQuotedAttribute(item, "id", true, false, idPos, id);
 
         // Extract href attribute
-        if (std::regex_search(item, hrefMatch, hrefPattern)) {
-            href = hrefMatch[1].str();            
-        }
+        findQuotedAttribute(item, "href", true, false, hrefPos, href);
 
         // Ensure both id and href are found before adding to the mapping
         if (!id.empty() && !href.empty()) {
@@ -229,42 +307,34 @@ std::pair<std::vector<std::string>, std::vector<std::string>> EpubTranslator::pa
 
     // Concatenate the content into a single string.
     std::string combinedContent;
+    size_t totalSize = 0;
+    for (const auto& line : content) {
+        totalSize += line.size();
+    }
+    combinedContent.reserve(totalSize);
     for (const auto& line : content) {
         combinedContent += line;  // Removes newlines
     }
 
-    // Regex patterns to extract the entire <manifest>...</manifest> and <spine>...</spine> blocks.
-    std::regex manifestBlockPattern(R"(<manifest\b[^>]*>([\s\S]*?)</manifest>)");
-    std::regex spineBlockPattern(R"(<spine\b[^>]*>([\s\S]*?)</spine>)");
-    std::regex tagPattern(R"(<[^>]+>)");  // Matches any XML/HTML tag
-
-    std::smatch match;
+    std::string blockContent;
 
     // Extract and parse the <manifest> block.
-    if (std::regex_search(combinedContent, match, manifestBlockPattern)) {
+    if (findElementBlock(combinedContent, "manifest", blockContent)) {
         manifest.push_back("\n<manifest>\n");  // Add opening tag
 
-        std::string manifestContent = match[1].str();  // Content between <manifest> and </manifest>
-        auto tagBegin = std::sregex_iterator(manifestContent.begin(), manifestContent.end(), tagPattern);
-        auto tagEnd = std::sregex_iterator();
-
-        for (auto it = tagBegin; it != tagEnd; ++it) {
-            manifest.push_back(it->str() + "\n");  // Add each tag within <manifest>
+        for (const auto& tag : collectTags(blockContent)) {
+            manifest.push_back(tag + "\n");  // Add each tag within <manifest>
         }
 
         manifest.push_back("\n</manifest>\n");  // Add closing tag
     }
 
     // Extract and parse the <spine> block.
-    if (std::regex_search(combinedContent, match, spineBlockPattern)) {
+    if (findElementBlock(combinedContent, "spine", blockContent)) {
         spine.push_back("\n<spine>\n");  // Add opening tag
 
-        std::string spineContent = match[1].str();  // Content between <spine> and </spine>
-        auto tagBegin = std::sregex_iterator(spineContent.begin(), spineContent.end(), tagPattern);
-        auto tagEnd = std::sregex_iterator();
-
-        for (auto it = tagBegin; it != tagEnd; ++it) {
-            spine.push_back(it->str() + "\n");  // Add each tag within <spine>
+        for (const auto& tag : collectTags(blockContent)) {
+            spine.push_back(tag + "\n");  // Add each tag within <spine>
         }
 
         spine.push_back("\n</spine>\n");  // Add closing tag
@@ -360,11 +430,28 @@ void EpubTranslator::removeSection0001Tags(const std::filesystem::path& contentO
     std::string content = buffer.str();
     inputFile.close();
 
-    // Regex to match tags containing "Section0001.xhtml"
-    std::regex sectionRegex(R"(<[^>]*Section0001\.xhtml[^>]*>)");
+    // Remove all tags containing "Section0001.xhtml" (same matches as <[^>]*Section0001\.xhtml[^>]*>)
+    const std::string_view sectionName = "Section0001.xhtml";
+    std::string filtered;
+    filtered.reserve(content.size());
 
-    // Remove all matching tags
-    content = std::regex_replace(content, sectionRegex, "");
+    size_t pos = 0;
+    size_t tagStart;
+    while ((tagStart = content.find('<', pos)) != std::string::npos) {
+        size_t tagEnd = content.find('>', tagStart + 1);
+        if (tagEnd == std::string::npos) {
+            break;
+        }
+
+        std::string_view tag(content.data() + tagStart, tagEnd - tagStart + 1);
+        filtered.append(content, pos, tagStart - pos);
+        if (tag.find(sectionName) == std::string_view::npos) {
+            filtered.append(tag);
+        }
+        pos = tagEnd + 1;
+    }
+    filtered.append(content, pos, std::string::npos);
+    content = std::move(filtered);
 
     // Write the modified content back to the file
     std::ofstream outputFile(contentOpfPath);
@@ -747,7 +834,7 @@ std::string EpubTranslator::readChapterFile(const std::filesystem::path& chapter
 }
 
 htmlDocPtr EpubTranslator::parseHtmlDocument(const std::string& content) {
-    htmlDocPtr doc = htmlReadMemory(content.c_str(), content.size(), NULL, "UTF-8", HTML_PARSE_RECOVER | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
+    htmlDocPtr doc = XmlParsingService::forCurrentThread().parseHtmlMemory(content, "UTF-8", HTML_PARSE_RECOVER | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
     if (!doc) {
         throw std::runtime_error("Failed to parse HTML content.");
     }
@@ -800,6 +887,8 @@ xmlNodeSetPtr EpubTranslator::extractNodesFromDoc(htmlDocPtr doc) {
 
 void EpubTranslator::cleanChapter(const std::filesystem::path& chapterPath) {
     try {
+        // No-op unless document arenas were enabled at startup
+        XmlParsingService::DocumentArena arena;
         std::string content = readChapterFile(chapterPath);
 
         htmlDocPtr doc = parseHtmlDocument(content);
@@ -821,10 +910,23 @@ void EpubTranslator::cleanChapter(const std::filesystem::path& chapterPath) {
 }
 
 std::string EpubTranslator::stripHtmlTags(const std::string& input) {
-    // Regular expression to match HTML tags
-    std::regex tagRegex("<[^>]*>");
-    // Replace all occurrences of HTML tags with an empty string
-    return std::regex_replace(input, tagRegex, "");
+    // Removes every <...> span, same as replacing <[^>]*> with an empty string
+    std::string output;
+    output.reserve(input.size());
+
+    size_t pos = 0;
+    size_t tagStart;
+    while ((tagStart = input.find('<', pos)) != std::string::npos) {
+        size_t tagEnd = input.find('>', tagStart + 1);
+        if (tagEnd == std::string::npos) {
+            break;  // An unclosed '<' is kept as text
+        }
+        output.append(input, pos, tagStart - pos);
+        pos = tagEnd + 1;
+    }
+    output.append(input, pos, std::string::npos);
+
+    return output;
 }
 
 tagData EpubTranslator::processImgTag(xmlNodePtr node, int position, int chapterNum) {
@@ -896,6 +998,7 @@ std::vector<tagData> EpubTranslator::extractTags(const std::vector<std::filesyst
 
     for (const auto& chapterPath : chapterPaths) {
         try {
+            XmlParsingService::DocumentArena arena;
             std::string data = readFileUtf8(chapterPath);
             htmlDocPtr doc = parseHtmlDocument(data);
             if (!doc) continue;
@@ -951,51 +1054,16 @@ size_t EpubTranslator::writeCallback(void* contents, size_t size, size_t nmemb,
 }
 
 std::string EpubTranslator::uploadDocumentToDeepL(const std::string& filePath, const std::string& deepLKey) {
-    CURL* curl;
-    CURLcode res;
-    std::string response_string;
-    std::string api_url = "https://api-free.deepl.com/v2/document";
-    std::string auth_key = "DeepL-Auth-Key " + deepLKey;
-
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl = curl_easy_init();
+    DeepLResponse response = DeepLClient::shared().uploadDocument(deepLApiUrl, deepLKey, filePath, "EN", deepLPollSettings.transferLimits()).get();
 
-    if (curl) {
-        struct curl_slist* headers = nullptr;
-        headers = curl_slist_append(headers, ("Authorization: " + auth_key).c_str());
-
-        // Prepare the multipart form data
-        curl_mime* form = curl_mime_init(curl);
-        curl_mimepart* field = curl_mime_addpart(form);
-        curl_mime_name(field, "target_lang");
-        curl_mime_data(field, "EN", CURL_ZERO_TERMINATED); // Change to desired target language
-        field = curl_mime_addpart(form);
-        curl_mime_name(field, "file");
-        curl_mime_filedata(field, filePath.c_str());  // Path to the file you want to upload
-
-        curl_easy_setopt(curl, CURLOPT_URL, api_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_MIMEPOST, form);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
-
-        // Perform the request
-        res = curl_easy_perform(curl);
-
-        if (res != CURLE_OK) {
-            std::cerr << "Curl upload request failed: " << curl_easy_strerror(res) << std::endl;
-        }
-
-        curl_mime_free(form);
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
+    if (response.curlCode != CURLE_OK) {
+        std::cerr << "Curl upload request failed: " << response.error << std::endl;
     }
-    curl_global_cleanup();
 
     // Assuming the response contains document_id and document_key, extract them
     try {
-        std::cout << "Document upload response: " << response_string << std::endl;
-        nlohmann::json jsonResponse = nlohmann::json::parse(response_string);
+        std::cout << "Document upload response: " << response.body << std::endl;
+        nlohmann::json jsonResponse = nlohmann::json::parse(response.body);
         std::string document_id = jsonResponse["document_id"];
         std::string document_key = jsonResponse["document_key"];
         return document_id + "|" + document_key;
@@ -1005,90 +1073,85 @@ std::string EpubTranslator::uploadDocumentToDeepL(const std::string& filePath, c
     }
 }
 
-std::string EpubTranslator::checkDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey) {
-    CURL* curl;
-    CURLcode res;
-    std::string response_string;
-    std::string api_url = "https://api-free.deepl.com/v2/document/" + document_id;
-    std::string auth_key = "DeepL-Auth-Key " + deepLKey;
-
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl = curl_easy_init();
+std::future<DeepLResponse> EpubTranslator::requestDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey) {
+    nlohmann::json jsonPayload;
+    jsonPayload["document_key"] = document_key;
+    return DeepLClient::shared().postJson(deepLApiUrl + "/" + document_id, deepLKey, jsonPayload.dump(), deepLPollSettings.transferLimits());
+}
 
-    if (curl) {
-        struct curl_slist* headers = nullptr;
-        headers = curl_slist_append(headers, ("Authorization: " + auth_key).c_str());
-        headers = curl_slist_append(headers, "Content-Type: application/json");
+std::string EpubTranslator::checkDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey) {
+    DeepLResponse response = requestDocumentStatus(document_id, document_key, deepLKey).get();
 
-        // Create JSON payload
-        nlohmann::json jsonPayload;
-        jsonPayload["document_key"] = document_key;
-        std::string json_data = jsonPayload.dump();
+    if (response.curlCode != CURLE_OK) {
+        std::cerr << "Curl status check request failed: " << response.error << std::endl;
+    }
 
-        curl_easy_setopt(curl, CURLOPT_URL, api_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_POST, 1);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
+    std::cout << "Document status response: " << response.body << std::endl;
 
-        // Perform the request
-        res = curl_easy_perform(curl);
+    return response.body;  // You can parse this response to check if status == "done"
+}
 
-        if (res != CURLE_OK) {
-            std::cerr << "Curl status check request failed: " << curl_easy_strerror(res) << std::endl;
-        }
+std::string EpubTranslator::downloadTranslatedDocument(const std::string& document_id, const std::string& document_key, const std::string& deepLKey) {
+    nlohmann::json jsonPayload;
+    jsonPayload["document_key"] = document_key;
 
-        std::cout << "Document status response: " << response_string << std::endl;
+    DeepLResponse response = DeepLClient::shared().postJson(deepLApiUrl + "/" + document_id + "/result", deepLKey, jsonPayload.dump(), deepLPollSettings.transferLimits()).get();
 
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
+    if (response.curlCode != CURLE_OK) {
+        std::cerr << "Curl download request failed: " << response.error << std::endl;
     }
-    curl_global_cleanup();
 
-    return response_string;  // You can parse this response to check if status == "done"
+    return response.body;
 }
 
-std::string EpubTranslator::downloadTranslatedDocument(const std::string& document_id, const std::string& document_key, const std::string& deepLKey) {
-    CURL* curl;
-    CURLcode res;
-    std::string response_string;
-    std::string api_url = "https://api-free.deepl.com/v2/document/" + document_id + "/result";
-    std::string auth_key = "DeepL-Auth-Key " + deepLKey;
+bool EpubTranslator::translateDocumentsWithDeepL(const std::vector<DeepLDocumentScheduler::Job>& jobs, std::vector<std::string>& results, const std::string& deepLKey, const DocumentTranslatedCallback& onTranslated) {
+    DeepLDocumentScheduler scheduler(deepLMaxConcurrentDocuments, deepLPollSettings);
 
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl = curl_easy_init();
+    auto upload = [&](const DeepLDocumentScheduler::Job& job) {
+        DocumentInfo document;
+        std::string uploadResult = uploadDocumentToDeepL(job.filePath, deepLKey);
+        size_t separator = uploadResult.find('|');
+        if (separator != std::string::npos) {
+            document.id = uploadResult.substr(0, separator);
+            document.key = uploadResult.substr(separator + 1);
+        }
+        return document;
+    };
 
-    if (curl) {
-        struct curl_slist* headers = nullptr;
-        headers = curl_slist_append(headers, ("Authorization: " + auth_key).c_str());
-        headers = curl_slist_append(headers, "Content-Type: application/json");
+    auto status = [&](const DocumentInfo& document) {
+        return requestDocumentStatus(document.id, document.key, deepLKey);
+    };
 
-        // Create JSON payload
-        nlohmann::json jsonPayload;
-        jsonPayload["document_key"] = document_key;
-        std::string json_data = jsonPayload.dump();
+    auto download = [&](const DeepLDocumentScheduler::Job& job, const DocumentInfo& document) {
+        std::string responseHTMLString = downloadTranslatedDocument(document.id, document.key, deepLKey);
+        if (responseHTMLString.empty()) {
+            return false;
+        }
+        if (job.index >= results.size()) {
+            results.resize(job.index + 1);
+        }
+        results[job.index] = responseHTMLString;
+        return !onTranslated || onTranslated(job.index, results[job.index]);
+    };
 
-        curl_easy_setopt(curl, CURLOPT_URL, api_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_POST, 1);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
+    return scheduler.run(jobs, upload, status, download);
+}
 
-        // Perform the request
-        res = curl_easy_perform(curl);
+void EpubTranslator::setDeepLApiUrl(const std::string& url) {
+    deepLApiUrl = url;
+}
 
-        if (res != CURLE_OK) {
-            std::cerr << "Curl download request failed: " << curl_easy_strerror(res) << std::endl;
-        }
+void EpubTranslator::setDeepLMaxConcurrentDocuments(size_t maxDocuments) {
+    deepLMaxConcurrentDocuments = maxDocuments;
+}
 
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
-    }
-    curl_global_cleanup();
+void EpubTranslator::setDeepLPollSettings(const DeepLPollPolicy::Settings& settings) {
+    deepLPollSettings = settings;
+}
 
-    return response_string;
+void EpubTranslator::setLocalTranslationCommand(const std::filesystem::path& executable, const std::vector<std::string>& arguments) {
+    localTranslationExecutable = executable;
+    localTranslationArguments = arguments;
 }
 
 int EpubTranslator::handleDeepLRequest(const std::vector<tagData>& bookTags, const std::vector<std::filesystem::path>& spineOrderXHTMLFiles, std::string deepLKey) {
@@ -1168,267 +1231,87 @@ int EpubTranslator::handleDeepLRequest(const std::vector<tagData>& bookTags, con
         }
     }
 
+    std::vector<DeepLDocumentScheduler::Job> jobs;
     for (size_t i = 0; i < htmlStringVector.size(); ++i) {
-        std::cout << "Inside for loop" << "\n";
         if (!htmlContainsPTagsVector[i]) {
             continue;
         }
-
-        std::string chapterPath = "testHTML/" + std::to_string(i) + ".html";
-
-        std::string uploadResult = uploadDocumentToDeepL(chapterPath, deepLKey);
-
-        if (uploadResult.empty()) {
-            std::cerr << "Failed to upload document to DeepL." << "\n";
-            return 1;
-        }
-
-        std::string document_id = uploadResult.substr(0, uploadResult.find('|'));
-        std::string document_key = uploadResult.substr(uploadResult.find('|') + 1);
-
-        std::cout << "Uploaded document. Document ID: " << document_id << ", Document Key: " << document_key << "\n";
-
-        std::string status;
-        bool isTranslationComplete = false;
-
-        while (!isTranslationComplete) {
-            status = checkDocumentStatus(document_id, document_key, deepLKey);
-            // Parse the JSON response to check if status == "done"
-            nlohmann::json jsonResponse = nlohmann::json::parse(status);
-            if (jsonResponse["status"] == "done") {
-                isTranslationComplete = true;
-            } else {
-                std::cout << "Translation in progress..." << "\n";
-                std::this_thread::sleep_for(std::chrono::seconds(5));  // Wait for 5 seconds before checking again
-            }
-        }
-
-        std::string responseHTMLString = downloadTranslatedDocument(document_id, document_key, deepLKey);
-
-        std::cout << responseHTMLString << "\n";
-
-        htmlStringVector[i] = responseHTMLString;
-        // Limit the number of translations for testing because of DeepL API limits
-        // if (i == 9 ) {
-        //     break;
-        // }
+        jobs.push_back({i, "testHTML/" + std::to_string(i) + ".html"});
     }
 
-    // Create testHTML directory if it doesn't exist
     if (!make_directory("translatedHTML")) {
-        std::cerr << "Failed to create testHTML directory." << "\n";
+        std::cerr << "Failed to create translatedHTML directory." << "\n";
         return 1;
     }
 
-    // Write the updated content to the XHTML files in directory testHTML
-    for (size_t i = 0; i < htmlStringVector.size(); ++i) {
-        
-        std::ofstream outFile("translatedHTML/" + std::to_string(i) + ".xhtml");
+    // Each chapter is checked for Japanese that DeepL left untranslated as
+    // soon as it is downloaded, and those segments go straight to the local
+    // worker, so the local model runs while later chapters are still with DeepL
+    LocalTranslationWorker localWorker(localTranslationExecutable, localTranslationArguments);
+    std::vector<std::vector<tagData>> translatedChapterTags(htmlStringVector.size());
+    std::vector<bool> chapterChecked(htmlStringVector.size(), false);
+    bool localWorkerFailed = false;
+
+    auto checkChapter = [&](size_t chapterNum, const std::string& translatedHtml) {
+        std::filesystem::path translatedFilePath = std::filesystem::u8path("translatedHTML/" + std::to_string(chapterNum) + ".xhtml");
+        std::ofstream outFile(translatedFilePath);
         if (!outFile.is_open()) {
-            std::cerr << "Failed to open file for writing: " << i << ".xhtml" << "\n";
-            return 1;
+            std::cerr << "Failed to open file for writing: " << chapterNum << ".xhtml" << "\n";
+            return false;
         }
-        outFile << htmlStringVector[i];
+        outFile << translatedHtml;
         outFile.close();
-    }
-
-    // Go through all the translate XHTML and detect if there is any japanese text
-    std::cout << "Detecting Japanese text in translated XHTML files..." << "\n";
-
-    std::vector<std::filesystem::path> translatedXHTMLFiles;
-
-    for (size_t i = 0; i < spineOrderXHTMLFiles.size(); ++i) {
-        std::filesystem::path translatedFilePath = std::filesystem::u8path("translatedHTML/" + std::to_string(i) + ".xhtml");
-        if (!std::filesystem::exists(translatedFilePath)) {
-            std::cerr << "Translated file not found: " << translatedFilePath << "\n";
-            return 1;
-        }
-        translatedXHTMLFiles.push_back(translatedFilePath);
-    }
-
-    std::vector<tagData> translatedTags = extractTags(translatedXHTMLFiles);
-
-    std::vector<tagData> notTranslatedTags;
-
-    for (const auto& tag : translatedTags) {
-        if (tag.tagId == IMG_TAG) continue;
-
-        if (containsJapanese(tag.text)) {
-            notTranslatedTags.push_back(tag);
-        }
-    }
-
-    if (notTranslatedTags.empty()) {
-        std::cout << "No Japanese text detected in translated XHTML files." << "\n";
-        return 0;
-    } else {
-        std::cout << "Japanese text detected in translated XHTML files:" << "\n";
-        for (const auto& tag : notTranslatedTags) {
-            std::cout << "Chapter: " << tag.chapterNum << " | Position: " << tag.position << " | Text: " << tag.text << "\n";
-        }
-    }
-
-    std::cout << "Running local model translation for Japanese text" << "\n";
-
-    std::string rawTagsPathString = "rawTags.txt";
-    std::string translatedTagsPathString = "translatedTags.txt";
 
-    // Write out a file of the raw tags
-    std::filesystem::path rawTagsPath = rawTagsPathString;
-    std::ofstream rawTagsFile(rawTagsPath);
-    if (!rawTagsFile.is_open()) {
-        std::cerr << "Failed to open file for writing: " << rawTagsPath << "\n";
-        return 1;
-    }
+        std::vector<tagData> tags = extractTags({translatedFilePath});
+        for (auto& tag : tags) {
+            tag.chapterNum = static_cast<int>(chapterNum);
+            if (tag.tagId == IMG_TAG || !containsJapanese(tag.text)) continue;
 
-    std::cout << "Writing raw tags to file: " << rawTagsPath << "\n";
-    for (const auto& tag : notTranslatedTags) {
-        auto chapterIt = positionMap.find(tag.chapterNum);
-        if (chapterIt != positionMap.end()) {  // Check if chapter exists
-            auto positionIt = chapterIt->second.find(tag.position);
-            if (positionIt != chapterIt->second.end() && positionIt->second != nullptr) {  // Check if position exists
-                std::string originalText = positionIt->second->text;
-                rawTagsFile << tag.tagId << "," << tag.chapterNum << "," << tag.position << "," << originalText << "\n";
-            } else {
+            std::cout << "Japanese text detected in Chapter: " << tag.chapterNum << " | Position: " << tag.position << " | Text: " << tag.text << "\n";
+            auto positionIt = positionMap[tag.chapterNum].find(tag.position);
+            if (positionIt == positionMap[tag.chapterNum].end() || positionIt->second == nullptr) {
                 std::cerr << "Warning: Missing position in positionMap for Chapter: " 
                           << tag.chapterNum << ", Position: " << tag.position << "\n";
+                continue;
+            }
+            if (!localWorkerFailed && !localWorker.submit(tag.chapterNum, tag.position, positionIt->second->text)) {
+                localWorkerFailed = true;
             }
-        } else {
-            std::cerr << "Warning: Missing chapter in positionMap for Chapter: " << tag.chapterNum << "\n";
         }
-    }
-    
-    std::cout << "Raw tags written to file: " << rawTagsPath << "\n";
 
-    rawTagsFile.close();
+        translatedChapterTags[chapterNum] = std::move(tags);
+        chapterChecked[chapterNum] = true;
+        return true;
+    };
 
-
-
-
-    // Start the translaton
-    std::filesystem::path translationExe;
-    std::string chapterNumberMode = "0";
-    #if defined(__APPLE__)
-        translationExe = "translation";
-
-    #elif defined(_WIN32)
-        translationExe = "translation.exe";
-    #else
-        std::cerr << "Unsupported platform!" << std::endl;
-        return 1; // Or some other error handling
-    #endif
-
-    if (!std::filesystem::exists(translationExe)) {
-        std::cerr << "Executable not found: " << translationExe << std::endl;
+    if (!translateDocumentsWithDeepL(jobs, htmlStringVector, deepLKey, checkChapter)) {
         return 1;
     }
 
-    std::string translationExePath = translationExe.string();
-    
-
-    std::cout << "Before call to translation.py" << '\n';
-
-    boost::process::ipstream pipe_stdout, pipe_stderr;
-
-    try {
-        #if defined(_WIN32)
-            boost::process::child c(
-                translationExePath,
-                rawTagsPathString,
-                chapterNumberMode,
-                boost::process::std_out > pipe_stdout, 
-                boost::process::std_err > pipe_stderr,
-                boost::process::windows::hide
-            );
-        #else
-            boost::process::child c(
-                translationExePath,
-                rawTagsPathString,
-                chapterNumberMode,
-                boost::process::std_out > pipe_stdout, 
-                boost::process::std_err > pipe_stderr
-            );
-        #endif
-
-        // Threads to handle asynchronous reading
-        std::thread stdout_thread([&pipe_stdout]() {
-            std::string line;
-            while (std::getline(pipe_stdout, line)) {
-                std::cout << line << "\n";
-            }
-        });
-
-        std::thread stderr_thread([&pipe_stderr]() {
-            std::string line;
-            while (std::getline(pipe_stderr, line)) {
-                std::cerr << "Python stderr: " << line << "\n";
-            }
-        });
-
-        c.wait(); // Wait for process completion
-
-        stdout_thread.join();
-        stderr_thread.join();
-
-        if (c.exit_code() == 0) {
-            std::cout << "Translation Python script executed successfully." << "\n";
-        } else {
-            std::cerr << "Translation Python script exited with code: " << c.exit_code() << "\n";
+    // Chapters without <p> tags never went to DeepL
+    for (size_t i = 0; i < htmlStringVector.size(); ++i) {
+        if (!chapterChecked[i] && !checkChapter(i, htmlStringVector[i])) {
+            return 1;
         }
-    } catch (const std::exception& ex) {
-        std::cerr << "Exception: " << ex.what() << "\n";
     }
 
-    std::cout << "After call to translation.py" << '\n';
-
-    std::vector<decodedData> decodedDataVector;
-    std::ifstream file(translatedTagsPathString);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open file: " << translatedTagsPathString << "\n";
+    if (localWorkerFailed) {
+        std::cerr << "Local model translation is unavailable for the untranslated Japanese text." << "\n";
         return 1;
     }
 
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream lineStream(line);
-        std::string chapterNumStr, positionStr, text;
-
-        // Extract chapterNum (first value)
-        if (!std::getline(lineStream, chapterNumStr, ',')) continue;
-
-        // Extract position (second value)
-        if (!std::getline(lineStream, positionStr, ',')) continue;
-
-        // The rest of the line is text
-        std::getline(lineStream, text);
-
-        // Convert chapterNum and position to integers
-        try {
-            decodedData data;
-            data.chapterNum = std::stoi(chapterNumStr);
-            data.position = std::stoi(positionStr);
-            data.output = text;
-            // Store the extracted data
-            decodedDataVector.push_back(data);
-        } catch (const std::exception& e) {
-            std::cerr << "Error parsing line: " << line << " - " << e.what() << "\n";
+    std::vector<decodedData> decodedDataVector;
+    if (localWorker.submittedCount() == 0) {
+        std::cout << "No Japanese text detected in translated XHTML files." << "\n";
+    } else {
+        std::cout << "Waiting for local model translation of " << localWorker.submittedCount() << " segments" << "\n";
+        for (auto& result : localWorker.finish()) {
+            decodedDataVector.push_back({std::move(result.output), result.chapterNum, result.position});
         }
     }
-    file.close();
 
     // Create translatedPositionsMap out of translatedTags
-    std::vector<std::vector<tagData>> translatedChapterTags;
     std::unordered_map<int, std::unordered_map<int, tagData*>> translatedPositionMap;
-
-
-
-    for (auto& tag : translatedTags) {
-        if (tag.chapterNum >= translatedChapterTags.size()) {
-            translatedChapterTags.resize(tag.chapterNum + 1);
-        }
-        translatedChapterTags[tag.chapterNum].push_back(tag);
-    }
-
     for (size_t chapterNum = 0; chapterNum < translatedChapterTags.size(); ++chapterNum) {
         for (auto& tag : translatedChapterTags[chapterNum]) {
             translatedPositionMap[chapterNum][tag.position] = &tag;
@@ -1454,6 +1337,23 @@ int EpubTranslator::handleDeepLRequest(const std::vector<tagData>& bookTags, con
         }
     }
 
+    if (!writeTranslatedChapters(translatedChapterTags, spineOrderXHTMLFiles)) {
+        return 1;
+    }
+
+    return 0; 
+}
+
+bool EpubTranslator::writeTranslatedChapters(const std::vector<std::vector<tagData>>& chapterTags, const std::vector<std::filesystem::path>& spineOrderXHTMLFiles) {
+    std::string htmlHeader = R"(
+<!DOCTYPE html>
+<html xmlns="http://www.w3.org/1999/xhtml">
+<head>
+    <title>)";
+
+    std::string htmlFooter = R"(</body>
+</html>)";
+
     std::cout << "Writing translated XHTML files..." << "\n";
 
     // Write out to the template EPUB
@@ -1463,20 +1363,20 @@ int EpubTranslator::handleDeepLRequest(const std::vector<tagData>& bookTags, con
         std::cout << "Writing to: " << outputPath << "\n";
         if (!outFile.is_open()) {
             std::cerr << "Failed to open file for writing: " << outputPath << "\n";
-            return 1;
+            return false;
         }
 
         // Write pre-built header
         outFile << htmlHeader << spineOrderXHTMLFiles[i].filename().string() << "</title>\n</head>\n<body>\n";
 
-        if (i > translatedChapterTags.size()) {
+        if (i >= chapterTags.size()) {
             outFile << htmlFooter;
             outFile.close();
             continue;
         }
 
         // Write content-specific parts
-        for (const auto& tag : translatedChapterTags[i]) {
+        for (const auto& tag : chapterTags[i]) {
             if (tag.tagId == P_TAG) {
                 outFile << "<p>" << tag.text << "</p>\n";
             } else if (tag.tagId == IMG_TAG) {
@@ -1489,11 +1389,63 @@ int EpubTranslator::handleDeepLRequest(const std::vector<tagData>& bookTags, con
         outFile.close();
     }
 
-    return 0; 
+    return true;
+}
+
+int EpubTranslator::handleDeepLTextRequest(const std::vector<tagData>& bookTags, const std::vector<std::filesystem::path>& spineOrderXHTMLFiles, const std::string& deepLKey) {
+    // Only paragraph text goes to DeepL, images keep their file names
+    std::vector<std::string> texts;
+    std::vector<size_t> tagIndices;
+    for (size_t i = 0; i < bookTags.size(); ++i) {
+        if (bookTags[i].tagId == P_TAG) {
+            texts.push_back(bookTags[i].text);
+            tagIndices.push_back(i);
+        }
+    }
+
+    DeepLTextTranslator textTranslator(deepLTextApiUrl, deepLKey);
+    textTranslator.setMaxConcurrentRequests(deepLMaxConcurrentDocuments);
+    textTranslator.setRetrySettings(deepLPollSettings);
+
+    std::vector<std::string> translations;
+    if (!textTranslator.translate(texts, translations)) {
+        std::cerr << "Failed to translate text with DeepL." << "\n";
+        return 1;
+    }
+
+    std::vector<tagData> translatedTags = bookTags;
+    for (size_t i = 0; i < tagIndices.size(); ++i) {
+        translatedTags[tagIndices[i]].text = translations[i];
+    }
+
+    std::vector<std::vector<tagData>> chapterTags(spineOrderXHTMLFiles.size());
+    for (const auto& tag : translatedTags) {
+        if (tag.chapterNum >= static_cast<int>(chapterTags.size())) {
+            chapterTags.resize(tag.chapterNum + 1);
+        }
+        if (tag.tagId == P_TAG && containsJapanese(tag.text)) {
+            std::cerr << "Untranslated Japanese text detected in Chapter: " << tag.chapterNum << " | Position: " << tag.position << " | Text: " << tag.text << "\n";
+        }
+        chapterTags[tag.chapterNum].push_back(tag);
+    }
+
+    if (!writeTranslatedChapters(chapterTags, spineOrderXHTMLFiles)) {
+        return 1;
+    }
+
+    return 0;
+}
+
+void EpubTranslator::setDeepLBackend(DeepLBackend backend) {
+    deepLBackend = backend;
+}
+
+void EpubTranslator::setDeepLTextApiUrl(const std::string& url) {
+    deepLTextApiUrl = url;
 }
 
 void EpubTranslator::addTitleAndAuthor(const char* filename, const std::string& title, const std::string& author) {
-    xmlDocPtr doc = xmlReadFile(filename, NULL, 0);
+    xmlDocPtr doc = XmlParsingService::forCurrentThread().parseXmlFile(filename, NULL, 0);
     if (!doc) {
         std::cerr << "Failed to parse " << filename << std::endl;
         return;
@@ -1561,7 +1513,6 @@ void EpubTranslator::addTitleAndAuthor(const char* filename, const std::string&
     // Save the updated XML
     xmlSaveFormatFileEnc(filename, doc, "UTF-8", 1);
     xmlFreeDoc(doc);
-    xmlCleanupParser();
 }
 
 int EpubTranslator::run(const std::string& epubToConvert, const std::string& outputEpubPath, int localModel, const std::string& deepLKey, std::string langcode) {
@@ -1816,7 +1767,9 @@ int EpubTranslator::run(const std::string& epubToConvert, const std::string& out
             return 1;
         }
 
-        int result = handleDeepLRequest(bookTags, spineOrderXHTMLFiles, deepLKey);
+        int result = (deepLBackend == DeepLBackend::Text)
+            ? handleDeepLTextRequest(bookTags, spineOrderXHTMLFiles, deepLKey)
+            : handleDeepLRequest(bookTags, spineOrderXHTMLFiles, deepLKey);
 
         if (result != 0) {
             std::cerr << "Failed to handle DeepL request." << "\n";
@@ -3,7 +3,7 @@
 #include <cstring>
 #include <filesystem>
 #include <string>
-#include <regex>
+#include <string_view>
 #include <vector>
 #include <libxml/HTMLparser.h>
 #include <libxml/xpath.h>
@@ -22,6 +22,11 @@
 #include <iostream>
 #include <curl/curl.h>
 #include "Translator.h"
+#include "XmlParsingService.h"
+#include "DeepLDocumentScheduler.h"
+#include "DeepLClient.h"
+#include "DeepLTextTranslator.h"
+#include "LocalTranslationWorker.h"
 #include <nlohmann/json.hpp>
 #include <unordered_set>
 
@@ -48,13 +53,34 @@ struct decodedData {
     int position;
 };
 
+// Document: upload each chapter as an HTML document (default)
+// Text: send the extracted paragraphs to the /v2/translate text endpoint in batches
+enum class DeepLBackend {
+    Document,
+    Text
+};
+
 class EpubTranslator : public Translator {
 public:
     int run(const std::string& epubToConvert, const std::string& outputEpubPath, int localModel, const std::string& deepLKey, std::string langcode);
     static size_t writeCallback(void* contents, size_t size, size_t nmemb, std::string* output);
 
+    // DeepL document API settings, the concurrency limit should match what the account allows
+    void setDeepLApiUrl(const std::string& url);
+    void setDeepLMaxConcurrentDocuments(size_t maxDocuments);
+    void setDeepLPollSettings(const DeepLPollPolicy::Settings& settings);
+    void setDeepLBackend(DeepLBackend backend);
+    void setDeepLTextApiUrl(const std::string& url);
+    // Process used for segments DeepL leaves in Japanese, started in streaming mode
+    void setLocalTranslationCommand(const std::filesystem::path& executable, const std::vector<std::string>& arguments);
+
 protected:
     std::filesystem::path searchForOPFFiles(const std::filesystem::path& directory);
+    static bool isWordChar(char c);
+    static bool isSpaceChar(char c);
+    bool findElementBlock(const std::string& content, const std::string& tagName, std::string& innerContent);
+    std::vector<std::string> collectTags(const std::string& content);
+    bool findQuotedAttribute(const std::string& text, const std::string& name, bool requireWordBoundary, bool allowEmptyValue, size_t& pos, std::string& value);
     std::string extractSpineContent(const std::string& content);
     std::vector<std::string> extractIdrefs(const std::string& spineContent);
     std::vector<std::string> getSpineOrder(const std::filesystem::path& directory);
@@ -75,9 +101,15 @@ protected:
     std::string stripHtmlTags(const std::string& input);
     std::vector<tagData> extractTags(const std::vector<std::filesystem::path>& chapterPaths);
     std::string uploadDocumentToDeepL(const std::string& filePath, const std::string& deepLKey);
+    std::future<DeepLResponse> requestDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey);
     std::string checkDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey);
     std::string downloadTranslatedDocument(const std::string& document_id, const std::string& document_key, const std::string& deepLKey);
+    // Called on the scheduler thread for every downloaded document, returning false fails the run
+    using DocumentTranslatedCallback = std::function<bool(size_t index, const std::string& translatedHtml)>;
+    bool translateDocumentsWithDeepL(const std::vector<DeepLDocumentScheduler::Job>& jobs, std::vector<std::string>& results, const std::string& deepLKey, const DocumentTranslatedCallback& onTranslated = nullptr);
     int handleDeepLRequest(const std::vector<tagData>& bookTags, const std::vector<std::filesystem::path>& spineOrderXHTMLFiles, std::string deepLKey);
+    int handleDeepLTextRequest(const std::vector<tagData>& bookTags, const std::vector<std::filesystem::path>& spineOrderXHTMLFiles, const std::string& deepLKey);
+    bool writeTranslatedChapters(const std::vector<std::vector<tagData>>& chapterTags, const std::vector<std::filesystem::path>& spineOrderXHTMLFiles);
     void removeSection0001Tags(const std::filesystem::path& contentOpfPath);
     std::string readFileUtf8(const std::filesystem::path& filePath);
     htmlDocPtr parseHtmlDocument(const std::string& data);
@@ -91,4 +123,16 @@ protected:
     std::vector<std::pair<std::string, std::string>> extractManifestIds(const std::vector<std::string>& manifestItems);
     void addTitleAndAuthor(const char* filename, const std::string& title, const std::string& author);
     bool containsJapanese(const std::string& text);
+
+    std::string deepLApiUrl = "https://api-free.deepl.com/v2/document";
+    size_t deepLMaxConcurrentDocuments = 4;
+    DeepLPollPolicy::Settings deepLPollSettings;
+    DeepLBackend deepLBackend = DeepLBackend::Document;
+    std::string deepLTextApiUrl = "https://api-free.deepl.com/v2/translate";
+#if defined(_WIN32)
+    std::filesystem::path localTranslationExecutable = "translation.exe";
+#else
+    std::filesystem::path localTranslationExecutable = "translation";
+#endif
+    std::vector<std::string> localTranslationArguments = {"-", "2"};
 };
@@ -0,0 +1,197 @@
+#include "FontManager.h"
+#include "TextLayout.h"
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+
+namespace {
+
+// FT_New_Face is not safe to call concurrently on one library
+std::mutex freetypeMutex;
+const cairo_user_data_key_t ftFaceKey = {};
+
+void destroyFtFace(void* face) {
+    std::lock_guard<std::mutex> lock(freetypeMutex);
+    FT_Done_Face(static_cast<FT_Face>(face));
+}
+
+// Next codepoint of text at pos, malformed bytes are returned one at a time
+char32_t nextCodepoint(std::string_view text, size_t& pos) {
+    unsigned char lead = static_cast<unsigned char>(text[pos]);
+    size_t length = lead < 0x80 ? 1 : (lead & 0xE0) == 0xC0 ? 2 : (lead & 0xF0) == 0xE0 ? 3 : (lead & 0xF8) == 0xF0 ? 4 : 1;
+    if (length == 1 || pos + length > text.size()) {
+        ++pos;
+        return lead;
+    }
+
+    char32_t codepoint = lead & (0x7F >> length);
+    for (size_t i = 1; i < length; ++i) {
+        codepoint = (codepoint << 6) | (static_cast<unsigned char>(text[pos + i]) & 0x3F);
+    }
+    pos += length;
+    return codepoint;
+}
+
+} // namespace
+
+FT_Library FontManager::sharedLibrary() {
+    // cairo can keep font faces alive after their manager is gone, so the
+    // library they were created from is never released
+    static FT_Library library = []() {
+        FT_Library created = nullptr;
+        if (FT_Init_FreeType(&created) != 0) {
+            std::cerr << "Failed to initialise FreeType" << std::endl;
+            return static_cast<FT_Library>(nullptr);
+        }
+        return created;
+    }();
+    return library;
+}
+
+FontManager::FontManager(const std::filesystem::path& fontsDirectory, double fontSize) : fontSize(fontSize) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(fontsDirectory, ec) || !sharedLibrary()) {
+        return;
+    }
+
+    std::vector<std::filesystem::path> fontFiles;
+    for (const auto& entry : std::filesystem::directory_iterator(fontsDirectory, ec)) {
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (entry.is_regular_file() && (ext == ".ttf" || ext == ".otf" || ext == ".ttc")) {
+            fontFiles.push_back(entry.path());
+        }
+    }
+
+    // Sorted so the primary font does not depend on directory order
+    std::sort(fontFiles.begin(), fontFiles.end());
+    for (const auto& fontFile : fontFiles) {
+        loadFont(fontFile);
+    }
+}
+
+FontManager::~FontManager() {
+    for (auto& face : faces) {
+        cairo_scaled_font_destroy(face.scaledFont);
+    }
+}
+
+bool FontManager::loadFont(const std::filesystem::path& path) {
+    FT_Face ftFace = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(freetypeMutex);
+        if (FT_New_Face(sharedLibrary(), path.string().c_str(), 0, &ftFace) != 0) {
+            std::cerr << "Failed to load font: " << path.string() << std::endl;
+            return false;
+        }
+    }
+
+    cairo_font_face_t* fontFace = cairo_ft_font_face_create_for_ft_face(ftFace, 0);
+    if (cairo_font_face_status(fontFace) != CAIRO_STATUS_SUCCESS ||
+        cairo_font_face_set_user_data(fontFace, &ftFaceKey, ftFace, destroyFtFace) != CAIRO_STATUS_SUCCESS) {
+        cairo_font_face_destroy(fontFace);
+        destroyFtFace(ftFace);
+        std::cerr << "Failed to create cairo font for: " << path.string() << std::endl;
+        return false;
+    }
+
+    cairo_matrix_t fontMatrix;
+    cairo_matrix_t identity;
+    cairo_matrix_init_scale(&fontMatrix, fontSize, fontSize);
+    cairo_matrix_init_identity(&identity);
+    cairo_font_options_t* options = cairo_font_options_create();
+    cairo_scaled_font_t* scaledFont = cairo_scaled_font_create(fontFace, &fontMatrix, &identity, options);
+    cairo_font_options_destroy(options);
+    // The scaled font keeps its own reference, the FT_Face goes with the last one
+    cairo_font_face_destroy(fontFace);
+
+    if (cairo_scaled_font_status(scaledFont) != CAIRO_STATUS_SUCCESS) {
+        cairo_scaled_font_destroy(scaledFont);
+        std::cerr << "Failed to create cairo font for: " << path.string() << std::endl;
+        return false;
+    }
+
+    faces.push_back({ftFace, scaledFont});
+    return true;
+}
+
+size_t FontManager::faceFor(std::string_view text) const {
+    for (size_t i = 0; i < faces.size(); ++i) {
+        bool covered = true;
+        size_t pos = 0;
+        while (covered && pos < text.size()) {
+            char32_t codepoint = nextCodepoint(text, pos);
+            covered = codepoint == ' ' || FT_Get_Char_Index(faces[i].ftFace, codepoint) != 0;
+        }
+        if (covered) {
+            return i;
+        }
+    }
+    // Nothing covers it all, the primary font draws what it can
+    return 0;
+}
+
+const FontManager::GlyphRun& FontManager::glyphRun(std::string_view text) {
+    // lookupKey keeps its capacity, so cache hits do not allocate
+    lookupKey.assign(text.data(), text.size());
+    auto it = runCache.find(lookupKey);
+    if (it != runCache.end()) {
+        return it->second;
+    }
+
+    GlyphRun run{faceFor(text), {}, 0.0};
+    cairo_scaled_font_t* scaledFont = faces[run.face].scaledFont;
+    cairo_glyph_t* glyphs = nullptr;
+    int glyphCount = 0;
+    if (cairo_scaled_font_text_to_glyphs(scaledFont, 0, 0, text.data(), static_cast<int>(text.size()), &glyphs, &glyphCount, nullptr, nullptr, nullptr) == CAIRO_STATUS_SUCCESS) {
+        run.glyphs.assign(glyphs, glyphs + glyphCount);
+        cairo_text_extents_t extents;
+        cairo_scaled_font_glyph_extents(scaledFont, glyphs, glyphCount, &extents);
+        run.advance = extents.x_advance;
+        cairo_glyph_free(glyphs);
+    }
+
+    return runCache.emplace(lookupKey, std::move(run)).first->second;
+}
+
+void FontManager::showText(cairo_t* cr, double x, double y, std::string_view line) {
+    const double spaceAdvance = glyphRun(" ").advance;
+
+    // Consecutive words in the same font go out in one cairo_show_glyphs call
+    size_t currentFace = 0;
+    lineGlyphs.clear();
+    auto flush = [&]() {
+        if (!lineGlyphs.empty()) {
+            cairo_set_scaled_font(cr, faces[currentFace].scaledFont);
+            cairo_show_glyphs(cr, lineGlyphs.data(), static_cast<int>(lineGlyphs.size()));
+            lineGlyphs.clear();
+        }
+    };
+
+    // Runs are the tokens TextLayout measured, so a CJK line is cached per
+    // character rather than as one key, and every whitespace character is a
+    // gap as wide as the one the line was broken with
+    size_t pos = 0;
+    while (pos < line.size()) {
+        if (TextLayout::isLayoutSpace(line[pos])) {
+            x += spaceAdvance;
+            ++pos;
+            continue;
+        }
+
+        size_t end = TextLayout::tokenEnd(line, pos);
+        const GlyphRun& run = glyphRun(line.substr(pos, end - pos));
+        if (run.face != currentFace) {
+            flush();
+            currentFace = run.face;
+        }
+        for (cairo_glyph_t glyph : run.glyphs) {
+            glyph.x += x;
+            glyph.y += y;
+            lineGlyphs.push_back(glyph);
+        }
+        x += run.advance;
+        pos = end;
+    }
+    flush();
+}
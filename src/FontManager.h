@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cairo.h>
+#include <cairo-ft.h>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Loads the fonts shipped in the fonts directory through FreeType, so the
+// translated text in the output PDF no longer depends on what the system's
+// "Helvetica" happens to cover. Each word is converted to glyphs once and the
+// run is reused whenever the word appears again. cairo's PDF surface only
+// embeds the glyphs that were drawn, so the CJK font adds a small subset to
+// the file rather than the whole font.
+class FontManager {
+public:
+    struct GlyphRun {
+        size_t face;
+        // Positioned from the origin
+        std::vector<cairo_glyph_t> glyphs;
+        double advance;
+    };
+
+    FontManager(const std::filesystem::path& fontsDirectory, double fontSize);
+    ~FontManager();
+    FontManager(const FontManager&) = delete;
+    FontManager& operator=(const FontManager&) = delete;
+
+    // False when the directory has no usable font, callers then fall back to cairo's toy font API
+    bool hasFonts() const { return !faces.empty(); }
+    size_t fontCount() const { return faces.size(); }
+
+    // Glyphs of text in the first font that covers all of it, cached per text
+    const GlyphRun& glyphRun(std::string_view text);
+    double advance(std::string_view text) { return glyphRun(text).advance; }
+    // Draws line with the origin of its first glyph at (x, y)
+    void showText(cairo_t* cr, double x, double y, std::string_view line);
+
+    size_t cachedRunCount() const { return runCache.size(); }
+
+protected:
+    struct Face {
+        FT_Face ftFace;
+        cairo_scaled_font_t* scaledFont;
+    };
+
+    static FT_Library sharedLibrary();
+    bool loadFont(const std::filesystem::path& path);
+    size_t faceFor(std::string_view text) const;
+
+    std::vector<Face> faces;
+    double fontSize;
+    std::unordered_map<std::string, GlyphRun> runCache;
+    std::string lookupKey;
+    std::vector<cairo_glyph_t> lineGlyphs;
+};
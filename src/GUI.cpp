@@ -85,6 +85,12 @@ void GUI::update(std::ostringstream& logStream) {
     if (localModelStr == "DeepL Translator") {
         ImGui::Text("Note: DeepL Translator is higher quality but requires a DeepL API key");
         ImGui::InputText("DeepL API Key", deepLKey, sizeof(deepLKey));
+        ImGui::Checkbox("Fast mode for EPUB (DeepL text API)", &useDeepLTextApi);
+        // Chapters uploaded to DeepL at once, or text requests in flight in fast mode
+        ImGui::InputInt("DeepL parallel requests for EPUB", &deepLMaxConcurrentDocuments);
+        if (deepLMaxConcurrentDocuments < 1) {
+            deepLMaxConcurrentDocuments = 1;
+        }
     }
 
     populateLanguages();
@@ -98,6 +104,30 @@ void GUI::update(std::ostringstream& logStream) {
     }
     
 
+    ImGui::Checkbox("Keep original PDF layout", &keepPdfLayout);
+
+    // Reflowed PDFs can be translated a few pages at a time, which keeps
+    // memory use flat on large books
+    if (!keepPdfLayout) {
+        ImGui::InputInt("PDF pages per batch (0 = all)", &pdfPagesPerBatch);
+        if (pdfPagesPerBatch < 0) {
+            pdfPagesPerBatch = 0;
+        }
+        // Caps MuPDF's resource store while translating in batches
+        if (pdfPagesPerBatch > 0) {
+            ImGui::InputInt("PDF memory budget MB (0 = MuPDF default)", &pdfMemoryBudgetMb);
+            if (pdfMemoryBudgetMb < 0) {
+                pdfMemoryBudgetMb = 0;
+            }
+        }
+    }
+
+    // DOCX parts this large are read one paragraph at a time instead of as a whole
+    ImGui::InputInt("Stream DOCX parts above MB (0 = never)", &docxStreamingThresholdMb);
+    if (docxStreamingThresholdMb < 0) {
+        docxStreamingThresholdMb = 0;
+    }
+
     // Input fields for directories
     ImGui::InputText("Original Book", inputFile, sizeof(inputFile));
     // Browse button for the epub to convert
@@ -230,6 +260,10 @@ void GUI::update(std::ostringstream& logStream) {
                 try {
                     if (fileExtension == "epub") {
                         translator = TranslatorFactory::createTranslator("epub");
+                        static_cast<EpubTranslator*>(translator.get())->setDeepLMaxConcurrentDocuments(static_cast<size_t>(deepLMaxConcurrentDocuments));
+                        if (useDeepLTextApi) {
+                            static_cast<EpubTranslator*>(translator.get())->setDeepLBackend(DeepLBackend::Text);
+                        }
                         // Write book details to a text file
                         std::ofstream bookDetails("book_details.txt");
                         if (bookDetails.is_open()) {
@@ -240,8 +274,14 @@ void GUI::update(std::ostringstream& logStream) {
                         }
                     } else if (fileExtension == "pdf") {
                         translator = TranslatorFactory::createTranslator("pdf");
+                        if (keepPdfLayout) {
+                            static_cast<PDFTranslator*>(translator.get())->setPdfOutputMode(PdfOutputMode::PreserveLayout);
+                        } else if (pdfPagesPerBatch > 0) {
+                            static_cast<PDFTranslator*>(translator.get())->setPageWindow(pdfPagesPerBatch, static_cast<size_t>(pdfMemoryBudgetMb) * 1024 * 1024);
+                        }
                     } else if (fileExtension == "docx") {
                         translator = TranslatorFactory::createTranslator("docx");
+                        static_cast<DocxTranslator*>(translator.get())->setStreamingThreshold(static_cast<size_t>(docxStreamingThresholdMb) * 1024 * 1024);
                     } else if (fileExtension == "html") {
                         translator = TranslatorFactory::createTranslator("html");
 
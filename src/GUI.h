@@ -31,6 +31,12 @@ protected:
     std::string bookAuthor = "";
     int localModel = 0;
     char deepLKey[256] = "";  // Ensure it is zero-initialized
+    bool useDeepLTextApi = false;
+    int deepLMaxConcurrentDocuments = 4;
+    bool keepPdfLayout = false;
+    int pdfPagesPerBatch = 0;
+    int pdfMemoryBudgetMb = 256;
+    int docxStreamingThresholdMb = 64;
     std::thread workerThread;
     std::atomic<bool> running;
     std::atomic<bool> finished;
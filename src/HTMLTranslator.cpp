@@ -12,7 +12,7 @@ int HTMLTranslator::run(const std::string& inputPath, const std::string& outputP
     auto start = std::chrono::high_resolution_clock::now();
 
     // Parse the HTML file
-    htmlDocPtr doc = htmlReadFile(inputPath.c_str(), nullptr, HTML_PARSE_RECOVER | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
+    htmlDocPtr doc = XmlParsingService::forCurrentThread().parseHtmlFile(inputPath, nullptr, HTML_PARSE_RECOVER | HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
     if (doc == nullptr) {
         std::cerr << "Failed to parse HTML file: " << inputPath << std::endl;
         return 1;
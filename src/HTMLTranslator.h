@@ -25,6 +25,7 @@
 #include <unordered_set>
 #include <unordered_map>
 #include "Document.h"
+#include "XmlParsingService.h"
 #include <libxml/HTMLtree.h>
 
 #ifdef _WIN32
@@ -0,0 +1,192 @@
+#include "LocalTranslationWorker.h"
+#include <iostream>
+
+LocalTranslationWorker::LocalTranslationWorker(const std::filesystem::path& executable, const std::vector<std::string>& arguments)
+    : executable(executable), arguments(arguments) {}
+
+LocalTranslationWorker::~LocalTranslationWorker() {
+    if (!started) {
+        return;
+    }
+
+    // Only reached when the caller bailed out early, queued segments are not needed any more
+    pipeStdin.pipe().close();
+    std::error_code ec;
+    if (process->running(ec)) {
+        process->terminate(ec);
+    }
+    stdoutThread.join();
+    stderrThread.join();
+}
+
+bool LocalTranslationWorker::start() {
+    if (started) {
+        return true;
+    }
+
+    if (!std::filesystem::exists(executable)) {
+        std::cerr << "Executable not found: " << executable << std::endl;
+        return false;
+    }
+
+    try {
+        #if defined(_WIN32)
+            process = std::make_unique<boost::process::child>(
+                executable.string(),
+                boost::process::args(arguments),
+                boost::process::std_in < pipeStdin,
+                boost::process::std_out > pipeStdout,
+                boost::process::std_err > pipeStderr,
+                boost::process::windows::hide
+            );
+        #else
+            process = std::make_unique<boost::process::child>(
+                executable.string(),
+                boost::process::args(arguments),
+                boost::process::std_in < pipeStdin,
+                boost::process::std_out > pipeStdout,
+                boost::process::std_err > pipeStderr
+            );
+        #endif
+    } catch (const std::exception& ex) {
+        std::cerr << "Failed to start local translation worker: " << ex.what() << "\n";
+        return false;
+    }
+
+    stdoutThread = std::thread([this]() {
+        std::string line;
+        while (std::getline(pipeStdout, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+
+            Result result;
+            if (parseResultLine(line, result)) {
+                std::lock_guard<std::mutex> lock(resultsMutex);
+                results.push_back(std::move(result));
+                ++resultCount;
+                ++answered;
+            } else if (isFailedLine(line)) {
+                std::lock_guard<std::mutex> lock(resultsMutex);
+                ++answered;
+            } else {
+                std::cout << line << "\n";
+                continue;
+            }
+            answeredCondition.notify_all();
+        }
+
+        // Nothing else will be answered, collect must not wait for it
+        {
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            outputClosed = true;
+        }
+        answeredCondition.notify_all();
+    });
+
+    stderrThread = std::thread([this]() {
+        std::string line;
+        while (std::getline(pipeStderr, line)) {
+            std::cerr << "Python stderr: " << line << "\n";
+        }
+    });
+
+    started = true;
+    return true;
+}
+
+bool LocalTranslationWorker::submit(int chapterNum, int position, const std::string& text) {
+    if (!started && !start()) {
+        return false;
+    }
+
+    // The protocol is line based, so a segment must not contain line breaks
+    std::string line = std::to_string(chapterNum) + "," + std::to_string(position) + ",";
+    for (char c : text) {
+        line += (c == '\n' || c == '\r') ? ' ' : c;
+    }
+
+    std::lock_guard<std::mutex> lock(stdinMutex);
+    pipeStdin << line << std::endl;
+    if (!pipeStdin) {
+        std::cerr << "Failed to send segment to local translation worker." << "\n";
+        return false;
+    }
+    submitted++;
+    return true;
+}
+
+std::vector<LocalTranslationWorker::Result> LocalTranslationWorker::collect() {
+    if (!started) {
+        return {};
+    }
+
+    pipeStdin.flush();
+    std::unique_lock<std::mutex> lock(resultsMutex);
+    answeredCondition.wait(lock, [this]() { return answered >= submitted || outputClosed; });
+    if (answered < submitted) {
+        std::cerr << "Local translation worker stopped after " << answered << " of " << submitted << " segments." << "\n";
+    }
+    std::vector<Result> collected = std::move(results);
+    results.clear();
+    return collected;
+}
+
+std::vector<LocalTranslationWorker::Result> LocalTranslationWorker::finish() {
+    if (!started) {
+        return {};
+    }
+    started = false;
+
+    pipeStdin.flush();
+    pipeStdin.pipe().close();
+
+    stdoutThread.join();
+    stderrThread.join();
+    process->wait();
+
+    if (process->exit_code() == 0) {
+        std::cout << "Local translation worker finished." << "\n";
+    } else {
+        std::cerr << "Local translation worker exited with code: " << process->exit_code() << "\n";
+    }
+
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    if (resultCount < submitted) {
+        std::cerr << "Local translation worker returned " << resultCount << " of " << submitted << " segments." << "\n";
+    }
+    std::vector<Result> remaining = std::move(results);
+    results.clear();
+    return remaining;
+}
+
+bool LocalTranslationWorker::isFailedLine(const std::string& line) {
+    const std::string prefix = "FAILED,";
+    return line.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool LocalTranslationWorker::parseResultLine(const std::string& line, Result& result) {
+    const std::string prefix = "RESULT,";
+    if (line.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+
+    size_t chapterEnd = line.find(',', prefix.size());
+    if (chapterEnd == std::string::npos) {
+        return false;
+    }
+    size_t positionEnd = line.find(',', chapterEnd + 1);
+    if (positionEnd == std::string::npos) {
+        return false;
+    }
+
+    try {
+        result.chapterNum = std::stoi(line.substr(prefix.size(), chapterEnd - prefix.size()));
+        result.position = std::stoi(line.substr(chapterEnd + 1, positionEnd - chapterEnd - 1));
+    } catch (const std::exception& e) {
+        std::cerr << "Error parsing line: " << line << " - " << e.what() << "\n";
+        return false;
+    }
+    result.output = line.substr(positionEnd + 1);
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/process.hpp>
+
+#ifdef _WIN32
+#include <boost/process/windows.hpp>
+#endif
+
+// Keeps one translation process running with the model loaded and feeds it
+// segments over stdin as soon as they are known, instead of writing them all
+// to a file and starting the process once everything else has finished.
+// The process answers each "chapter,position,text" line with a
+// "RESULT,chapter,position,translation" line, or "FAILED,chapter,position"
+// when it could not translate it; everything else it prints is passed
+// through as log output.
+class LocalTranslationWorker {
+public:
+    struct Result {
+        int chapterNum;
+        int position;
+        std::string output;
+    };
+
+    explicit LocalTranslationWorker(const std::filesystem::path& executable, const std::vector<std::string>& arguments = {"-", "2"});
+    // Terminates the process if finish was never called
+    ~LocalTranslationWorker();
+    LocalTranslationWorker(const LocalTranslationWorker&) = delete;
+    LocalTranslationWorker& operator=(const LocalTranslationWorker&) = delete;
+
+    bool start();
+    bool isRunning() const { return started; }
+
+    // Queues one segment, the process starts on it while later ones are still being submitted
+    bool submit(int chapterNum, int position, const std::string& text);
+
+    // Waits until every segment submitted so far has been answered and returns
+    // the results not collected yet, the process keeps running for more
+    std::vector<Result> collect();
+
+    // Closes stdin, waits for the remaining translations and the process to exit
+    std::vector<Result> finish();
+
+    size_t submittedCount() const { return submitted; }
+
+protected:
+    static bool parseResultLine(const std::string& line, Result& result);
+    static bool isFailedLine(const std::string& line);
+
+    std::filesystem::path executable;
+    std::vector<std::string> arguments;
+
+    std::unique_ptr<boost::process::child> process;
+    boost::process::opstream pipeStdin;
+    boost::process::ipstream pipeStdout;
+    boost::process::ipstream pipeStderr;
+    std::thread stdoutThread;
+    std::thread stderrThread;
+
+    // Separate locks, a blocked write to stdin must never stop stdout from being drained
+    std::mutex stdinMutex;
+    std::mutex resultsMutex;
+    std::condition_variable answeredCondition;
+    std::vector<Result> results;
+    // Results and failures, counted over the whole run
+    size_t answered = 0;
+    size_t resultCount = 0;
+    bool outputClosed = false;
+    size_t submitted = 0;
+    bool started = false;
+};
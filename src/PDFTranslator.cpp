@@ -1,280 +1,395 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#include <cstdlib>
+#include "mupdf/fitz.h"
+
+// stb reads its PNG level from a process-wide global, which concurrent jobs
+// would race on. Its deflate is replaced with MuPDF's, which takes the level
+// of the page being written from these per-thread values instead.
+static thread_local fz_context* pngDeflateContext = nullptr;
+static thread_local int pngDeflateLevel = FZ_DEFLATE_DEFAULT;
+
+static unsigned char* deflatePngData(unsigned char* data, int dataLength, int* outLength, int /*quality*/) {
+    fz_context* ctx = pngDeflateContext;
+    if (!ctx || dataLength < 0) {
+        return nullptr;
+    }
+    size_t length = fz_deflate_bound(ctx, static_cast<size_t>(dataLength));
+    // stb releases the result with STBIW_FREE
+    unsigned char* compressed = static_cast<unsigned char*>(std::malloc(length));
+    if (!compressed) {
+        return nullptr;
+    }
+    fz_try(ctx) {
+        fz_deflate(ctx, compressed, &length, data, static_cast<size_t>(dataLength), static_cast<fz_deflate_level>(pngDeflateLevel));
+    } fz_catch(ctx) {
+        std::free(compressed);
+        return nullptr;
+    }
+    *outLength = static_cast<int>(length);
+    return compressed;
+}
+
+#define STBIW_ZLIB_COMPRESS deflatePngData
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
 #include "PDFTranslator.h"
 
 int PDFTranslator::run(const std::string& inputPath, const std::string& outputPath, int localModel, const std::string& deepLKey, std::string langcode) {
-    // Check if the main temp files exist and delete them
-    const std::string rawTextFilePath = "pdftext.txt";
-    const std::string extractedTextPath = "extractedPDFtext.txt";
-    const std::string imagesDir = "FilteredImages";
     std::string outputPdfPath = outputPath + "/output.pdf";
-    std::string translatedTagsPath = "translatedTags.txt";
-
-    std::filesystem::path rawTextFilePathPath = std::filesystem::u8path(rawTextFilePath);
-    std::filesystem::path extractedTextPathPath = std::filesystem::u8path(extractedTextPath);
-    std::filesystem::path imagesDirPath = std::filesystem::u8path(imagesDir);
-    std::filesystem::path translatedTagsPathPath = std::filesystem::u8path(translatedTagsPath);
-
 
-    // Check if the temp files exist and delete them
-    if (std::filesystem::exists(rawTextFilePathPath)) {
-        std::filesystem::remove(rawTextFilePathPath);
-    }
-    if (std::filesystem::exists(extractedTextPathPath)) {
-        std::filesystem::remove(extractedTextPathPath);
-    }
-    if (std::filesystem::exists(imagesDirPath)) {
-        std::filesystem::remove_all(imagesDirPath);
-    }
-    if (std::filesystem::exists(translatedTagsPathPath)) {
-        std::filesystem::remove(translatedTagsPathPath);
+    // Everything this job needs on disk lives in its own directory, so two
+    // PDFs can be translated at the same time from the same working directory
+    std::filesystem::path jobDir = createJobDirectory();
+    if (jobDir.empty()) {
+        return 1;
     }
+    const std::string imagesDir = (jobDir / "FilteredImages").string();
 
-
-    // Ensure the images directory exists
-    if (!std::filesystem::exists(imagesDir)) {
-        std::filesystem::create_directory(imagesDir);
+    auto finish = [&](int exitCode) {
+        if (keepIntermediateFiles) {
+            std::cout << "Intermediate files kept in " << jobDir.string() << std::endl;
+        } else {
+            std::error_code ec;
+            std::filesystem::remove_all(jobDir, ec);
+        }
+        return exitCode;
+    };
+
+    // One pass over the PDF collects the text in memory and writes the
+    // illustration pages to imagesDir. Keeping the layout needs the text
+    // blocks instead, and no page has to be rendered.
+    const bool preserveLayout = pdfOutputMode == PdfOutputMode::PreserveLayout;
+    if (pageWindow > 0 && !preserveLayout) {
+        return finish(translateInPageWindows(inputPath, outputPdfPath, jobDir, localModel, deepLKey, langcode));
     }
 
-    // Delete all the images in the imagesDir
-    if (std::filesystem::exists(imagesDir)) {
-        for (const auto& entry : std::filesystem::directory_iterator(imagesDir)) {
-            std::filesystem::remove(entry.path());
+    std::ostringstream extractedStream;
+    std::vector<PdfTextBlock> textBlocks;
+    try {
+        if (preserveLayout) {
+            extractTextBlocksFromPDF(inputPath, extractedStream, textBlocks);
+        } else {
+            extractTextAndImagesFromPDF(inputPath, extractedStream, imagesDir, 50.0f);
         }
+    } catch (const std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return finish(1);
+    }
+    const std::string extractedText = extractedStream.str();
+    extractedStream.str(std::string());
+
+    std::cout << "Finished extracting text and images from PDF" << '\n';
+
+    // The sentences point into extractedText or textBlocks, which outlive them.
+    // A sentence never crosses a block, so each one belongs to exactly one.
+    std::vector<std::string_view> sentences;
+    std::vector<size_t> sentenceBlocks;
+    if (preserveLayout) {
+        for (size_t block = 0; block < textBlocks.size(); ++block) {
+            for (std::string_view sentence : splitJapaneseSpans(textBlocks[block].text, 300)) {
+                sentences.push_back(sentence);
+                sentenceBlocks.push_back(block);
+            }
+        }
+    } else {
+        sentences = splitJapaneseSpans(extractedText, 300);
     }
 
-    std::filesystem::path currentDirPath = std::filesystem::current_path();
-
-
-    // Convert the PDF to images
-    convertPdfToImages(inputPath, imagesDir, 50.0f);
-
-    std::cout << "Finished converting PDF to images" << '\n';
+    std::cout << "Finished splitting text" << '\n';
 
-    // Extracts text from the PDF and writes it to extractedPDFtext.txt
-    extractTextFromPDF(inputPath, extractedTextPath);
+    if (keepIntermediateFiles) {
+        writeIntermediateFile(jobDir / "extractedPDFtext.txt", {extractedText});
+        writeIntermediateFile(jobDir / "sentences.txt", sentences);
+    }
 
-    
+    std::vector<std::string> translatedSentences;
+    if (translateSentences(sentences, jobDir, localModel, deepLKey, langcode, translatedSentences) != 0) {
+        return finish(1);
+    }
 
+    if (keepIntermediateFiles) {
+        writeIntermediateFile(jobDir / "translated.txt", std::vector<std::string_view>(translatedSentences.begin(), translatedSentences.end()));
+    }
 
+    if (preserveLayout) {
+        if (translatedSentences.size() == sentences.size()) {
+            std::vector<std::string> blockTranslations(textBlocks.size());
+            for (size_t i = 0; i < translatedSentences.size(); ++i) {
+                std::string& blockText = blockTranslations[sentenceBlocks[i]];
+                if (!blockText.empty() && !translatedSentences[i].empty()) {
+                    blockText += ' ';
+                }
+                blockText += translatedSentences[i];
+            }
 
-    try {
-        // Splits the merged japanese into sentence and writes it to pdftext.txt
-        std::vector<std::string> sentences = processAndSplitText(extractedTextPath, 300);
+            if (!createLayoutPreservingPDF(inputPath, outputPdfPath, textBlocks, blockTranslations)) {
+                return finish(1);
+            }
 
-        // Open the output file
-        std::ofstream outputFile(rawTextFilePath);
-        if (!outputFile.is_open()) {
-            throw std::runtime_error("Failed to open output file: " + rawTextFilePath);
+            std::cout << "Finished" << std::endl;
+            return finish(0);
         }
 
-        // Handle DeepL request
-        if (localModel == 1) {
-            if (deepLKey.empty()) {
-                std::cerr << "No DeepL API key provided." << std::endl;
-                return 1;
-            }
-
-            // Write each sentence to the file with a corresponding number
-            for (size_t i = 0; i < sentences.size(); ++i) {
-                outputFile << sentences[i] << "\n";
-            }
+        // DeepL's document endpoint is free to merge or split lines
+        std::cerr << "Got " << translatedSentences.size() << " translations for " << sentences.size()
+                  << " sentences, they cannot be matched to their blocks. Writing reflowed text instead." << std::endl;
 
-            // // Test writing to the file limit the number of sentences
-            // for (size_t i = 0; i < 5; ++i) {
-            //     outputFile << sentences[i] << "\n";
-            // }
-            
+        // The layout pass rendered no pages, the reflowed PDF still needs its illustrations
+        convertPdfToImages(inputPath, imagesDir, 50.0f);
+    }
 
-            outputFile.close();
+    try {
+        createPDF(outputPdfPath, translatedSentences, imagesDir);
+    }
+    catch (const std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return finish(1);
+    }
 
-            const std::string translatedTextPath = "translatedDeepL.txt";
+    std::cout << "Finished" << std::endl;
 
+    return finish(0);
+}
 
-            int result = handleDeepLRequest(rawTextFilePath, translatedTextPath, deepLKey);
+void PDFTranslator::setKeepIntermediateFiles(bool keep) {
+    keepIntermediateFiles = keep;
+}
 
-            if (result != 0) {
-                std::cerr << "Failed to handle DeepL request." << std::endl;
-                return 1;
-            }
+void PDFTranslator::setPdfOutputMode(PdfOutputMode mode) {
+    pdfOutputMode = mode;
+}
 
-            // Check if the translated text file exists
-            if (!std::filesystem::exists(translatedTextPath)) {
-                std::cerr << "Translated text file not found: " << translatedTextPath << std::endl;
-                return 1;
-            }
+void PDFTranslator::setFontsDirectory(const std::filesystem::path& directory) {
+    fontsDirectory = directory;
+}
 
-            // Open the translated text file and read in each line as a sentence but skip lines that are just \n
-            std::ifstream translatedFile(translatedTextPath);
+void PDFTranslator::setPageWindow(int pagesPerWindow, size_t memoryBudget) {
+    pageWindow = std::max(pagesPerWindow, 0);
+    this->memoryBudget = memoryBudget;
+}
 
-            if (!translatedFile.is_open()) {
-                std::cerr << "Failed to open translated text file: " << translatedTextPath << std::endl;
-                return 1;
-            }
+int PDFTranslator::translateInPageWindows(const std::string& inputPath, const std::string& outputPdfPath, const std::filesystem::path& jobDir, int localModel, const std::string& deepLKey, const std::string& langcode) {
+    fz_context* ctx = nullptr;
+    int pageCount = 0;
+    try {
+        ctx = createMuPDFContext();
+        pageCount = countPages(ctx, inputPath);
+    } catch (const std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        if (ctx) fz_drop_context(ctx);
+        return 1;
+    }
 
-            std::vector<std::string> translatedSentences;
-            std::string line;
+    auto [surface, cr] = initCairoPdfSurface(outputPdfPath, reflowPageWidth, reflowPageHeight);
+    configureTextRendering(cr, "Helvetica", reflowFontSize);
 
-            while (std::getline(translatedFile, line)) {
-                if (!line.empty() && line.find_first_not_of(" \t\r\n") != std::string::npos) {
-                    translatedSentences.push_back(line);
-                }
-            }
+    // Fonts are loaded and every word measured once for the whole run, later
+    // windows reuse the glyph runs and advances of the earlier ones
+    FontManager fonts(fontsDirectory, reflowFontSize);
+    TextLayout layout = reflowLayout(fonts, cr);
 
-            translatedFile.close();
+    // The model is loaded once for the whole run, not once per window
+    std::unique_ptr<LocalTranslationWorker> localWorker;
+    if (localModel != 1) {
+        localWorker = std::make_unique<LocalTranslationWorker>(localTranslationExecutable, localTranslationArguments);
+    }
 
-            // Write the translated sentence back to translatedTextPath
-            std::ofstream translatedOutputFile(translatedTextPath);
+    // The text of one window continues on the page the previous one ended on
+    double y = reflowMargin;
+    int result = 0;
+    std::ostringstream windowStream;
+    for (int firstPage = 0, window = 1; firstPage < pageCount; firstPage += pageWindow, ++window) {
+        const int endPage = std::min(firstPage + pageWindow, pageCount);
+        std::cout << "Processing pages " << firstPage + 1 << "-" << endPage << " of " << pageCount << std::endl;
+
+        // Each window keeps its pages in a directory of its own, so the
+        // kept pages of earlier windows are never collected twice
+        const std::filesystem::path imagesDir = jobDir / ("FilteredImages-" + std::to_string(window));
+        std::filesystem::create_directory(imagesDir);
 
-            if (!translatedOutputFile.is_open()) {
-                std::cerr << "Failed to open translated text file for writing: " << translatedTextPath << std::endl;
-                return 1;
-            }
+        windowStream.str(std::string());
+        try {
+            processPDF(ctx, inputPath, windowStream, imageOptions(imagesDir.string(), 50.0f), nullptr, firstPage, endPage);
+        } catch (const std::exception& ex) {
+            std::cerr << "Exception: " << ex.what() << std::endl;
+            result = 1;
+            break;
+        }
+        const std::string extractedText = windowStream.str();
+        windowStream.str(std::string());
 
-            for (const auto& sentence : translatedSentences) {
-                translatedOutputFile << sentence << "\n";
-            }
+        std::vector<std::string_view> sentences = splitJapaneseSpans(extractedText, 300);
+        std::vector<std::string> translatedSentences;
+        if (!sentences.empty() && translateSentences(sentences, jobDir, localModel, deepLKey, langcode, translatedSentences, localWorker.get()) != 0) {
+            result = 1;
+            break;
+        }
 
-            translatedOutputFile.close();
+        if (keepIntermediateFiles) {
+            const std::string suffix = "-" + std::to_string(window) + ".txt";
+            writeIntermediateFile(jobDir / ("sentences" + suffix), sentences);
+            writeIntermediateFile(jobDir / ("translated" + suffix), std::vector<std::string_view>(translatedSentences.begin(), translatedSentences.end()));
+        }
 
-            
-            createPDF(outputPdfPath, translatedTextPath, imagesDir);
-            
-            if (std::filesystem::exists(rawTextFilePathPath)) {
-                std::filesystem::remove(rawTextFilePathPath);
-            }
-            if (std::filesystem::exists(extractedTextPathPath)) {
-                std::filesystem::remove(extractedTextPathPath);
-            }
-            if (std::filesystem::exists(imagesDirPath)) {
-                std::filesystem::remove_all(imagesDirPath);
+        // The kept pages of a window go on pages of their own before its text
+        std::vector<std::string> imageFiles = collectImageFiles(imagesDir.string());
+        if (!imageFiles.empty()) {
+            if (y > reflowMargin) {
+                cairo_show_page(cr);
+                y = reflowMargin;
             }
-            if (std::filesystem::exists(translatedTagsPathPath)) {
-                std::filesystem::remove(translatedTagsPathPath);
+            if (addImagesToPdf(cr, surface, imageFiles)) {
+                cairo_pdf_surface_set_size(surface, reflowPageWidth, reflowPageHeight);
             }
-
-            return 0;
-
         }
+        y = addTextToPdf(cr, surface, fonts, layout, translatedSentences, reflowPageWidth, reflowPageHeight, reflowMargin, reflowLineSpacing, reflowFontSize, y);
 
-
-        // Write each sentence to the file with a corresponding number
-        for (size_t i = 0; i < sentences.size(); ++i) {
-            outputFile << (i + 1) << ",>>" << langcode << "<< " << sentences[i] << "\n";
+        // cairo has written the window's pages, nothing of it is needed any more
+        if (!keepIntermediateFiles) {
+            std::error_code ec;
+            std::filesystem::remove_all(imagesDir, ec);
         }
-
-        outputFile.close();
-
-    } catch (const std::exception& ex) {
-        std::cerr << "Exception: " << ex.what() << std::endl;
-        return 1;
+        fz_empty_store(ctx);
     }
 
-    std::cout << "Finished splitting text" << '\n';
-    std::string chapterNumberMode = "1";    // PDF does not have chapters, so use mode 1
-    
-    //Start the multiprocessing translaton
-    std::filesystem::path translationExe;
-
-    #if defined(__APPLE__)
-        translationExe = currentDirPath / "translation";
-
-    #elif defined(_WIN32)
-        translationExe = currentDirPath / "translation.exe";
-    #else
-        std::cerr << "Unsupported platform!" << std::endl;
-        return 1; // Or some other error handling
-    #endif
-
-    if (!std::filesystem::exists(translationExe)) {
-        std::cerr << "Executable not found: " << translationExe << std::endl;
-        return 1;
+    if (localWorker) {
+        localWorker->finish();
     }
+    cleanupCairo(cr, surface);
+    fz_drop_context(ctx);
 
-    std::string translationExePath = translationExe.string();
-    
-
-    std::cout << "Before call to translation.exe" << '\n';
+    if (result == 0) {
+        std::cout << "Finished" << std::endl;
+    }
+    return result;
+}
 
-    boost::process::ipstream pipe_stdout, pipe_stderr;
+void PDFTranslator::setLocalTranslationCommand(const std::filesystem::path& executable, const std::vector<std::string>& arguments) {
+    localTranslationExecutable = executable;
+    localTranslationArguments = arguments;
+}
 
-    try {
-        #if defined(_WIN32)
-            boost::process::child c(
-                translationExePath,
-                rawTextFilePath,
-                chapterNumberMode,
-                boost::process::std_out > pipe_stdout, 
-                boost::process::std_err > pipe_stderr,
-                boost::process::windows::hide
-            );
-        #else
-            boost::process::child c(
-                translationExePath,
-                rawTextFilePath,
-                chapterNumberMode,
-                boost::process::std_out > pipe_stdout, 
-                boost::process::std_err > pipe_stderr
-            );
-        #endif
-        
-        // Threads to handle asynchronous reading
-        std::thread stdout_thread([&pipe_stdout]() {
-            std::string line;
-            while (std::getline(pipe_stdout, line)) {
-                std::cout << line << "\n";
-            }
-        });
+std::filesystem::path PDFTranslator::createJobDirectory() {
+    std::random_device rd;
+    std::error_code ec;
+    for (int attempt = 0; attempt < 16; ++attempt) {
+        std::ostringstream name;
+        name << "BookTranslator-pdf-" << std::hex << rd() << rd();
+        std::filesystem::path dir = std::filesystem::temp_directory_path(ec) / name.str();
+        if (ec) {
+            break;
+        }
+        // create_directory is false when the name is already taken by another job
+        if (std::filesystem::create_directory(dir, ec)) {
+            return dir;
+        }
+        if (ec) {
+            break;
+        }
+    }
+    std::cerr << "Failed to create a working directory for the PDF job: " << ec.message() << std::endl;
+    return {};
+}
 
-        std::thread stderr_thread([&pipe_stderr]() {
-            std::string line;
-            while (std::getline(pipe_stderr, line)) {
-                std::cerr << "Python stderr: " << line << "\n";
-            }
-        });
+void PDFTranslator::writeIntermediateFile(const std::filesystem::path& path, const std::vector<std::string_view>& lines) {
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write intermediate file: " << path.string() << std::endl;
+        return;
+    }
+    for (std::string_view line : lines) {
+        file << line << "\n";
+    }
+}
 
-        c.wait(); // Wait for process completion
+int PDFTranslator::translateSentencesWithDeepL(const std::vector<std::string_view>& sentences, const std::filesystem::path& workDir, const std::string& deepLKey, std::vector<std::string>& translatedSentences) {
+    // The document endpoint only accepts an uploaded file, so the sentences
+    // are written to this job's directory rather than the working directory
+    std::filesystem::path uploadPath = workDir / "pdftext.txt";
+    {
+        std::ofstream uploadFile(uploadPath, std::ios::out | std::ios::binary);
+        if (!uploadFile.is_open()) {
+            std::cerr << "Failed to open output file: " << uploadPath.string() << std::endl;
+            return 1;
+        }
+        for (std::string_view sentence : sentences) {
+            uploadFile << sentence << "\n";
+        }
+    }
 
-        stdout_thread.join();
-        stderr_thread.join();
+    std::string translatedText;
+    if (handleDeepLRequest(uploadPath.string(), translatedText, deepLKey) != 0) {
+        return 1;
+    }
 
-        if (c.exit_code() == 0) {
-            std::cout << "Translation Python script executed successfully." << "\n";
-        } else {
-            std::cerr << "Translation Python script exited with code: " << c.exit_code() << "\n";
+    // Keep one entry per line but skip the blank lines DeepL adds
+    translatedSentences.clear();
+    std::istringstream translatedLines(translatedText);
+    std::string line;
+    while (std::getline(translatedLines, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.find_first_not_of(" \t") != std::string::npos) {
+            translatedSentences.push_back(std::move(line));
         }
-    } catch (const std::exception& ex) {
-        std::cerr << "Exception: " << ex.what() << "\n";
     }
 
-    std::cout << "After call to translation.exe" << '\n';
+    return 0;
+}
 
-    
+int PDFTranslator::translateSentences(const std::vector<std::string_view>& sentences, const std::filesystem::path& workDir, int localModel, const std::string& deepLKey, const std::string& langcode, std::vector<std::string>& translatedSentences, LocalTranslationWorker* localWorker) {
+    if (localModel == 1) {
+        if (deepLKey.empty()) {
+            std::cerr << "No DeepL API key provided." << std::endl;
+            return 1;
+        }
 
-    try {
-        createPDF(outputPdfPath, "translatedTags.txt", imagesDir);
-    }
-    catch (const std::exception& ex) {
-        std::cerr << "Exception: " << ex.what() << std::endl;
+        if (translateSentencesWithDeepL(sentences, workDir, deepLKey, translatedSentences) != 0) {
+            std::cerr << "Failed to handle DeepL request." << std::endl;
+            return 1;
+        }
+    } else if (translateSentencesLocally(sentences, langcode, translatedSentences, localWorker) != 0) {
+        std::cerr << "Local model translation failed." << std::endl;
         return 1;
     }
+    return 0;
+}
 
-    if (std::filesystem::exists(rawTextFilePathPath)) {
-        std::filesystem::remove(rawTextFilePathPath);
+int PDFTranslator::translateSentencesLocally(const std::vector<std::string_view>& sentences, const std::string& langcode, std::vector<std::string>& translatedSentences, LocalTranslationWorker* sharedWorker) {
+    std::unique_ptr<LocalTranslationWorker> ownWorker;
+    if (!sharedWorker) {
+        ownWorker = std::make_unique<LocalTranslationWorker>(localTranslationExecutable, localTranslationArguments);
     }
-    if (std::filesystem::exists(extractedTextPathPath)) {
-        std::filesystem::remove(extractedTextPathPath);
-    }
-    if (std::filesystem::exists(imagesDirPath)) {
-        std::filesystem::remove_all(imagesDirPath);
+    LocalTranslationWorker& worker = sharedWorker ? *sharedWorker : *ownWorker;
+    if (!worker.start()) {
+        return 1;
     }
-    if (std::filesystem::exists(translatedTagsPathPath)) {
-        std::filesystem::remove(translatedTagsPathPath);
+
+    // PDFs have no chapters, every sentence is sent as chapter 0 with its
+    // 1-based number as the position
+    for (size_t i = 0; i < sentences.size(); ++i) {
+        std::string segment = ">>" + langcode + "<< ";
+        segment.append(sentences[i].data(), sentences[i].size());
+        if (!worker.submit(0, static_cast<int>(i + 1), segment)) {
+            std::cerr << "Failed to send sentence " << (i + 1) << " to the local model." << std::endl;
+            return 1;
+        }
     }
 
-    std::cout << "Finished" << std::endl;
+    std::cout << "Waiting for local model translation of " << sentences.size() << " sentences" << '\n';
+    // A shared worker keeps the model loaded for the caller's next batch
+    std::vector<LocalTranslationWorker::Result> results = sharedWorker ? worker.collect() : worker.finish();
+
+    // Results come back in the order they finished, each one goes back to
+    // its sentence's slot and sentences the model failed on stay empty
+    translatedSentences.assign(sentences.size(), std::string());
+    for (auto& result : results) {
+        if (result.position >= 1 && static_cast<size_t>(result.position) <= sentences.size()) {
+            translatedSentences[result.position - 1] = std::move(result.output);
+        }
+    }
 
     return 0;
 }
@@ -293,8 +408,25 @@ std::string PDFTranslator::removeWhitespace(const std::string &input) {
     return result;
 }
 
+// MuPDF only allows fz_clone_context on contexts created with lock callbacks.
+// The mutexes are shared by every context for the lifetime of the program.
+static void lockMuPDF(void* user, int lock) {
+    static_cast<std::mutex*>(user)[lock].lock();
+}
+
+static void unlockMuPDF(void* user, int lock) {
+    static_cast<std::mutex*>(user)[lock].unlock();
+}
+
+static fz_locks_context* muPDFLocks() {
+    static std::mutex mutexes[FZ_LOCK_MAX];
+    static fz_locks_context locks = { mutexes, lockMuPDF, unlockMuPDF };
+    return &locks;
+}
+
 fz_context* PDFTranslator::createMuPDFContext() {
-    fz_context* ctx = fz_new_context(NULL, NULL, FZ_STORE_DEFAULT);
+    // Cloned worker contexts share this store, so the budget covers all of them
+    fz_context* ctx = fz_new_context(NULL, muPDFLocks(), memoryBudget > 0 ? memoryBudget : FZ_STORE_DEFAULT);
     if (!ctx) {
         throw std::runtime_error("Failed to create MuPDF context.");
     }
@@ -303,7 +435,7 @@ fz_context* PDFTranslator::createMuPDFContext() {
 }
 
 
-void PDFTranslator::extractTextFromPage(fz_context* ctx, fz_document* doc, int pageIndex, std::ofstream& outputFile) {
+void PDFTranslator::extractTextFromPage(fz_context* ctx, fz_document* doc, int pageIndex, std::ostream& outputFile, std::vector<PdfTextBlock>* textBlocks) {
     fz_page* page = nullptr;
     fz_stext_page* textPage = nullptr;
     fz_device* textDevice = nullptr;
@@ -321,12 +453,14 @@ void PDFTranslator::extractTextFromPage(fz_context* ctx, fz_document* doc, int p
         textDevice = fz_new_stext_device(ctx, textPage, &options);
 
         fz_run_page(ctx, page, textDevice, fz_identity, NULL);
+        // Block and line bounds are only final once the device is closed
+        fz_close_device(ctx, textDevice);
 
         if (!pageContainsText(textPage)) {
             return;
         }
 
-        extractTextFromBlocks(textPage, outputFile);
+        extractTextFromBlocks(textPage, outputFile, pageIndex, textBlocks);
 
     } fz_always(ctx) {
         if (textDevice) fz_drop_device(ctx, textDevice);
@@ -337,6 +471,206 @@ void PDFTranslator::extractTextFromPage(fz_context* ctx, fz_document* doc, int p
     }
 }
 
+void PDFTranslator::processPage(fz_context* ctx, fz_document* doc, int pageIndex, const PageProcessingOptions& options, std::ostream& outputFile, std::vector<PdfTextBlock>* textBlocks) {
+    if (!options.renderImages) {
+        if (options.extractText) {
+            extractTextFromPage(ctx, doc, pageIndex, outputFile, textBlocks);
+        }
+        return;
+    }
+
+    fz_page* page = nullptr;
+    fz_display_list* list = nullptr;
+    fz_stext_page* textPage = nullptr;
+    fz_pixmap* pixmap = nullptr;
+
+    fz_try(ctx) {
+        page = fz_load_page(ctx, doc, pageIndex);
+
+        // The page content is interpreted once, text extraction and every
+        // render replay the recorded list instead
+        list = fz_new_display_list_from_page(ctx, page);
+
+        // Image blocks are kept so a scanned page can be saved from its original JPEG stream
+        fz_stext_options stextOptions = { 0 };
+        stextOptions.flags = FZ_STEXT_PRESERVE_IMAGES;
+        if (options.extractText) {
+            textPage = fz_new_stext_page_from_display_list(ctx, list, &stextOptions);
+            if (pageContainsText(textPage)) {
+                extractTextFromBlocks(textPage, outputFile, pageIndex, textBlocks);
+            }
+        }
+
+        if (isPageImageCandidate(ctx, list, options.stdDevThreshold)) {
+            pixmap = fz_new_pixmap_from_display_list(ctx, list, fz_identity, fz_device_rgb(ctx), 1);
+            if (isPixmapAboveThreshold(ctx, pixmap, options.stdDevThreshold)) {
+                if (!textPage) {
+                    textPage = fz_new_stext_page_from_display_list(ctx, list, &stextOptions);
+                }
+                // Re-encoding a JPEG scan only makes it bigger, so its original
+                // stream is kept whichever output format was asked for
+                fz_buffer* jpeg = findFullPageJpeg(ctx, textPage, fz_bound_display_list(ctx, list));
+                if (!jpeg || !writeEmbeddedJpeg(ctx, jpeg, pageIndex, options)) {
+                    writePageImage(ctx, pixmap, pageIndex, options);
+                }
+            }
+        }
+    } fz_always(ctx) {
+        if (pixmap) fz_drop_pixmap(ctx, pixmap);
+        if (textPage) fz_drop_stext_page(ctx, textPage);
+        if (list) fz_drop_display_list(ctx, list);
+        if (page) fz_drop_page(ctx, page);
+    } fz_catch(ctx) {
+        std::cerr << "Error processing page " << pageIndex + 1 << std::endl;
+    }
+}
+
+bool PDFTranslator::writePageImage(fz_context* ctx, fz_pixmap* pixmap, int pageIndex, const PageProcessingOptions& options) {
+    const unsigned char* samples = fz_pixmap_samples(ctx, pixmap);
+    int width = fz_pixmap_width(ctx, pixmap);
+    int height = fz_pixmap_height(ctx, pixmap);
+    int components = fz_pixmap_components(ctx, pixmap);
+    ptrdiff_t stride = fz_pixmap_stride(ctx, pixmap);
+
+    bool useJpeg = options.imageFormat == PageImageFormat::Jpeg ||
+        (options.imageFormat == PageImageFormat::Auto && isPhotographic(samples, width, height, components, stride));
+
+    char outputPath[1024];
+    snprintf(outputPath, sizeof(outputPath), "%s/page_%03d.%s", options.imagesDir.c_str(), pageIndex + 1, useJpeg ? "jpg" : "png");
+
+    bool saved = true;
+    if (!useJpeg && options.pngCompressionLevel < 0) {
+        fz_save_pixmap_as_png(ctx, pixmap, outputPath);
+    } else {
+        // stb has no alpha-aware JPEG and the samples are premultiplied, so both
+        // stb paths write the page composited onto white
+        std::vector<unsigned char> rgb = flattenOntoWhite(samples, width, height, components, stride);
+        pngDeflateContext = ctx;
+        pngDeflateLevel = std::clamp(options.pngCompressionLevel, 0, 9);
+        saved = useJpeg
+            ? stbi_write_jpg(outputPath, width, height, 3, rgb.data(), options.jpegQuality) != 0
+            : stbi_write_png(outputPath, width, height, 3, rgb.data(), width * 3) != 0;
+    }
+
+    if (!saved) {
+        std::cerr << "Failed to write page image: " << outputPath << std::endl;
+        return false;
+    }
+    std::cout << "Saved: " << outputPath << std::endl;
+    return true;
+}
+
+fz_buffer* PDFTranslator::findFullPageJpeg(fz_context* ctx, fz_stext_page* textPage, fz_rect pageBounds) {
+    fz_image* pageImage = nullptr;
+    fz_rect imageBounds = {};
+    for (fz_stext_block* block = textPage->first_block; block; block = block->next) {
+        if (block->type != FZ_STEXT_BLOCK_IMAGE) {
+            continue;
+        }
+        // Anything drawn over another image would be lost
+        if (pageImage) {
+            return nullptr;
+        }
+        pageImage = block->u.i.image;
+        imageBounds = block->bbox;
+
+        const fz_matrix& transform = block->u.i.transform;
+        if (transform.b != 0 || transform.c != 0 || transform.a <= 0 || transform.d <= 0) {
+            return nullptr;
+        }
+    }
+    if (!pageImage || pageImage->mask || (pageImage->n != 1 && pageImage->n != 3)) {
+        return nullptr;
+    }
+
+    // Text over the image is usually an invisible OCR layer, text beside it
+    // (a caption, a page number) would be missing from the saved image
+    for (fz_stext_block* block = textPage->first_block; block; block = block->next) {
+        if (block->type == FZ_STEXT_BLOCK_TEXT &&
+            (block->bbox.x0 < imageBounds.x0 || block->bbox.y0 < imageBounds.y0 ||
+             block->bbox.x1 > imageBounds.x1 || block->bbox.y1 > imageBounds.y1)) {
+            return nullptr;
+        }
+    }
+
+    float pageArea = (pageBounds.x1 - pageBounds.x0) * (pageBounds.y1 - pageBounds.y0);
+    float imageArea = (imageBounds.x1 - imageBounds.x0) * (imageBounds.y1 - imageBounds.y0);
+    if (pageArea <= 0 || imageArea < pageArea * fullPageImageCoverage) {
+        return nullptr;
+    }
+
+    fz_compressed_buffer* compressed = fz_compressed_image_buffer(ctx, pageImage);
+    if (!compressed || compressed->params.type != FZ_IMAGE_JPEG) {
+        return nullptr;
+    }
+    return compressed->buffer;
+}
+
+bool PDFTranslator::writeEmbeddedJpeg(fz_context* ctx, fz_buffer* jpeg, int pageIndex, const PageProcessingOptions& options) {
+    unsigned char* data = nullptr;
+    size_t size = fz_buffer_storage(ctx, jpeg, &data);
+    if (!data || size == 0) {
+        return false;
+    }
+
+    char outputPath[1024];
+    snprintf(outputPath, sizeof(outputPath), "%s/page_%03d.jpg", options.imagesDir.c_str(), pageIndex + 1);
+
+    std::ofstream outputFile(outputPath, std::ios::out | std::ios::binary);
+    if (!outputFile.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size))) {
+        std::cerr << "Failed to write page image: " << outputPath << std::endl;
+        return false;
+    }
+    std::cout << "Saved original JPEG: " << outputPath << std::endl;
+    return true;
+}
+
+bool PDFTranslator::isPhotographic(const unsigned char* samples, int width, int height, int components, ptrdiff_t stride) {
+    if (!samples || width <= 0 || height <= 0 || components < 3) {
+        return false;
+    }
+
+    // Count distinct colours at 4 bits per channel over a sample of pixels.
+    // Line art and text use a handful, photos and painted pages fill most buckets.
+    std::vector<bool> seen(4096, false);
+    size_t distinct = 0;
+    int step = std::max(1, static_cast<int>(std::sqrt(static_cast<double>(width) * height / 65536.0)));
+
+    for (int y = 0; y < height; y += step) {
+        const unsigned char* row = samples + y * stride;
+        for (int x = 0; x < width; x += step) {
+            const unsigned char* pixel = row + x * components;
+            int bucket = ((pixel[0] >> 4) << 8) | ((pixel[1] >> 4) << 4) | (pixel[2] >> 4);
+            if (!seen[bucket]) {
+                seen[bucket] = true;
+                distinct++;
+            }
+        }
+    }
+
+    return distinct > photographicColourBuckets;
+}
+
+std::vector<unsigned char> PDFTranslator::flattenOntoWhite(const unsigned char* samples, int width, int height, int components, ptrdiff_t stride) {
+    std::vector<unsigned char> rgb(static_cast<size_t>(width) * height * 3);
+    bool hasAlpha = components == 4 || components == 2;
+    bool isGray = components < 3;
+
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = samples + y * stride;
+        unsigned char* out = rgb.data() + static_cast<size_t>(y) * width * 3;
+        for (int x = 0; x < width; ++x) {
+            const unsigned char* pixel = row + x * components;
+            // Premultiplied colour over white is colour + (255 - alpha)
+            int background = hasAlpha ? 255 - pixel[components - 1] : 0;
+            for (int c = 0; c < 3; ++c) {
+                out[x * 3 + c] = static_cast<unsigned char>(std::min(255, pixel[isGray ? 0 : c] + background));
+            }
+        }
+    }
+    return rgb;
+}
+
 bool PDFTranslator::pageContainsText(fz_stext_page* textPage) {
     for (fz_stext_block* block = textPage->first_block; block; block = block->next) {
         if (block->type == FZ_STEXT_BLOCK_TEXT) {
@@ -347,32 +681,58 @@ bool PDFTranslator::pageContainsText(fz_stext_page* textPage) {
 }
 
 
-void PDFTranslator::extractTextFromBlocks(fz_stext_page* textPage, std::ofstream& outputFile) {
+void PDFTranslator::extractTextFromBlocks(fz_stext_page* textPage, std::ostream& outputFile, int pageIndex, std::vector<PdfTextBlock>* textBlocks) {
+    // The whole page is built up in one buffer and written with a single call,
+    // a stream write per character dominated extraction on large books
+    std::string pageText;
     for (fz_stext_block* block = textPage->first_block; block; block = block->next) {
         if (block->type == FZ_STEXT_BLOCK_TEXT) {
-            extractTextFromLines(block, outputFile);
+            size_t blockStart = pageText.size();
+            extractTextFromLines(block, pageText);
+            if (textBlocks && pageText.size() > blockStart) {
+                textBlocks->push_back({pageIndex, block->bbox, pageText.substr(blockStart)});
+            }
+            if (!pageText.empty() && pageText.back() != '\n') {
+                pageText += '\n';
+            }
         }
     }
+    outputFile.write(pageText.data(), static_cast<std::streamsize>(pageText.size()));
 }
 
-void PDFTranslator::extractTextFromLines(fz_stext_block* block, std::ofstream& outputFile) {
+void PDFTranslator::extractTextFromLines(fz_stext_block* block, std::string& buffer) {
+    // Lines of a block are wrapped parts of the same paragraph. Japanese joins
+    // them directly, Latin text needs the space the line break stood for.
     for (fz_stext_line* line = block->u.t.first_line; line; line = line->next) {
-        extractTextFromChars(line, outputFile);
+        if (line != block->u.t.first_line && line->first_char && !buffer.empty()) {
+            unsigned char last = static_cast<unsigned char>(buffer.back());
+            int next = line->first_char->c;
+            if (last < 0x80 && last != ' ' && last != '\n' && next < 0x80 && next != ' ') {
+                buffer += ' ';
+            }
+        }
+        extractTextFromChars(line, buffer);
     }
 }
 
 
-void PDFTranslator::extractTextFromChars(fz_stext_line* line, std::ofstream& outputFile) {
+void PDFTranslator::extractTextFromChars(fz_stext_line* line, std::string& buffer) {
     for (fz_stext_char* ch = line->first_char; ch; ch = ch->next) {
-        char utf8[5] = { 0 };
+        if (ch->c < 0x80) {
+            buffer += static_cast<char>(ch->c);
+            continue;
+        }
+        char utf8[FZ_UTFMAX];
         int len = fz_runetochar(utf8, ch->c);
-        outputFile.write(utf8, len);
+        buffer.append(utf8, len);
     }
 }
 
 
-void PDFTranslator::processPDF(fz_context* ctx, const std::string& inputPath, std::ofstream& outputFile) {
+void PDFTranslator::processPDF(fz_context* ctx, const std::string& inputPath, std::ostream& outputFile, const PageProcessingOptions& options, std::vector<PdfTextBlock>* textBlocks, int firstPage, int endPage) {
     fz_document* doc = nullptr;
+    int pageCount = 0;
+    size_t workerCount = 1;
 
     // Check if the PDF file exists
     std::filesystem::path inputPDFPath = std::filesystem::u8path(inputPath);
@@ -387,11 +747,20 @@ void PDFTranslator::processPDF(fz_context* ctx, const std::string& inputPath, st
             throw std::runtime_error("Failed to open PDF file: " + inputPath);
         }
 
-        int pageCount = fz_count_pages(ctx, doc);
+        pageCount = fz_count_pages(ctx, doc);
         std::cout << "Total pages: " << pageCount << std::endl;
 
-        for (int i = 0; i < pageCount; ++i) {
-            extractTextFromPage(ctx, doc, i, outputFile);
+        if (endPage < 0 || endPage > pageCount) {
+            endPage = pageCount;
+        }
+        firstPage = std::clamp(firstPage, 0, endPage);
+
+        workerCount = std::min<size_t>(extractionWorkerCount(), static_cast<size_t>(std::max(endPage - firstPage, 1)));
+
+        if (workerCount <= 1) {
+            for (int i = firstPage; i < endPage; ++i) {
+                processPage(ctx, doc, i, options, outputFile, textBlocks);
+            }
         }
 
         fz_drop_document(ctx, doc);
@@ -399,6 +768,121 @@ void PDFTranslator::processPDF(fz_context* ctx, const std::string& inputPath, st
         if (doc) fz_drop_document(ctx, doc);
         throw std::runtime_error("An error occurred while processing the PDF.");
     }
+
+    if (workerCount > 1) {
+        processPagesInParallel(ctx, inputPath, firstPage, endPage, workerCount, options, outputFile, textBlocks);
+    }
+}
+
+int PDFTranslator::countPages(fz_context* ctx, const std::string& inputPath) {
+    if (!std::filesystem::exists(std::filesystem::u8path(inputPath))) {
+        throw std::runtime_error("PDF file does not exist: " + inputPath);
+    }
+
+    fz_document* doc = nullptr;
+    int pageCount = 0;
+    fz_try(ctx) {
+        doc = fz_open_document(ctx, inputPath.c_str());
+        pageCount = fz_count_pages(ctx, doc);
+    } fz_always(ctx) {
+        if (doc) fz_drop_document(ctx, doc);
+    } fz_catch(ctx) {
+        throw std::runtime_error("Failed to open PDF file: " + inputPath);
+    }
+    return pageCount;
+}
+
+size_t PDFTranslator::extractionWorkerCount() const {
+    if (extractionThreads > 0) {
+        return extractionThreads;
+    }
+    size_t cores = std::thread::hardware_concurrency();
+    return cores == 0 ? 1 : cores;
+}
+
+void PDFTranslator::setExtractionThreads(size_t threads) {
+    extractionThreads = threads;
+}
+
+void PDFTranslator::setPageImageOutput(PageImageFormat format, int pngCompressionLevel, int jpegQuality) {
+    pageImageFormat = format;
+    pagePngCompressionLevel = std::min(pngCompressionLevel, 9);
+    pageJpegQuality = std::clamp(jpegQuality, 1, 100);
+}
+
+PageProcessingOptions PDFTranslator::imageOptions(const std::string& imagesDir, float stdDevThreshold) const {
+    PageProcessingOptions options;
+    options.renderImages = true;
+    options.imagesDir = imagesDir;
+    options.stdDevThreshold = stdDevThreshold;
+    options.imageFormat = pageImageFormat;
+    options.pngCompressionLevel = pagePngCompressionLevel;
+    options.jpegQuality = pageJpegQuality;
+    return options;
+}
+
+void PDFTranslator::processPagesInParallel(fz_context* ctx, const std::string& inputPath, int firstPage, int endPage, size_t workerCount, const PageProcessingOptions& options, std::ostream& outputFile, std::vector<PdfTextBlock>* textBlocks) {
+    const int pageCount = endPage - firstPage;
+    std::cout << "Processing " << pageCount << " pages with " << workerCount << " threads." << std::endl;
+
+    // Each page gets its own buffer so the output keeps page order no matter
+    // which worker finishes first
+    std::vector<std::string> pageText(pageCount);
+    std::vector<std::vector<PdfTextBlock>> pageBlocks(textBlocks ? pageCount : 0);
+    std::atomic<int> nextPage{0};
+    std::atomic<bool> failed{false};
+
+    auto worker = [&]() {
+        // fz_context and fz_document must not be shared between threads, the
+        // clone shares the resource store and font cache with ctx
+        fz_context* workerCtx = fz_clone_context(ctx);
+        if (!workerCtx) {
+            failed = true;
+            return;
+        }
+
+        fz_document* workerDoc = nullptr;
+        fz_try(workerCtx) {
+            workerDoc = fz_open_document(workerCtx, inputPath.c_str());
+        } fz_catch(workerCtx) {
+            workerDoc = nullptr;
+        }
+
+        if (!workerDoc) {
+            failed = true;
+            fz_drop_context(workerCtx);
+            return;
+        }
+
+        // Pages are handed out one at a time, scanned pages take far longer than text ones
+        for (int i = nextPage++; i < pageCount && !failed; i = nextPage++) {
+            std::ostringstream pageStream;
+            processPage(workerCtx, workerDoc, firstPage + i, options, pageStream, textBlocks ? &pageBlocks[i] : nullptr);
+            pageText[i] = pageStream.str();
+        }
+
+        fz_drop_document(workerCtx, workerDoc);
+        fz_drop_context(workerCtx);
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    if (failed) {
+        throw std::runtime_error("An error occurred while processing the PDF.");
+    }
+
+    for (const auto& text : pageText) {
+        outputFile.write(text.data(), text.size());
+    }
+    for (auto& blocks : pageBlocks) {
+        textBlocks->insert(textBlocks->end(), std::make_move_iterator(blocks.begin()), std::make_move_iterator(blocks.end()));
+    }
 }
 
 void PDFTranslator::extractTextFromPDF(const std::string& inputPath, const std::string& outputFilePath) {
@@ -445,153 +929,182 @@ size_t PDFTranslator::getUtf8CharLength(unsigned char firstByte) {
     }
 }
 
-std::vector<std::string> PDFTranslator::splitLongSentences(const std::string& sentence, size_t maxLength) {
-    // You can adjust which words should "start" a new chunk vs. which punctuation 
-    // should "end" the current chunk.
-    // endBreakpoints appended to current chunk, then split.
-    // startBreakpoints cause us to split BEFORE them, then start a new chunk WITH them.
-    std::vector<std::string> endBreakpoints   = { "、", "。"};
-    std::vector<std::string> startBreakpoints = { "しかし", "そして", "だから", "そのため" };
-
-    std::vector<std::string> results;
-    std::string currentChunk;
+namespace {
+
+// Lead bytes of "、" "。" "「" "」" and the start breakpoints below, everything
+// else can be skipped without looking at the rest of the character
+constexpr unsigned char kCjkPunctuationLead = 0xE3;
+constexpr unsigned char kFullwidthFormsLead = 0xEF;
+
+bool startsWith(std::string_view text, size_t pos, std::string_view prefix) {
+    return text.size() - pos >= prefix.size() && std::memcmp(text.data() + pos, prefix.data(), prefix.size()) == 0;
+}
+
+// Length of the run of ASCII bytes starting at pos, checked eight bytes at a time
+size_t asciiRunLength(std::string_view text, size_t pos) {
+    size_t start = pos;
+    while (pos + 8 <= text.size()) {
+        uint64_t block;
+        std::memcpy(&block, text.data() + pos, sizeof(block));
+        if (block & 0x8080808080808080ULL) {
+            break;
+        }
+        pos += 8;
+    }
+    while (pos < text.size() && static_cast<unsigned char>(text[pos]) < 0x80) {
+        ++pos;
+    }
+    return pos - start;
+}
+
+} // namespace
+
+void PDFTranslator::splitLongSentenceSpans(std::string_view sentence, size_t maxLength, std::vector<std::string_view>& results) {
+    // endBreakpoints are kept at the end of the current chunk, startBreakpoints
+    // begin a new chunk. Chunks are always contiguous, so each one is just the
+    // range [chunkStart, i) of the sentence.
+    static constexpr std::string_view endBreakpoints[]   = { "、", "。" };
+    static constexpr std::string_view startBreakpoints[] = { "しかし", "そして", "だから", "そのため" };
+
+    size_t chunkStart = 0;
     size_t i = 0;
 
     while (i < sentence.size()) {
-        // Determine the length of the next UTF-8 character safely
-        size_t charLen = getUtf8CharLength(static_cast<unsigned char>(sentence[i]));
+        unsigned char lead = static_cast<unsigned char>(sentence[i]);
+        size_t charLen = getUtf8CharLength(lead);
 
         // Safety check if the UTF-8 seems truncated near the end of the string
         if (i + charLen > sentence.size()) {
-            // Add whatever is left as-is
-            currentChunk += sentence.substr(i);
+            i = sentence.size();
             break;
         }
 
-        // We'll look ahead at the substring starting at i to see if it matches
-        // any start breakpoint or end breakpoint.
-        std::string_view nextSubstring(&sentence[i], sentence.size() - i);
-
-        bool foundStartBreakpoint = false;
-        bool foundEndBreakpoint   = false;
-        std::string matchedBreakpoint;
-
-        // Check "startBreakpoints" first
-        for (auto&& sb : startBreakpoints) {
-            if (nextSubstring.compare(0, sb.size(), sb) == 0) {
-                foundStartBreakpoint = true;
-                matchedBreakpoint    = sb;
-                break;
-            }
-        }
-
-        // Check endBreakpoints only if we did not match a start-breakpoint
-        if (!foundStartBreakpoint) {
-            for (auto&& eb : endBreakpoints) {
-                if (nextSubstring.compare(0, eb.size(), eb) == 0) {
-                    foundEndBreakpoint = true;
-                    matchedBreakpoint  = eb;
+        std::string_view matchedBreakpoint;
+        bool isStartBreakpoint = false;
+        if (lead == kCjkPunctuationLead) {
+            for (std::string_view sb : startBreakpoints) {
+                if (startsWith(sentence, i, sb)) {
+                    matchedBreakpoint = sb;
+                    isStartBreakpoint = true;
                     break;
                 }
             }
+            if (!isStartBreakpoint) {
+                for (std::string_view eb : endBreakpoints) {
+                    if (startsWith(sentence, i, eb)) {
+                        matchedBreakpoint = eb;
+                        break;
+                    }
+                }
+            }
         }
 
-        if (foundStartBreakpoint) {
-            // Found a starting breakpoint
-            // End the current chunk before this word (if currentChunk not empty)
-            // Start a new chunk with that word included.
-
-            // If there's already something accumulated, push it out
-            if (!currentChunk.empty()) {
-                results.push_back(currentChunk);
-                currentChunk.clear();
+        if (isStartBreakpoint) {
+            // Close the current chunk before the word, the word starts the next one
+            if (i > chunkStart) {
+                results.push_back(sentence.substr(chunkStart, i - chunkStart));
             }
-
-            // Now start a new chunk that *begins* with the matched breakpoint
-            currentChunk += matchedBreakpoint;
+            chunkStart = i;
             i += matchedBreakpoint.size();
-
-        } else if (foundEndBreakpoint) {
-            // We have encountered punctuation like "、" or "。"
-            //  -> Add that punctuation to the current chunk
-            //  -> End the chunk immediately after.
-
-            currentChunk += matchedBreakpoint;
+        } else if (!matchedBreakpoint.empty()) {
+            // Punctuation stays with the current chunk, which ends right after it
             i += matchedBreakpoint.size();
-
-            // Now push this chunk
-            results.push_back(currentChunk);
-            currentChunk.clear();
-
+            results.push_back(sentence.substr(chunkStart, i - chunkStart));
+            chunkStart = i;
         } else {
-            // Just a normal character append to currentChunk
-            std::string nextChar = sentence.substr(i, charLen);
-            currentChunk += nextChar;
             i += charLen;
-
-            // Check if currentChunk reached maxLength
-            if (currentChunk.size() >= maxLength) {
-                results.push_back(currentChunk);
-                currentChunk.clear();
+            if (i - chunkStart >= maxLength) {
+                results.push_back(sentence.substr(chunkStart, i - chunkStart));
+                chunkStart = i;
             }
         }
     }
 
-    // If something remains in currentChunk, push it out
-    if (!currentChunk.empty()) {
-        results.push_back(currentChunk);
+    if (i > chunkStart) {
+        results.push_back(sentence.substr(chunkStart, i - chunkStart));
     }
-
-    return results;
 }
 
-// Function to intelligently split Japanese text into sentences
-std::vector<std::string> PDFTranslator::splitJapaneseText(const std::string& text, size_t maxLength) {
-    std::vector<std::string> sentences;
-    std::string currentSentence;
+std::vector<std::string_view> PDFTranslator::splitJapaneseSpans(std::string_view text, size_t maxLength) {
+    std::vector<std::string_view> sentences;
+    size_t sentenceStart = 0;
+    size_t i = 0;
     bool inQuote = false;
 
-    for (size_t i = 0; i < text.size();) {
-        size_t charLength = getUtf8CharLength(static_cast<unsigned char>(text[i]));
-        if (i + charLength > text.size()) break; // Safety check
-
-        std::string currentChar = text.substr(i, charLength);
-        currentSentence += currentChar;
+    auto emitSentence = [&](size_t end) {
+        std::string_view sentence = text.substr(sentenceStart, end - sentenceStart);
+        if (sentence.size() > maxLength) {
+            splitLongSentenceSpans(sentence, maxLength, sentences);
+        } else {
+            sentences.push_back(sentence);
+        }
+        sentenceStart = end;
+    };
+
+    while (i < text.size()) {
+        unsigned char lead = static_cast<unsigned char>(text[i]);
+        if (lead < 0x80) {
+            // ASCII never ends a sentence or opens a quote, except for the
+            // newline between text blocks which always ends one
+            size_t run = asciiRunLength(text, i);
+            const void* newline = std::memchr(text.data() + i, '\n', run);
+            if (!newline) {
+                i += run;
+                continue;
+            }
 
-        // Handle opening and closing quotes
-        if (currentChar == "「") {
-            inQuote = true;
-        } else if (currentChar == "」") {
+            size_t newlinePos = static_cast<const char*>(newline) - text.data();
+            if (newlinePos > sentenceStart) {
+                emitSentence(newlinePos);
+            }
+            i = newlinePos + 1;
+            sentenceStart = i;
             inQuote = false;
+            continue;
         }
 
-        // Check for sentence-ending punctuation
-        if ((currentChar == "。" || currentChar == "！" || currentChar == "？") && !inQuote) {
-            if (currentSentence.size() > maxLength) {
-                auto splitChunks = splitLongSentences(currentSentence, maxLength);
-                sentences.insert(sentences.end(), splitChunks.begin(), splitChunks.end());
-            } else {
-                sentences.push_back(currentSentence);
+        size_t charLength = getUtf8CharLength(lead);
+        if (i + charLength > text.size()) break; // Safety check
+
+        bool endsSentence = false;
+        if (lead == kCjkPunctuationLead) {
+            if (startsWith(text, i, "「")) {
+                inQuote = true;
+            } else if (startsWith(text, i, "」")) {
+                inQuote = false;
+            } else if (startsWith(text, i, "。")) {
+                endsSentence = true;
             }
-            currentSentence.clear();
+        } else if (lead == kFullwidthFormsLead) {
+            endsSentence = startsWith(text, i, "！") || startsWith(text, i, "？");
         }
 
         i += charLength;
+        if (endsSentence && !inQuote) {
+            emitSentence(i);
+        }
     }
 
     // Add any remaining text as the last sentence
-    if (!currentSentence.empty()) {
-        if (currentSentence.size() > maxLength) {
-            auto splitChunks = splitLongSentences(currentSentence, maxLength);
-            sentences.insert(sentences.end(), splitChunks.begin(), splitChunks.end());
-        } else {
-            sentences.push_back(currentSentence);
-        }
+    if (i > sentenceStart) {
+        emitSentence(i);
     }
 
     return sentences;
 }
 
+std::vector<std::string> PDFTranslator::splitLongSentences(const std::string& sentence, size_t maxLength) {
+    std::vector<std::string_view> spans;
+    splitLongSentenceSpans(sentence, maxLength, spans);
+    return std::vector<std::string>(spans.begin(), spans.end());
+}
+
+// Function to intelligently split Japanese text into sentences
+std::vector<std::string> PDFTranslator::splitJapaneseText(const std::string& text, size_t maxLength) {
+    std::vector<std::string_view> spans = splitJapaneseSpans(text, maxLength);
+    return std::vector<std::string>(spans.begin(), spans.end());
+}
+
 std::vector<std::string> PDFTranslator::processAndSplitText(const std::string& inputFilePath, size_t maxLength) {
     
     std::filesystem::path inputPath = std::filesystem::u8path(inputFilePath);
@@ -623,53 +1136,184 @@ void PDFTranslator::convertPdfToImages(const std::string &pdfPath, const std::st
         return;
     }
 
+    std::filesystem::create_directory(outputFolder);
+
+    PageProcessingOptions options = imageOptions(outputFolder, stdDevThreshold);
+    options.extractText = false;
 
     fz_context* ctx = createMuPDFContext();
+    std::ostringstream unusedText;
+    try {
+        if (pageWindow > 0) {
+            // Rendered pages go straight to disk, only MuPDF's caches have to be released
+            const int pageCount = countPages(ctx, pdfPath);
+            for (int firstPage = 0; firstPage < pageCount; firstPage += pageWindow) {
+                processPDF(ctx, pdfPath, unusedText, options, nullptr, firstPage, std::min(firstPage + pageWindow, pageCount));
+                fz_empty_store(ctx);
+            }
+        } else {
+            processPDF(ctx, pdfPath, unusedText, options);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to convert PDF to images: " << e.what() << std::endl;
+    }
+    fz_drop_context(ctx);
+}
+
+void PDFTranslator::extractTextAndImagesFromPDF(const std::string& inputPath, const std::string& outputFilePath, const std::string& imagesDir, float stdDevThreshold) {
+    std::ofstream outputFile(outputFilePath, std::ios::out | std::ios::binary);
+    if (!outputFile) {
+        throw std::runtime_error("Failed to open output file: " + outputFilePath);
+    }
+
+    extractTextAndImagesFromPDF(inputPath, outputFile, imagesDir, stdDevThreshold);
+}
+
+void PDFTranslator::extractTextAndImagesFromPDF(const std::string& inputPath, std::ostream& outputText, const std::string& imagesDir, float stdDevThreshold) {
+    std::cout << "Extracting text and images from PDF..." << std::endl;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    std::filesystem::path pdfPath = std::filesystem::u8path(inputPath);
+
+    if (!std::filesystem::exists(pdfPath)) {
+        throw std::runtime_error("PDF file does not exist: " + pdfPath.string());
+    }
+
+    std::filesystem::create_directory(imagesDir);
 
-    fz_document* doc = fz_open_document(ctx, pdfPath.c_str());
-    if (!doc) {
-        std::cerr << "Failed to open PDF document: " << pdfPath << std::endl;
+    PageProcessingOptions options = imageOptions(imagesDir, stdDevThreshold);
+
+    fz_context* ctx = createMuPDFContext();
+    try {
+        processPDF(ctx, inputPath, outputText, options);
+    } catch (...) {
         fz_drop_context(ctx);
-        return;
+        throw;
     }
+    fz_drop_context(ctx);
 
-    std::filesystem::create_directory(outputFolder);
-    int pageCount = fz_count_pages(ctx, doc);
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = endTime - startTime;
+    std::cout << "Text and images extracted from PDF in " << duration.count() << " seconds." << std::endl;
+}
 
-    for (int pageNum = 0; pageNum < pageCount; pageNum++) {
-        fz_page* page = fz_load_page(ctx, doc, pageNum);
-        fz_rect bounds = fz_bound_page(ctx, page);
+void PDFTranslator::extractTextBlocksFromPDF(const std::string& inputPath, std::ostream& outputText, std::vector<PdfTextBlock>& textBlocks) {
+    PageProcessingOptions options;
+    options.extractText = true;
+    options.renderImages = false;
 
-        fz_pixmap* pixmap = fz_new_pixmap_from_page_number(ctx, doc, pageNum, fz_identity, fz_device_rgb(ctx), 1);
+    fz_context* ctx = createMuPDFContext();
+    try {
+        processPDF(ctx, inputPath, outputText, options, &textBlocks);
+    } catch (...) {
+        fz_drop_context(ctx);
+        throw;
+    }
+    fz_drop_context(ctx);
+}
 
-        if (!pixmap) {
-            std::cerr << "Failed to create pixmap for page " << pageNum << std::endl;
-            fz_drop_page(ctx, page);
-            continue;
-        }
-        
+double PDFTranslator::grayscaleStdDev(const unsigned char* samples, int width, int height, int components, ptrdiff_t stride, double* meanOut) {
+    if (meanOut) {
+        *meanOut = 0.0;
+    }
+    if (!samples || width <= 0 || height <= 0 || components <= 0) {
+        return 0.0;
+    }
 
-        // Save the image temporarily
-        char tempPath[1024];
-        snprintf(tempPath, sizeof(tempPath), "%s/temp_page_%03d.png", outputFolder.c_str(), pageNum + 1);
-        fz_save_pixmap_as_png(ctx, pixmap, tempPath);
+    // Rows are summed in 32-bit integers, which the compiler vectorises, in
+    // chunks small enough that the sum of squares (at most 255^2 per pixel)
+    // cannot overflow
+    const int chunk = 16384;
+    uint64_t sum = 0;
+    uint64_t sqSum = 0;
+
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = samples + y * stride;
+
+        for (int x0 = 0; x0 < width; x0 += chunk) {
+            int x1 = std::min(width, x0 + chunk);
+            uint32_t rowSum = 0;
+            uint32_t rowSqSum = 0;
+
+            if (components >= 3) {
+                // Same luma weights stbi_load uses when converting to grayscale
+                for (int x = x0; x < x1; ++x) {
+                    const unsigned char* pixel = row + x * components;
+                    uint32_t gray = (pixel[0] * 77u + pixel[1] * 150u + pixel[2] * 29u) >> 8;
+                    rowSum += gray;
+                    rowSqSum += gray * gray;
+                }
+            } else {
+                for (int x = x0; x < x1; ++x) {
+                    uint32_t gray = row[x * components];
+                    rowSum += gray;
+                    rowSqSum += gray * gray;
+                }
+            }
 
-        // Check if the image passes the threshold
-        if (isImageAboveThreshold(tempPath, stdDevThreshold)) {
-            char outputPath[1024];
-            snprintf(outputPath, sizeof(outputPath), "%s/page_%03d.png", outputFolder.c_str(), pageNum + 1);
-            std::filesystem::rename(tempPath, outputPath); // Save with final name
-            std::cout << "Saved: " << outputPath << std::endl;
-        } else {
-            std::filesystem::remove(tempPath); // Delete temporary image
+            sum += rowSum;
+            sqSum += rowSqSum;
         }
+    }
+
+    double numPixels = static_cast<double>(width) * height;
+    double mean = sum / numPixels;
+    if (meanOut) {
+        *meanOut = mean;
+    }
+    double variance = (sqSum / numPixels) - (mean * mean);
+    return variance > 0.0 ? std::sqrt(variance) : 0.0;
+}
 
-        fz_drop_pixmap(ctx, pixmap);
-        fz_drop_page(ctx, page);
+bool PDFTranslator::isPageImageCandidate(fz_context* ctx, fz_display_list* list, float threshold) {
+    fz_rect bounds = fz_bound_display_list(ctx, list);
+    float pageWidth = bounds.x1 - bounds.x0;
+    if (threshold <= 0.0f || pageWidth <= thumbnailWidth) {
+        return true;
     }
 
-    fz_drop_document(ctx, doc);
-    fz_drop_context(ctx);
+    float scale = thumbnailWidth / pageWidth;
+    fz_pixmap* thumbnail = fz_new_pixmap_from_display_list(ctx, list, fz_scale(scale, scale), fz_device_rgb(ctx), 1);
+    if (!thumbnail) {
+        return true;
+    }
+
+    // Downscaling averages fine detail like text or screentone into flat gray,
+    // so the thumbnail's own deviation says little about the full render. Its
+    // mean survives the downscale, and gray levels in [0, 255] with mean m can
+    // never deviate by more than sqrt(m * (255 - m)). A page is only ruled out
+    // when that bound, anywhere within the tolerance of the thumbnail mean,
+    // stays at or below the threshold the full render would be held to.
+    double mean = 0.0;
+    grayscaleStdDev(
+        fz_pixmap_samples(ctx, thumbnail),
+        fz_pixmap_width(ctx, thumbnail),
+        fz_pixmap_height(ctx, thumbnail),
+        fz_pixmap_components(ctx, thumbnail),
+        fz_pixmap_stride(ctx, thumbnail),
+        &mean
+    );
+    fz_drop_pixmap(ctx, thumbnail);
+
+    double low = std::max(0.0, mean - thumbnailMeanTolerance);
+    double high = std::min(255.0, mean + thumbnailMeanTolerance);
+    double closestToMid = std::clamp(127.5, low, high);
+    double maxVariance = closestToMid * (255.0 - closestToMid);
+    return maxVariance > static_cast<double>(threshold) * threshold;
+}
+
+bool PDFTranslator::isPixmapAboveThreshold(fz_context* ctx, fz_pixmap* pixmap, float threshold) {
+    double stddev = grayscaleStdDev(
+        fz_pixmap_samples(ctx, pixmap),
+        fz_pixmap_width(ctx, pixmap),
+        fz_pixmap_height(ctx, pixmap),
+        fz_pixmap_components(ctx, pixmap),
+        fz_pixmap_stride(ctx, pixmap)
+    );
+
+    std::cout << "Page pixmap - Standard Deviation: " << stddev << std::endl;
+    return stddev > threshold;
 }
 
 bool PDFTranslator::isImageAboveThreshold(const std::string &imagePath, float threshold) {
@@ -680,19 +1324,7 @@ bool PDFTranslator::isImageAboveThreshold(const std::string &imagePath, float th
         return false;
     }
 
-    // Calculate mean and standard deviation
-    double sum = 0.0, sqSum = 0.0;
-    int numPixels = width * height;
-
-    for (int i = 0; i < numPixels; ++i) {
-        double pixel = data[i];
-        sum += pixel;
-        sqSum += pixel * pixel;
-    }
-
-    double mean = sum / numPixels;
-    double variance = (sqSum / numPixels) - (mean * mean);
-    double stddev = std::sqrt(variance);
+    double stddev = grayscaleStdDev(data, width, height, 1, width);
 
     std::cout << "Image: " << imagePath << " - Standard Deviation: " << stddev << std::endl;
 
@@ -730,7 +1362,10 @@ std::vector<std::string> PDFTranslator::collectImageFiles(const std::string &ima
         }
     }
 
-    std::sort(image_files.begin(), image_files.end());
+    // Shorter names first keeps page_1000 after page_999
+    std::sort(image_files.begin(), image_files.end(), [](const std::string& a, const std::string& b) {
+        return a.size() != b.size() ? a.size() < b.size() : a < b;
+    });
     return image_files;
 }
 
@@ -740,12 +1375,77 @@ bool PDFTranslator::isImageFile(const std::string &extension) {
 }
 
 
+cairo_surface_t* PDFTranslator::loadImageSurface(const std::string& imagePath) {
+    std::string ext = std::filesystem::path(imagePath).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext == ".png") {
+        return cairo_image_surface_create_from_png(imagePath.c_str());
+    }
+
+    // cairo only decodes PNG itself, anything else goes through stb into an RGB24 surface
+    int width, height, channels;
+    unsigned char* data = stbi_load(imagePath.c_str(), &width, &height, &channels, 3);
+    if (!data) {
+        return cairo_image_surface_create(CAIRO_FORMAT_INVALID, 0, 0);
+    }
+
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+    if (cairo_surface_status(surface) == CAIRO_STATUS_SUCCESS) {
+        cairo_surface_flush(surface);
+        unsigned char* pixels = cairo_image_surface_get_data(surface);
+        int stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, width);
+        for (int y = 0; y < height; ++y) {
+            uint32_t* row = reinterpret_cast<uint32_t*>(pixels + y * stride);
+            const unsigned char* src = data + static_cast<size_t>(y) * width * 3;
+            for (int x = 0; x < width; ++x) {
+                row[x] = (uint32_t(src[x * 3]) << 16) | (uint32_t(src[x * 3 + 1]) << 8) | src[x * 3 + 2];
+            }
+        }
+        cairo_surface_mark_dirty(surface);
+    }
+    // Flushing or marking the surface dirty detaches its mime data, so the
+    // JPEG bytes go on last, once the pixels are final
+    if (cairo_surface_status(surface) == CAIRO_STATUS_SUCCESS && (ext == ".jpg" || ext == ".jpeg")) {
+        attachJpegData(surface, imagePath);
+    }
+
+    stbi_image_free(data);
+    return surface;
+}
+
+bool PDFTranslator::attachJpegData(cairo_surface_t* surface, const std::string& imagePath) {
+    std::ifstream file(std::filesystem::u8path(imagePath), std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::streamsize size = file.tellg();
+    if (size <= 0) {
+        return false;
+    }
+    file.seekg(0);
+
+    // cairo owns the copy from here and frees it with the surface
+    unsigned char* data = static_cast<unsigned char*>(malloc(static_cast<size_t>(size)));
+    if (!data || !file.read(reinterpret_cast<char*>(data), size)) {
+        free(data);
+        return false;
+    }
+
+    // The PDF surface embeds these bytes as a DCTDecode stream instead of
+    // compressing the decoded pixels again
+    cairo_status_t status = cairo_surface_set_mime_data(surface, CAIRO_MIME_TYPE_JPEG, data, static_cast<unsigned long>(size), free, data);
+    if (status != CAIRO_STATUS_SUCCESS) {
+        free(data);
+        return false;
+    }
+    return true;
+}
+
 bool PDFTranslator::addImagesToPdf(cairo_t *cr, cairo_surface_t *surface, const std::vector<std::string> &image_files) {
     bool has_images = false;
     
     for (const auto &image_file : image_files) {
-        // Try loading the image as PNG (change logic if you want to handle JPG, etc. differently)
-        cairo_surface_t *image = cairo_image_surface_create_from_png(image_file.c_str());
+        cairo_surface_t *image = loadImageSurface(image_file);
         if (cairo_surface_status(image) != CAIRO_STATUS_SUCCESS) {
             std::cerr << "Failed to load image: " << image_file << std::endl;
             cairo_surface_destroy(image);
@@ -780,17 +1480,13 @@ void PDFTranslator::configureTextRendering(cairo_t *cr, const std::string &font_
     cairo_set_font_size(cr, font_size);
 }
 
-void PDFTranslator::addTextToPdf(cairo_t* cr, cairo_surface_t* surface, const std::string &input_file, double page_width, double page_height, double margin, double line_spacing, double font_size) {
+bool PDFTranslator::readNumberedLines(const std::string& input_file, std::vector<std::string>& texts) {
     std::ifstream infile(input_file);
     if (!infile.is_open()) {
         std::cerr << "Error: Could not open file " << input_file << std::endl;
-        return;
+        return false;
     }
 
-    double x = margin;
-    double y = margin;
-    double usable_width = page_width - 2 * margin;
-
     std::string line;
     while (std::getline(infile, line)) {
         size_t comma_pos = line.find(',');
@@ -800,52 +1496,56 @@ void PDFTranslator::addTextToPdf(cairo_t* cr, cairo_surface_t* surface, const st
         }
 
         // Extract text after the comma
-        std::string text = line.substr(comma_pos + 1);
+        texts.push_back(line.substr(comma_pos + 1));
+    }
+    return true;
+}
 
-        // Word wrapping
-        std::istringstream text_stream(text);
-        std::string word;
-        std::string current_line;
+TextLayout PDFTranslator::reflowLayout(FontManager& fonts, cairo_t* cr) {
+    // Words are measured once, line widths are sums of the cached advances.
+    // The bundled fonts are drawn as glyph runs, the font configured on cr is
+    // only used when none of them could be loaded
+    cairo_scaled_font_t* scaled_font = cairo_get_scaled_font(cr);
+    return TextLayout([&fonts, scaled_font](const std::string& token) {
+        if (fonts.hasFonts()) {
+            return fonts.advance(token);
+        }
         cairo_text_extents_t extents;
+        cairo_scaled_font_text_extents(scaled_font, token.c_str(), &extents);
+        return extents.x_advance;
+    });
+}
 
-        while (text_stream >> word) {
-            // Test if adding this word exceeds usable width
-            std::string test_line = current_line.empty() ? word : (current_line + " " + word);
-            cairo_text_extents(cr, test_line.c_str(), &extents);
-
-            if (extents.width > usable_width) {
-                // Render the current line
-                cairo_move_to(cr, x, y);
-                cairo_show_text(cr, current_line.c_str());
-                y += font_size * line_spacing;
+double PDFTranslator::addTextToPdf(cairo_t* cr, cairo_surface_t* surface, FontManager& fonts, TextLayout& layout, const std::vector<std::string> &texts, double page_width, double page_height, double margin, double line_spacing, double font_size, double y) {
+    double x = margin;
+    double usable_width = page_width - 2 * margin;
 
-                // New page if we exceed the page limit
-                if (y > page_height - margin) {
-                    cairo_show_page(cr);
-                    y = margin;
-                }
+    std::vector<std::string_view> lines;
+    std::string line_text;
+    for (const std::string& text : texts) {
+        lines.clear();
+        layout.breakLines(text, usable_width, lines);
 
-                // Start a new line with the current word
-                current_line = word;
+        for (std::string_view line : lines) {
+            if (fonts.hasFonts()) {
+                fonts.showText(cr, x, y, line);
             } else {
-                // Keep adding to the current line
-                current_line = test_line;
+                // cairo needs a terminated string, the buffer is reused for every line
+                line_text.assign(line.data(), line.size());
+                cairo_move_to(cr, x, y);
+                cairo_show_text(cr, line_text.c_str());
             }
-        }
-
-        // Render remaining text in the current line
-        if (!current_line.empty()) {
-            cairo_move_to(cr, x, y);
-            cairo_show_text(cr, current_line.c_str());
             y += font_size * line_spacing;
 
-            // Check for page overflow
+            // New page if we exceed the page limit
             if (y > page_height - margin) {
                 cairo_show_page(cr);
                 y = margin;
             }
         }
     }
+
+    return y;
 }
 
 void PDFTranslator::createPDF(const std::string &output_file, const std::string &input_file, const std::string &images_dir) {
@@ -856,13 +1556,21 @@ void PDFTranslator::createPDF(const std::string &output_file, const std::string
         std::cerr << "Input file does not exist: " << inputPath.string() << std::endl;
         return;
     }
-    
-    
-    const double page_width = 612.0;
-    const double page_height = 792.0;
-    const double margin = 72.0;
-    const double line_spacing = 2.0;
-    const double font_size = 12.0;
+
+    std::vector<std::string> texts;
+    if (!readNumberedLines(input_file, texts)) {
+        return;
+    }
+
+    createPDF(output_file, texts, images_dir);
+}
+
+void PDFTranslator::createPDF(const std::string &output_file, const std::vector<std::string> &texts, const std::string &images_dir) {
+    const double page_width = reflowPageWidth;
+    const double page_height = reflowPageHeight;
+    const double margin = reflowMargin;
+    const double line_spacing = reflowLineSpacing;
+    const double font_size = reflowFontSize;
     const std::string font_family = "Helvetica";
 
     // Initialize Cairo PDF surface
@@ -879,7 +1587,9 @@ void PDFTranslator::createPDF(const std::string &output_file, const std::string
 
     // Configure text rendering and add text
     configureTextRendering(cr, font_family, font_size);
-    addTextToPdf(cr, surface, input_file, page_width, page_height, margin, line_spacing, font_size);
+    FontManager fonts(fontsDirectory, font_size);
+    TextLayout layout = reflowLayout(fonts, cr);
+    addTextToPdf(cr, surface, fonts, layout, texts, page_width, page_height, margin, line_spacing, font_size, margin);
 
     // Cleanup
     cleanupCairo(cr, surface);
@@ -887,6 +1597,241 @@ void PDFTranslator::createPDF(const std::string &output_file, const std::string
     std::cout << "PDF created with images first: " << output_file << std::endl;
 }
 
+double PDFTranslator::fontAdvance(fz_context* ctx, fz_font* font, const std::string& text) {
+    double width = 0.0;
+    const char* p = text.c_str();
+    while (*p) {
+        int rune = 0;
+        p += fz_chartorune(&rune, p);
+        width += fz_advance_glyph(ctx, font, fz_encode_character(ctx, font, rune), 0);
+    }
+    return width;
+}
+
+void PDFTranslator::drawFittedText(fz_context* ctx, fz_device* dev, fz_font* font, TextLayout& layout, const fz_rect& box, const std::string& text) {
+    const double boxWidth = box.x1 - box.x0;
+    const double boxHeight = box.y1 - box.y0;
+    if (boxWidth <= 0 || boxHeight <= 0) {
+        return;
+    }
+
+    // Shrink from the largest size a single line allows until the wrapped
+    // text fits the box, the layout measures at size 1 so its cache is shared
+    double fontSize = std::min<double>(layoutMaxFontSize, boxHeight / layoutLineHeight);
+    std::vector<std::string_view> lines;
+    for (;;) {
+        fontSize = std::max<double>(fontSize, layoutMinFontSize);
+        lines.clear();
+        layout.breakLines(text, boxWidth / fontSize, lines);
+        if (lines.size() * fontSize * layoutLineHeight <= boxHeight || fontSize <= layoutMinFontSize) {
+            break;
+        }
+        fontSize *= 0.9;
+    }
+
+    // Nothing with a destructor may live inside fz_try, a throw longjmps past it
+    std::string lineText;
+    fz_text* fzText = nullptr;
+    fz_var(fzText);
+    fz_try(ctx) {
+        fzText = fz_new_text(ctx);
+        for (size_t i = 0; i < lines.size(); ++i) {
+            // Page space has y pointing down, glyph space has it pointing up
+            fz_matrix trm = fz_scale(fontSize, -fontSize);
+            trm.e = box.x0;
+            trm.f = box.y0 + fontSize * (layoutAscent + i * layoutLineHeight);
+            lineText.assign(lines[i].data(), lines[i].size());
+            fz_show_string(ctx, fzText, font, trm, lineText.c_str(), 0, 0, FZ_BIDI_LTR, FZ_LANG_UNSET);
+        }
+        const float black[1] = { 0.0f };
+        fz_fill_text(ctx, dev, fzText, fz_identity, fz_device_gray(ctx), black, 1.0f, fz_default_color_params);
+    } fz_always(ctx) {
+        fz_drop_text(ctx, fzText);
+    } fz_catch(ctx) {
+        std::cerr << "Failed to draw translated text block." << std::endl;
+    }
+}
+
+void PDFTranslator::overlayPageTranslations(fz_context* ctx, pdf_document* doc, fz_font* font, TextLayout& layout, const PdfTextBlock* blocks, const std::string* translations, size_t count) {
+    int pageIndex = blocks[0].pageIndex;
+    pdf_page* page = nullptr;
+    fz_buffer* prefixBuffer = nullptr;
+    fz_buffer* contents = nullptr;
+    fz_device* dev = nullptr;
+    pdf_obj* prefix = nullptr;
+    pdf_obj* overlay = nullptr;
+    fz_var(page);
+    fz_var(prefixBuffer);
+    fz_var(contents);
+    fz_var(dev);
+    fz_var(prefix);
+    fz_var(overlay);
+
+    fz_try(ctx) {
+        page = pdf_load_page(ctx, doc, pageIndex);
+
+        // Redaction removes the source glyphs inside each block but leaves
+        // images and line art where they are
+        bool hasTranslation = false;
+        for (size_t i = 0; i < count; ++i) {
+            if (translations[i].empty()) {
+                continue;
+            }
+            pdf_annot* annot = pdf_create_annot(ctx, page, PDF_ANNOT_REDACT);
+            pdf_set_annot_rect(ctx, annot, blocks[i].bbox);
+            pdf_drop_annot(ctx, annot);
+            hasTranslation = true;
+        }
+
+        if (hasTranslation) {
+            pdf_redact_options redactOptions = { 0 };
+            redactOptions.black_boxes = 0;
+            redactOptions.image_method = PDF_REDACT_IMAGE_NONE;
+            pdf_redact_page(ctx, doc, page, &redactOptions);
+
+            fz_rect mediabox;
+            fz_matrix pageCtm;
+            pdf_page_transform(ctx, page, &mediabox, &pageCtm);
+
+            pdf_obj* resources = pdf_dict_get_inheritable(ctx, page->obj, PDF_NAME(Resources));
+            if (!resources) {
+                resources = pdf_dict_put_dict(ctx, page->obj, PDF_NAME(Resources), 2);
+            }
+
+            // The original content is wrapped in q/Q so whatever graphics
+            // state it leaves behind does not apply to the translations
+            prefixBuffer = fz_new_buffer(ctx, 2);
+            fz_append_string(ctx, prefixBuffer, "q\n");
+            prefix = pdf_add_stream(ctx, doc, prefixBuffer, nullptr, 0);
+
+            contents = fz_new_buffer(ctx, 1024);
+            fz_append_string(ctx, contents, "Q\n");
+            dev = pdf_new_pdf_device(ctx, doc, fz_invert_matrix(pageCtm), resources, contents);
+            for (size_t i = 0; i < count; ++i) {
+                if (!translations[i].empty()) {
+                    drawFittedText(ctx, dev, font, layout, blocks[i].bbox, translations[i]);
+                }
+            }
+            fz_close_device(ctx, dev);
+            overlay = pdf_add_stream(ctx, doc, contents, nullptr, 0);
+
+            pdf_obj* existing = pdf_dict_get(ctx, page->obj, PDF_NAME(Contents));
+            pdf_obj* streams = pdf_new_array(ctx, doc, 3);
+            pdf_array_push(ctx, streams, prefix);
+            if (pdf_is_array(ctx, existing)) {
+                for (int i = 0; i < pdf_array_len(ctx, existing); ++i) {
+                    pdf_array_push(ctx, streams, pdf_array_get(ctx, existing, i));
+                }
+            } else if (existing) {
+                pdf_array_push(ctx, streams, existing);
+            }
+            pdf_array_push(ctx, streams, overlay);
+            pdf_dict_put_drop(ctx, page->obj, PDF_NAME(Contents), streams);
+        }
+    } fz_always(ctx) {
+        pdf_drop_obj(ctx, overlay);
+        pdf_drop_obj(ctx, prefix);
+        fz_drop_device(ctx, dev);
+        fz_drop_buffer(ctx, contents);
+        fz_drop_buffer(ctx, prefixBuffer);
+        pdf_drop_page(ctx, page);
+    } fz_catch(ctx) {
+        std::cerr << "Failed to place translations on page " << pageIndex + 1 << std::endl;
+    }
+}
+
+fz_font* PDFTranslator::loadLayoutFont(fz_context* ctx) const {
+    std::error_code ec;
+    std::vector<std::filesystem::path> fontFiles;
+    for (const auto& entry : std::filesystem::directory_iterator(fontsDirectory, ec)) {
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if (entry.is_regular_file() && (ext == ".ttf" || ext == ".otf" || ext == ".ttc")) {
+            fontFiles.push_back(entry.path());
+        }
+    }
+
+    // Same primary font FontManager picks for the reflowed output
+    std::sort(fontFiles.begin(), fontFiles.end());
+    for (const auto& fontFile : fontFiles) {
+        const std::string fontPath = fontFile.string();
+        fz_font* font = nullptr;
+        fz_var(font);
+        fz_try(ctx) {
+            font = fz_new_font_from_file(ctx, nullptr, fontPath.c_str(), 0, 0);
+        } fz_catch(ctx) {
+            std::cerr << "Failed to load font: " << fontPath << std::endl;
+        }
+        if (font) {
+            return font;
+        }
+    }
+
+    std::cerr << "No usable font in " << fontsDirectory.string() << ", translations are set in Helvetica." << std::endl;
+    return fz_new_base14_font(ctx, "Helvetica");
+}
+
+bool PDFTranslator::createLayoutPreservingPDF(const std::string& inputPath, const std::string& outputPath, const std::vector<PdfTextBlock>& textBlocks, const std::vector<std::string>& translations) {
+    if (textBlocks.size() != translations.size()) {
+        std::cerr << "Expected one translation per text block." << std::endl;
+        return false;
+    }
+
+    fz_context* ctx = createMuPDFContext();
+    pdf_document* doc = nullptr;
+    fz_font* font = nullptr;
+    bool saved = false;
+    fz_var(doc);
+    fz_var(font);
+
+    // Built outside fz_try so a throw cannot longjmp past its destructor.
+    // Advances are measured at size 1 and scaled per block, font is only
+    // read once it has been loaded below.
+    TextLayout layout([ctx, &font](const std::string& token) {
+        return fontAdvance(ctx, font, token);
+    });
+
+    fz_try(ctx) {
+        doc = pdf_open_document(ctx, inputPath.c_str());
+        font = loadLayoutFont(ctx);
+
+        // Blocks arrive in page order, every page is loaded and rewritten once
+        size_t first = 0;
+        while (first < textBlocks.size()) {
+            size_t last = first;
+            while (last < textBlocks.size() && textBlocks[last].pageIndex == textBlocks[first].pageIndex) {
+                ++last;
+            }
+            overlayPageTranslations(ctx, doc, font, layout, &textBlocks[first], &translations[first], last - first);
+            first = last;
+        }
+
+        // The bundled font is embedded whole, only the glyphs that were drawn are kept
+        fz_try(ctx) {
+            pdf_subset_fonts(ctx, doc, 0, nullptr);
+        } fz_catch(ctx) {
+            std::cerr << "Failed to subset fonts, they are embedded whole." << std::endl;
+        }
+
+        pdf_write_options writeOptions = pdf_default_write_options;
+        writeOptions.do_garbage = 1;
+        writeOptions.do_compress = 1;
+        pdf_save_document(ctx, doc, outputPath.c_str(), &writeOptions);
+        saved = true;
+    } fz_always(ctx) {
+        fz_drop_font(ctx, font);
+        pdf_drop_document(ctx, doc);
+    } fz_catch(ctx) {
+        std::cerr << "Failed to write layout preserving PDF: " << outputPath << std::endl;
+    }
+    fz_drop_context(ctx);
+
+    if (saved) {
+        std::cout << "PDF created with the original layout: " << outputPath << std::endl;
+    }
+    return saved;
+}
+
 size_t PDFTranslator::writeCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
     size_t totalSize = size * nmemb;
     output->append((char*)contents, totalSize);
@@ -902,52 +1847,17 @@ std::string PDFTranslator::uploadDocumentToDeepL(const std::string& filePath, co
         std::cerr << "File does not exist: " << inputPath.string() << std::endl;
         return "";
     }
-    
-    CURL* curl;
-    CURLcode res;
-    std::string response_string;
-    std::string api_url = "https://api-free.deepl.com/v2/document";
-    std::string auth_key = "DeepL-Auth-Key " + deepLKey;
-
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl = curl_easy_init();
-
-    if (curl) {
-        struct curl_slist* headers = nullptr;
-        headers = curl_slist_append(headers, ("Authorization: " + auth_key).c_str());
-
-        // Prepare the multipart form data
-        curl_mime* form = curl_mime_init(curl);
-        curl_mimepart* field = curl_mime_addpart(form);
-        curl_mime_name(field, "target_lang");
-        curl_mime_data(field, "EN", CURL_ZERO_TERMINATED); // Change to desired target language
-        field = curl_mime_addpart(form);
-        curl_mime_name(field, "file");
-        curl_mime_filedata(field, filePath.c_str());  // Path to the file you want to upload
-
-        curl_easy_setopt(curl, CURLOPT_URL, api_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_MIMEPOST, form);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
-
-        // Perform the request
-        res = curl_easy_perform(curl);
 
-        if (res != CURLE_OK) {
-            std::cerr << "Curl upload request failed: " << curl_easy_strerror(res) << std::endl;
-        }
+    DeepLResponse response = DeepLClient::shared().uploadDocument(deepLApiUrl, deepLKey, filePath, "EN", deepLPollSettings.transferLimits()).get();
 
-        curl_mime_free(form);
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
+    if (response.curlCode != CURLE_OK) {
+        std::cerr << "Curl upload request failed: " << response.error << std::endl;
     }
-    curl_global_cleanup();
 
     // Extract document_id and document_key from the response
     try {
-        std::cout << "Document upload response: " << response_string << std::endl;
-        nlohmann::json jsonResponse = nlohmann::json::parse(response_string);
+        std::cout << "Document upload response: " << response.body << std::endl;
+        nlohmann::json jsonResponse = nlohmann::json::parse(response.body);
         std::string document_id = jsonResponse["document_id"];
         std::string document_key = jsonResponse["document_key"];
         return document_id + "|" + document_key;
@@ -957,93 +1867,38 @@ std::string PDFTranslator::uploadDocumentToDeepL(const std::string& filePath, co
     }
 }
 
-std::string PDFTranslator::checkDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey) {
-    CURL* curl;
-    CURLcode res;
-    std::string response_string;
-    std::string api_url = "https://api-free.deepl.com/v2/document/" + document_id;
-    std::string auth_key = "DeepL-Auth-Key " + deepLKey;
-
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl = curl_easy_init();
-
-    if (curl) {
-        struct curl_slist* headers = nullptr;
-        headers = curl_slist_append(headers, ("Authorization: " + auth_key).c_str());
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-
-        // Create JSON payload
-        nlohmann::json jsonPayload;
-        jsonPayload["document_key"] = document_key;
-        std::string json_data = jsonPayload.dump();
-
-        curl_easy_setopt(curl, CURLOPT_URL, api_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_POST, 1);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
-
-        // Perform the request
-        res = curl_easy_perform(curl);
-
-        if (res != CURLE_OK) {
-            std::cerr << "Curl status check request failed: " << curl_easy_strerror(res) << std::endl;
-        }
+std::future<DeepLResponse> PDFTranslator::requestDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey) {
+    nlohmann::json jsonPayload;
+    jsonPayload["document_key"] = document_key;
+    return DeepLClient::shared().postJson(deepLApiUrl + "/" + document_id, deepLKey, jsonPayload.dump(), deepLPollSettings.transferLimits());
+}
 
-        std::cout << "Document status response: " << response_string << std::endl;
+std::string PDFTranslator::checkDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey) {
+    DeepLResponse response = requestDocumentStatus(document_id, document_key, deepLKey).get();
 
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
+    if (response.curlCode != CURLE_OK) {
+        std::cerr << "Curl status check request failed: " << response.error << std::endl;
     }
-    curl_global_cleanup();
 
-    return response_string;  // You can parse this response to check if status == "done"
+    std::cout << "Document status response: " << response.body << std::endl;
+
+    return response.body;  // You can parse this response to check if status == "done"
 }
 
 std::string PDFTranslator::downloadTranslatedDocument(const std::string& document_id, const std::string& document_key, const std::string& deepLKey) {
-    CURL* curl;
-    CURLcode res;
-    std::string response_string;
-    std::string api_url = "https://api-free.deepl.com/v2/document/" + document_id + "/result";
-    std::string auth_key = "DeepL-Auth-Key " + deepLKey;
-
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl = curl_easy_init();
-
-    if (curl) {
-        struct curl_slist* headers = nullptr;
-        headers = curl_slist_append(headers, ("Authorization: " + auth_key).c_str());
-        headers = curl_slist_append(headers, "Content-Type: application/json");
-
-        // Create JSON payload
-        nlohmann::json jsonPayload;
-        jsonPayload["document_key"] = document_key;
-        std::string json_data = jsonPayload.dump();
-
-        curl_easy_setopt(curl, CURLOPT_URL, api_url.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_POST, 1);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_data.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response_string);
+    nlohmann::json jsonPayload;
+    jsonPayload["document_key"] = document_key;
 
-        // Perform the request
-        res = curl_easy_perform(curl);
+    DeepLResponse response = DeepLClient::shared().postJson(deepLApiUrl + "/" + document_id + "/result", deepLKey, jsonPayload.dump(), deepLPollSettings.transferLimits()).get();
 
-        if (res != CURLE_OK) {
-            std::cerr << "Curl download request failed: " << curl_easy_strerror(res) << std::endl;
-        }
-
-        curl_easy_cleanup(curl);
-        curl_slist_free_all(headers);
+    if (response.curlCode != CURLE_OK) {
+        std::cerr << "Curl download request failed: " << response.error << std::endl;
     }
-    curl_global_cleanup();
 
-    return response_string;
+    return response.body;
 }
 
-int PDFTranslator::handleDeepLRequest(const std::string& inputPath, const std::string& outputPath, const std::string& deepLKey) {
+int PDFTranslator::handleDeepLRequest(const std::string& inputPath, std::string& translatedText, const std::string& deepLKey) {
     // Check if the input file exists
     std::filesystem::path inputPDFPath = std::filesystem::u8path(inputPath);
 
@@ -1066,19 +1921,14 @@ int PDFTranslator::handleDeepLRequest(const std::string& inputPath, const std::s
     std::string document_key = document_info.substr(separator_pos + 1);
 
 
-    std::string status;
-    bool isTranslationComplete = false;
+    DeepLPollPolicy pollPolicy(deepLPollSettings);
+    bool isTranslationComplete = pollPolicy.waitUntilDone([&]() {
+        return requestDocumentStatus(document_id, document_key, deepLKey).get();
+    });
 
-    while (!isTranslationComplete) {
-        status = checkDocumentStatus(document_id, document_key, deepLKey);
-        // Parse the JSON response to check if status == "done"
-        nlohmann::json jsonResponse = nlohmann::json::parse(status);
-        if (jsonResponse["status"] == "done") {
-            isTranslationComplete = true;
-        } else {
-            std::cout << "Translation in progress..." << "\n";
-            std::this_thread::sleep_for(std::chrono::seconds(5));  // Wait for 5 seconds before checking again
-        }
+    if (!isTranslationComplete) {
+        std::cerr << "DeepL did not finish translating the document." << std::endl;
+        return 1;
     }
 
     // Download the translated document
@@ -1088,15 +1938,7 @@ int PDFTranslator::handleDeepLRequest(const std::string& inputPath, const std::s
         return 1;
     }
 
-    // Save the translated document to the output path
-    std::ofstream output_file(outputPath);
-    if (!output_file.is_open()) {
-        std::cerr << "Failed to open output file: " << outputPath << std::endl;
-        return 1;
-    }
-
-    output_file << download_response;
-    output_file.close();
+    translatedText = std::move(download_response);
 
     return 0;
 }
\ No newline at end of file
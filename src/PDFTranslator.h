@@ -7,6 +7,7 @@
 #include <regex>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <boost/process.hpp>
 #include <boost/filesystem.hpp>
@@ -14,12 +15,24 @@
 #include <iostream>
 #include <codecvt>
 #include <locale>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <thread>
 #include "mupdf/fitz.h"
 #include "mupdf/pdf.h"
 #include <chrono>
 #include <cairo.h>
 #include <cairo-pdf.h>
 #include "Translator.h"
+#include "DeepLClient.h"
+#include "DeepLPollPolicy.h"
+#include "LocalTranslationWorker.h"
+#include "TextLayout.h"
+#include "FontManager.h"
 #include <nlohmann/json.hpp>
 #include <curl/curl.h>
 
@@ -28,11 +41,62 @@
 #endif
 
 
+// Auto picks JPEG for pages with many distinct colours (photos, painted
+// illustrations) and PNG for line art and text
+enum class PageImageFormat {
+    Png,
+    Jpeg,
+    Auto
+};
+
+// What processPDF does with each page. Rendering goes through a display list
+// so text extraction and image detection share one interpretation of the page.
+struct PageProcessingOptions {
+    bool extractText = true;
+    bool renderImages = false;
+    std::string imagesDir;
+    float stdDevThreshold = 50.0f;
+    PageImageFormat imageFormat = PageImageFormat::Png;
+    // -1 keeps MuPDF's own PNG writer, 0-9 encodes with stb at that level
+    int pngCompressionLevel = -1;
+    int jpegQuality = 90;
+};
+
+// A text block of the source PDF as found by the structured text device, the
+// bbox is in MuPDF page coordinates
+struct PdfTextBlock {
+    int pageIndex;
+    fz_rect bbox;
+    std::string text;
+};
+
+// Reflow: the kept page images followed by the translated text (default)
+// PreserveLayout: the original pages with each text block replaced by its translation
+enum class PdfOutputMode {
+    Reflow,
+    PreserveLayout
+};
+
 class PDFTranslator : public Translator {
 public:
     int run(const std::string& inputPath, const std::string& outputPath, int localModel, const std::string& deepLKey, std::string langcode);
     static size_t writeCallback(void* contents, size_t size, size_t nmemb, std::string* output);
 
+    // Threads used for text extraction and page rendering, 0 uses one per core
+    void setExtractionThreads(size_t threads);
+    void setPageImageOutput(PageImageFormat format, int pngCompressionLevel = -1, int jpegQuality = 90);
+    // Debugging aid, keeps the job directory with the extracted text, sentences and translations
+    void setKeepIntermediateFiles(bool keep);
+    // Process used when localModel is not DeepL, started in streaming mode
+    void setLocalTranslationCommand(const std::filesystem::path& executable, const std::vector<std::string>& arguments);
+    void setPdfOutputMode(PdfOutputMode mode);
+    // Fonts used for the reflowed text, Helvetica is used when none can be loaded
+    void setFontsDirectory(const std::filesystem::path& directory);
+    // Reflowed output is produced pagesPerWindow source pages at a time (extract,
+    // translate, render) and MuPDF's caches are emptied between windows, 0 handles
+    // the whole document at once. memoryBudget caps MuPDF's resource store in
+    // bytes, 0 keeps MuPDF's default.
+    void setPageWindow(int pagesPerWindow, size_t memoryBudget = 0);
 
 protected:
     std::string removeWhitespace(const std::string& input);
@@ -40,26 +104,111 @@ protected:
     std::vector<std::string> processAndSplitText(const std::string& inputFilePath, size_t maxLength);
     std::vector<std::string> splitLongSentences(const std::string& sentence, size_t maxLength = 300);
     std::vector<std::string> splitJapaneseText(const std::string& text, size_t maxLength = 300);
+    // Same splitting as above, the results point into the input instead of copying it
+    void splitLongSentenceSpans(std::string_view sentence, size_t maxLength, std::vector<std::string_view>& results);
+    std::vector<std::string_view> splitJapaneseSpans(std::string_view text, size_t maxLength = 300);
     size_t getUtf8CharLength(unsigned char firstByte);
     void convertPdfToImages(const std::string& pdfPath, const std::string& outputFolder, float stdDevThreshold);
+    void extractTextAndImagesFromPDF(const std::string& inputPath, const std::string& outputFilePath, const std::string& imagesDir, float stdDevThreshold);
+    void extractTextAndImagesFromPDF(const std::string& inputPath, std::ostream& outputText, const std::string& imagesDir, float stdDevThreshold);
+    void extractTextBlocksFromPDF(const std::string& inputPath, std::ostream& outputText, std::vector<PdfTextBlock>& textBlocks);
     bool isImageAboveThreshold(const std::string& imagePath, float threshold);
+    bool isPageImageCandidate(fz_context* ctx, fz_display_list* list, float threshold);
+    bool isPixmapAboveThreshold(fz_context* ctx, fz_pixmap* pixmap, float threshold);
+    static double grayscaleStdDev(const unsigned char* samples, int width, int height, int components, ptrdiff_t stride, double* meanOut = nullptr);
     void createPDF(const std::string& output_file, const std::string& text, const std::string& images_dir);
+    void createPDF(const std::string& output_file, const std::vector<std::string>& texts, const std::string& images_dir);
+    // Saves a copy of the source PDF with every text block redacted and its translation drawn in the same box
+    bool createLayoutPreservingPDF(const std::string& inputPath, const std::string& outputPath, const std::vector<PdfTextBlock>& textBlocks, const std::vector<std::string>& translations);
+    // First font in fontsDirectory, base-14 Helvetica when there is none
+    fz_font* loadLayoutFont(fz_context* ctx) const;
+    void overlayPageTranslations(fz_context* ctx, pdf_document* doc, fz_font* font, TextLayout& layout, const PdfTextBlock* blocks, const std::string* translations, size_t count);
+    void drawFittedText(fz_context* ctx, fz_device* dev, fz_font* font, TextLayout& layout, const fz_rect& box, const std::string& text);
+    static double fontAdvance(fz_context* ctx, fz_font* font, const std::string& text);
     std::string uploadDocumentToDeepL(const std::string& filePath, const std::string& deepLKey);
+    std::future<DeepLResponse> requestDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey);
     std::string checkDocumentStatus(const std::string& document_id, const std::string& document_key, const std::string& deepLKey);
     std::string downloadTranslatedDocument(const std::string& document_id, const std::string& document_key, const std::string& deepLKey);
-    int handleDeepLRequest(const std::string& inputPath, const std::string& outputPath, const std::string& deepLKey);
-    void processPDF(fz_context* ctx, const std::string& inputPath, std::ofstream& outputFile);
+    int handleDeepLRequest(const std::string& inputPath, std::string& translatedText, const std::string& deepLKey);
+    std::filesystem::path createJobDirectory();
+    void writeIntermediateFile(const std::filesystem::path& path, const std::vector<std::string_view>& lines);
+    int translateSentencesWithDeepL(const std::vector<std::string_view>& sentences, const std::filesystem::path& workDir, const std::string& deepLKey, std::vector<std::string>& translatedSentences);
+    // Without a worker one is started for these sentences and stopped again
+    int translateSentencesLocally(const std::vector<std::string_view>& sentences, const std::string& langcode, std::vector<std::string>& translatedSentences, LocalTranslationWorker* sharedWorker = nullptr);
+    int translateSentences(const std::vector<std::string_view>& sentences, const std::filesystem::path& workDir, int localModel, const std::string& deepLKey, const std::string& langcode, std::vector<std::string>& translatedSentences, LocalTranslationWorker* localWorker = nullptr);
+    // Reflow output for setPageWindow, only one window's text and page images are held at a time
+    int translateInPageWindows(const std::string& inputPath, const std::string& outputPdfPath, const std::filesystem::path& jobDir, int localModel, const std::string& deepLKey, const std::string& langcode);
+    int countPages(fz_context* ctx, const std::string& inputPath);
+    // Processes pages [firstPage, endPage), an endPage of -1 runs to the last page
+    void processPDF(fz_context* ctx, const std::string& inputPath, std::ostream& outputFile, const PageProcessingOptions& options = PageProcessingOptions(), std::vector<PdfTextBlock>* textBlocks = nullptr, int firstPage = 0, int endPage = -1);
+    size_t extractionWorkerCount() const;
+    void processPagesInParallel(fz_context* ctx, const std::string& inputPath, int firstPage, int endPage, size_t workerCount, const PageProcessingOptions& options, std::ostream& outputFile, std::vector<PdfTextBlock>* textBlocks = nullptr);
+    void processPage(fz_context* ctx, fz_document* doc, int pageIndex, const PageProcessingOptions& options, std::ostream& outputFile, std::vector<PdfTextBlock>* textBlocks = nullptr);
+    PageProcessingOptions imageOptions(const std::string& imagesDir, float stdDevThreshold) const;
+    bool writePageImage(fz_context* ctx, fz_pixmap* pixmap, int pageIndex, const PageProcessingOptions& options);
+    // Original JPEG stream of a page that is one upright, unmasked image, e.g. a scan
+    fz_buffer* findFullPageJpeg(fz_context* ctx, fz_stext_page* textPage, fz_rect pageBounds);
+    bool writeEmbeddedJpeg(fz_context* ctx, fz_buffer* jpeg, int pageIndex, const PageProcessingOptions& options);
+    static bool isPhotographic(const unsigned char* samples, int width, int height, int components, ptrdiff_t stride);
+    static std::vector<unsigned char> flattenOntoWhite(const unsigned char* samples, int width, int height, int components, ptrdiff_t stride);
+    cairo_surface_t* loadImageSurface(const std::string& imagePath);
+    bool attachJpegData(cairo_surface_t* surface, const std::string& imagePath);
     fz_context* createMuPDFContext();
-    void extractTextFromPage(fz_context* ctx, fz_document* doc, int pageIndex, std::ofstream& outputFile);
+    void extractTextFromPage(fz_context* ctx, fz_document* doc, int pageIndex, std::ostream& outputFile, std::vector<PdfTextBlock>* textBlocks = nullptr);
     bool pageContainsText(fz_stext_page* textPage);
-    void extractTextFromBlocks(fz_stext_page* textPage, std::ofstream& outputFile);
-    void extractTextFromLines(fz_stext_block* block, std::ofstream& outputFile);
-    void extractTextFromChars(fz_stext_line* line, std::ofstream& outputFile);
+    // Writes one text block per line, the splitter never lets a sentence cross a block
+    void extractTextFromBlocks(fz_stext_page* textPage, std::ostream& outputFile, int pageIndex = 0, std::vector<PdfTextBlock>* textBlocks = nullptr);
+    void extractTextFromLines(fz_stext_block* block, std::string& buffer);
+    void extractTextFromChars(fz_stext_line* line, std::string& buffer);
     std::pair<cairo_surface_t*, cairo_t*> initCairoPdfSurface(const std::string &filename, double width, double height);
     void cleanupCairo(cairo_t* cr, cairo_surface_t* surface);
     std::vector<std::string> collectImageFiles(const std::string &images_dir);
     bool addImagesToPdf(cairo_t *cr, cairo_surface_t *surface, const std::vector<std::string> &image_files);
     void configureTextRendering(cairo_t *cr, const std::string &font_family, double font_size);
-    void addTextToPdf(cairo_t* cr, cairo_surface_t* surface, const std::string &input_file, double page_width, double page_height, double margin, double line_spacing, double font_size);
+    // Reads "position,text" lines and keeps the text after the first comma
+    bool readNumberedLines(const std::string& input_file, std::vector<std::string>& texts);
+    // Measures with fonts, or with the font configured on cr when fonts has none
+    static TextLayout reflowLayout(FontManager& fonts, cairo_t* cr);
+    // Starts at y on the current page and returns where the next line would go
+    double addTextToPdf(cairo_t* cr, cairo_surface_t* surface, FontManager& fonts, TextLayout& layout, const std::vector<std::string> &texts, double page_width, double page_height, double margin, double line_spacing, double font_size, double y);
     bool isImageFile(const std::string &extension);
+
+    std::string deepLApiUrl = "https://api-free.deepl.com/v2/document";
+    DeepLPollPolicy::Settings deepLPollSettings;
+    size_t extractionThreads = 0;
+    PageImageFormat pageImageFormat = PageImageFormat::Png;
+    int pagePngCompressionLevel = -1;
+    int pageJpegQuality = 90;
+    bool keepIntermediateFiles = false;
+    PdfOutputMode pdfOutputMode = PdfOutputMode::Reflow;
+    std::filesystem::path fontsDirectory = "fonts";
+    int pageWindow = 0;
+    size_t memoryBudget = 0;
+#if defined(_WIN32)
+    std::filesystem::path localTranslationExecutable = "translation.exe";
+#else
+    std::filesystem::path localTranslationExecutable = "translation";
+#endif
+    std::vector<std::string> localTranslationArguments = {"-", "2"};
+
+    // Reflowed text pages, US Letter in points
+    static constexpr double reflowPageWidth = 612.0;
+    static constexpr double reflowPageHeight = 792.0;
+    static constexpr double reflowMargin = 72.0;
+    static constexpr double reflowLineSpacing = 2.0;
+    static constexpr double reflowFontSize = 12.0;
+
+    // Pages are first rendered this wide to decide whether a full render is needed
+    static constexpr float thumbnailWidth = 128.0f;
+    // Gray levels the thumbnail mean may differ from the full render's
+    static constexpr double thumbnailMeanTolerance = 8.0;
+    // Distinct 12-bit colours above which a page is treated as photographic
+    static constexpr size_t photographicColourBuckets = 512;
+    // Share of the page an image has to cover to be saved from its original stream
+    static constexpr float fullPageImageCoverage = 0.9f;
+    // Font sizes tried when fitting a translation into its block, as multiples of the em
+    static constexpr float layoutMaxFontSize = 14.0f;
+    static constexpr float layoutMinFontSize = 4.0f;
+    static constexpr float layoutLineHeight = 1.15f;
+    static constexpr float layoutAscent = 0.8f;
 };
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "TextLayout.h"
+
+TextLayout::TextLayout(MeasureFunction measure) : measure(std::move(measure)) {}
+
+double TextLayout::advance(std::string_view token) {
+    // lookupKey keeps its capacity, so cache hits do not allocate
+    lookupKey.assign(token.data(), token.size());
+    auto it = advanceCache.find(lookupKey);
+    if (it != advanceCache.end()) {
+        return it->second;
+    }
+
+    double width = measure(lookupKey);
+    advanceCache.emplace(lookupKey, width);
+    return width;
+}
+
+char32_t TextLayout::decodeUtf8(std::string_view text, size_t pos, size_t& length) {
+    unsigned char lead = static_cast<unsigned char>(text[pos]);
+    size_t expected = 1;
+    char32_t codepoint = lead;
+
+    if (lead < 0x80) {
+        length = 1;
+        return codepoint;
+    } else if ((lead & 0xE0) == 0xC0) {
+        expected = 2;
+        codepoint = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        expected = 3;
+        codepoint = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        expected = 4;
+        codepoint = lead & 0x07;
+    } else {
+        // Stray continuation byte, measured as its own token
+        length = 1;
+        return 0xFFFD;
+    }
+
+    if (pos + expected > text.size()) {
+        length = text.size() - pos;
+        return 0xFFFD;
+    }
+
+    for (size_t i = 1; i < expected; ++i) {
+        codepoint = (codepoint << 6) | (static_cast<unsigned char>(text[pos + i]) & 0x3F);
+    }
+    length = expected;
+    return codepoint;
+}
+
+bool TextLayout::isCjkCodepoint(char32_t c) {
+    return (c >= 0x2E80 && c <= 0x2FFF)     // Radicals
+        || (c >= 0x3000 && c <= 0x31FF)     // CJK punctuation, kana, bopomofo
+        || (c >= 0x3400 && c <= 0x4DBF)     // Extension A
+        || (c >= 0x4E00 && c <= 0x9FFF)     // Unified ideographs
+        || (c >= 0xF900 && c <= 0xFAFF)     // Compatibility ideographs
+        || (c >= 0xFF00 && c <= 0xFFEF)     // Full and half width forms
+        || (c >= 0x20000 && c <= 0x2FFFF);  // Supplementary ideographs
+}
+
+bool TextLayout::isClosingPunctuation(char32_t c) {
+    switch (c) {
+        case ',': case '.': case '!': case '?': case ';': case ':': case ')': case ']': case '}':
+        case 0x3001: case 0x3002: case 0xFF0C: case 0xFF0E: case 0x30FB: case 0xFF1A: case 0xFF1B:
+        case 0xFF1F: case 0xFF01: case 0x30FC: case 0x2026: case 0x2025: case 0x2019: case 0x201D:
+        case 0x300D: case 0x300F: case 0xFF09: case 0xFF3D: case 0xFF5D: case 0x3015: case 0x3009:
+        case 0x300B: case 0x3011: case 0x3017: case 0x3019: case 0x301F: case 0x3005:
+        case 0x3063: case 0x3083: case 0x3085: case 0x3087: case 0x30C3: case 0x30E3: case 0x30E5: case 0x30E7:
+            return true;
+        default:
+            return false;
+    }
+}
+
+namespace {
+
+bool isOpeningPunctuation(char32_t c) {
+    switch (c) {
+        case 0x300C: case 0x300E: case 0xFF08: case 0xFF3B: case 0xFF5B: case 0x3014: case 0x3008:
+        case 0x300A: case 0x3010: case 0x3016: case 0x3018: case 0x301D: case 0x2018: case 0x201C:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+bool TextLayout::isLayoutSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+size_t TextLayout::tokenEnd(std::string_view text, size_t start) {
+    // Latin words run to the next space or CJK character, a CJK character is
+    // a token of its own. Closing punctuation sticks to the token before it
+    // and opening punctuation to the token after it.
+    const size_t size = text.size();
+    size_t end = start;
+    size_t length = 0;
+    char32_t codepoint = decodeUtf8(text, end, length);
+    end += length;
+
+    while (isOpeningPunctuation(codepoint) && end < size && !isLayoutSpace(text[end])) {
+        codepoint = decodeUtf8(text, end, length);
+        end += length;
+    }
+
+    if (!isCjkCodepoint(codepoint)) {
+        while (end < size && !isLayoutSpace(text[end])) {
+            char32_t next = decodeUtf8(text, end, length);
+            if (isCjkCodepoint(next) && !isClosingPunctuation(next)) {
+                break;
+            }
+            end += length;
+        }
+    }
+
+    while (end < size && !isLayoutSpace(text[end])) {
+        char32_t next = decodeUtf8(text, end, length);
+        if (!isClosingPunctuation(next)) {
+            break;
+        }
+        end += length;
+    }
+    return end;
+}
+
+void TextLayout::breakLines(std::string_view paragraph, double maxWidth, std::vector<std::string_view>& lines) {
+    if (spaceAdvance < 0.0) {
+        spaceAdvance = advance(" ");
+    }
+
+    const size_t size = paragraph.size();
+
+    bool lineOpen = false;
+    size_t lineStart = 0;
+    size_t lineEnd = 0;
+    double lineWidth = 0.0;
+    size_t gapSpaces = 0;
+
+    size_t pos = 0;
+    while (pos < size) {
+        if (isLayoutSpace(paragraph[pos])) {
+            ++gapSpaces;
+            ++pos;
+            continue;
+        }
+
+        size_t end = tokenEnd(paragraph, pos);
+        double width = advance(paragraph.substr(pos, end - pos));
+
+        if (!lineOpen) {
+            lineOpen = true;
+            lineStart = pos;
+            lineWidth = width;
+        } else {
+            double gap = static_cast<double>(gapSpaces) * spaceAdvance;
+            if (lineWidth + gap + width > maxWidth) {
+                lines.push_back(paragraph.substr(lineStart, lineEnd - lineStart));
+                lineStart = pos;
+                lineWidth = width;
+            } else {
+                lineWidth += gap + width;
+            }
+        }
+
+        lineEnd = end;
+        gapSpaces = 0;
+        pos = end;
+    }
+
+    if (lineOpen) {
+        lines.push_back(paragraph.substr(lineStart, lineEnd - lineStart));
+    }
+}
+
+std::vector<std::string_view> TextLayout::breakLines(std::string_view paragraph, double maxWidth) {
+    std::vector<std::string_view> lines;
+    breakLines(paragraph, maxWidth, lines);
+    return lines;
+}
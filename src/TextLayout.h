@@ -0,0 +1,50 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Greedy line breaking for the translated text written into the output PDF.
+// Every distinct word (and every CJK character) is measured once per font and
+// cached, a line's width is the sum of its words' advances plus the gaps
+// between them, so breaking a paragraph is linear in its length.
+//
+// Break opportunities are whitespace and the boundary before and after each
+// CJK character, except that closing punctuation such as "。" or "」" is kept
+// on the line of the character before it.
+class TextLayout {
+public:
+    // Returns the horizontal advance of token in the current font
+    using MeasureFunction = std::function<double(const std::string& token)>;
+
+    explicit TextLayout(MeasureFunction measure);
+
+    // Appends the lines of paragraph to lines, each one a view into paragraph
+    // without leading or trailing whitespace. A word wider than maxWidth gets
+    // a line of its own.
+    void breakLines(std::string_view paragraph, double maxWidth, std::vector<std::string_view>& lines);
+    std::vector<std::string_view> breakLines(std::string_view paragraph, double maxWidth);
+
+    // Cached advance of token, measured on first use
+    double advance(std::string_view token);
+
+    size_t measuredTokenCount() const { return advanceCache.size(); }
+
+    // Whitespace that separates tokens, it is never measured or drawn
+    static bool isLayoutSpace(char c);
+    // End of the unbreakable token of text that starts at start, which must
+    // not be layout whitespace
+    static size_t tokenEnd(std::string_view text, size_t start);
+
+protected:
+    static bool isCjkCodepoint(char32_t codepoint);
+    static bool isClosingPunctuation(char32_t codepoint);
+    static char32_t decodeUtf8(std::string_view text, size_t pos, size_t& length);
+
+    MeasureFunction measure;
+    std::unordered_map<std::string, double> advanceCache;
+    std::string lookupKey;
+    double spaceAdvance = -1.0;
+};
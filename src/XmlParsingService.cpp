@@ -0,0 +1,248 @@
+#include "XmlParsingService.h"
+#include <libxml/xmlerror.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// Each arena allocation is prefixed with its size so realloc can copy it
+constexpr size_t kArenaHeaderSize = alignof(std::max_align_t) > sizeof(size_t) ? alignof(std::max_align_t) : sizeof(size_t);
+
+bool arenasEnabled = false;
+thread_local XmlParsingService::DocumentArena* activeArena = nullptr;
+
+size_t alignArenaSize(size_t size) {
+    return (size + kArenaHeaderSize - 1) & ~(kArenaHeaderSize - 1);
+}
+
+void XMLCALL arenaFree(void* ptr) {
+    if (!ptr) return;
+    if (activeArena && activeArena->owns(ptr)) {
+        return;  // Released together with the arena
+    }
+    std::free(ptr);
+}
+
+void* XMLCALL arenaMalloc(size_t size) {
+    if (activeArena) {
+        return activeArena->allocate(size);
+    }
+    return std::malloc(size);
+}
+
+void* XMLCALL arenaRealloc(void* ptr, size_t size) {
+    if (!activeArena) {
+        return std::realloc(ptr, size);
+    }
+    if (!ptr) {
+        return activeArena->allocate(size);
+    }
+    if (!activeArena->owns(ptr)) {
+        return std::realloc(ptr, size);  // Heap memory stays on the heap
+    }
+
+    void* grown = activeArena->allocate(size);
+    if (grown) {
+        std::memcpy(grown, ptr, std::min(size, XmlParsingService::DocumentArena::allocationSize(ptr)));
+    }
+    return grown;
+}
+
+char* XMLCALL arenaStrdup(const char* str) {
+    if (!str) return nullptr;
+    size_t length = std::strlen(str) + 1;
+    char* copy = static_cast<char*>(arenaMalloc(length));
+    if (copy) {
+        std::memcpy(copy, str, length);
+    }
+    return copy;
+}
+
+} // namespace
+
+XmlParsingService& XmlParsingService::forCurrentThread() {
+    thread_local XmlParsingService service;
+    return service;
+}
+
+XmlParsingService::XmlParsingService() = default;
+
+XmlParsingService::~XmlParsingService() {
+    if (htmlContext) htmlFreeParserCtxt(htmlContext);
+    if (xmlContext) xmlFreeParserCtxt(xmlContext);
+    if (dictionary) xmlDictFree(dictionary);
+}
+
+void XmlParsingService::enableDocumentArenas() {
+    if (arenasEnabled) return;
+
+    if (xmlMemSetup(arenaFree, arenaMalloc, arenaRealloc, arenaStrdup) != 0) {
+        return;
+    }
+    xmlInitParser();
+    arenasEnabled = true;
+}
+
+bool XmlParsingService::documentArenasEnabled() {
+    return arenasEnabled;
+}
+
+bool XmlParsingService::arenaActive() {
+    return activeArena != nullptr;
+}
+
+void XmlParsingService::shareDictionary(xmlParserCtxtPtr ctxt) {
+    // Only safe on a fresh context, before any names were interned in its own dictionary
+    if (!dictionary) {
+        dictionary = xmlDictCreate();
+        if (!dictionary) return;
+    }
+    if (ctxt->dict != dictionary) {
+        xmlDictFree(ctxt->dict);
+        ctxt->dict = dictionary;
+        xmlDictReference(dictionary);
+    }
+}
+
+htmlParserCtxtPtr XmlParsingService::acquireHtmlContext() {
+    if (!htmlContext) {
+        htmlContext = htmlNewParserCtxt();
+        if (htmlContext) {
+            shareDictionary(htmlContext);
+        }
+    }
+    return htmlContext;
+}
+
+xmlParserCtxtPtr XmlParsingService::acquireXmlContext() {
+    if (!xmlContext) {
+        xmlContext = xmlNewParserCtxt();
+        if (xmlContext) {
+            shareDictionary(xmlContext);
+        }
+    }
+    return xmlContext;
+}
+
+htmlDocPtr XmlParsingService::parseHtmlMemory(const std::string& content, const char* encoding, int options) {
+    // htmlReadMemory refuses empty input, keep that behaviour
+    if (content.empty()) {
+        return nullptr;
+    }
+
+    if (arenaActive()) {
+        return htmlReadMemory(content.data(), static_cast<int>(content.size()), nullptr, encoding, options);
+    }
+
+    htmlParserCtxtPtr ctxt = acquireHtmlContext();
+    if (!ctxt) {
+        return nullptr;
+    }
+    // htmlCtxtReadMemory resets the context, keeping its buffers and dictionary
+    return htmlCtxtReadMemory(ctxt, content.data(), static_cast<int>(content.size()), nullptr, encoding, options);
+}
+
+htmlDocPtr XmlParsingService::parseHtmlFile(const std::string& path, const char* encoding, int options) {
+    if (arenaActive()) {
+        return htmlReadFile(path.c_str(), encoding, options);
+    }
+
+    htmlParserCtxtPtr ctxt = acquireHtmlContext();
+    if (!ctxt) {
+        return nullptr;
+    }
+    return htmlCtxtReadFile(ctxt, path.c_str(), encoding, options);
+}
+
+xmlDocPtr XmlParsingService::parseXmlMemory(const std::string& content, const char* encoding, int options) {
+    if (content.empty()) {
+        return nullptr;
+    }
+
+    if (arenaActive()) {
+        return xmlReadMemory(content.data(), static_cast<int>(content.size()), nullptr, encoding, options);
+    }
+
+    xmlParserCtxtPtr ctxt = acquireXmlContext();
+    if (!ctxt) {
+        return nullptr;
+    }
+    return xmlCtxtReadMemory(ctxt, content.data(), static_cast<int>(content.size()), nullptr, encoding, options);
+}
+
+xmlDocPtr XmlParsingService::parseXmlFile(const std::string& path, const char* encoding, int options) {
+    if (arenaActive()) {
+        return xmlReadFile(path.c_str(), encoding, options);
+    }
+
+    xmlParserCtxtPtr ctxt = acquireXmlContext();
+    if (!ctxt) {
+        return nullptr;
+    }
+    return xmlCtxtReadFile(ctxt, path.c_str(), encoding, options);
+}
+
+XmlParsingService::DocumentArena::DocumentArena(size_t blockSize) : blockSize(blockSize) {
+    if (!arenasEnabled) {
+        return;
+    }
+
+    // Make sure libxml2's global and per-thread state lives on the heap, not in the arena
+    xmlInitParser();
+    xmlResetLastError();
+
+    previous = activeArena;
+    activeArena = this;
+    active = true;
+}
+
+XmlParsingService::DocumentArena::~DocumentArena() {
+    if (active) {
+        // The last error may hold strings from this arena
+        xmlResetLastError();
+        activeArena = previous;
+    }
+
+    for (auto& block : blocks) {
+        std::free(block.data);
+    }
+}
+
+void* XmlParsingService::DocumentArena::allocate(size_t size) {
+    size_t needed = kArenaHeaderSize + alignArenaSize(size);
+
+    if (blocks.empty() || blocks.back().size - blocks.back().used < needed) {
+        size_t newBlockSize = std::max(blockSize, needed);
+        char* data = static_cast<char*>(std::malloc(newBlockSize));
+        if (!data) {
+            return nullptr;
+        }
+        blocks.push_back({data, newBlockSize, 0});
+    }
+
+    Block& block = blocks.back();
+    char* header = block.data + block.used;
+    block.used += needed;
+
+    std::memcpy(header, &size, sizeof(size));
+    return header + kArenaHeaderSize;
+}
+
+bool XmlParsingService::DocumentArena::owns(const void* ptr) const {
+    const char* p = static_cast<const char*>(ptr);
+    for (const DocumentArena* arena = this; arena; arena = arena->previous) {
+        for (const auto& block : arena->blocks) {
+            if (p >= block.data && p < block.data + block.size) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+size_t XmlParsingService::DocumentArena::allocationSize(const void* ptr) {
+    size_t size;
+    std::memcpy(&size, static_cast<const char*>(ptr) - kArenaHeaderSize, sizeof(size));
+    return size;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <libxml/HTMLparser.h>
+#include <libxml/parser.h>
+#include <libxml/dict.h>
+#include <libxml/xmlmemory.h>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Parses HTML/XML documents while reusing libxml2 parser contexts and one
+// string dictionary per thread, instead of building them again for every
+// chapter. Use forCurrentThread() to get the instance owned by the calling
+// thread; documents it returns are freed with xmlFreeDoc as usual.
+class XmlParsingService {
+public:
+    static XmlParsingService& forCurrentThread();
+
+    XmlParsingService();
+    ~XmlParsingService();
+    XmlParsingService(const XmlParsingService&) = delete;
+    XmlParsingService& operator=(const XmlParsingService&) = delete;
+
+    htmlDocPtr parseHtmlMemory(const std::string& content, const char* encoding, int options);
+    htmlDocPtr parseHtmlFile(const std::string& path, const char* encoding, int options);
+    xmlDocPtr parseXmlMemory(const std::string& content, const char* encoding, int options);
+    xmlDocPtr parseXmlFile(const std::string& path, const char* encoding, int options);
+
+    // Routes libxml2 allocations through DocumentArena when one is active on
+    // the calling thread. Must run before any other libxml2 call.
+    static void enableDocumentArenas();
+    static bool documentArenasEnabled();
+
+    // While alive, every libxml2 allocation made on this thread is carved out
+    // of a bump allocator and released in one go when the arena is destroyed.
+    // Documents parsed inside the scope must not be used after it ends, and
+    // parsing uses a throwaway context so the shared dictionary never points
+    // into arena memory.
+    class DocumentArena {
+    public:
+        explicit DocumentArena(size_t blockSize = 1 << 20);
+        ~DocumentArena();
+        DocumentArena(const DocumentArena&) = delete;
+        DocumentArena& operator=(const DocumentArena&) = delete;
+
+        bool isActive() const { return active; }
+        void* allocate(size_t size);
+        bool owns(const void* ptr) const;
+        static size_t allocationSize(const void* ptr);
+
+    private:
+        struct Block {
+            char* data;
+            size_t size;
+            size_t used;
+        };
+
+        std::vector<Block> blocks;
+        size_t blockSize;
+        bool active = false;
+        DocumentArena* previous = nullptr;
+    };
+
+protected:
+    htmlParserCtxtPtr acquireHtmlContext();
+    xmlParserCtxtPtr acquireXmlContext();
+    void shareDictionary(xmlParserCtxtPtr ctxt);
+    static bool arenaActive();
+
+    htmlParserCtxtPtr htmlContext = nullptr;
+    xmlParserCtxtPtr xmlContext = nullptr;
+    xmlDictPtr dictionary = nullptr;
+};
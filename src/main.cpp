@@ -12,6 +12,11 @@ void fileDropCallback(GLFWwindow* window, int count, const char** paths) {
 
 
 int main() {
+#ifdef BOOKTRANSLATOR_XML_ARENA
+    // Must happen before libxml2 allocates anything
+    XmlParsingService::enableDocumentArenas();
+#endif
+
     try{
         // All the couts are redirected to captureOutput so we can use it in our GUI
         std::streambuf* originalBuffer = std::cout.rdbuf();
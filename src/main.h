@@ -1,4 +1,5 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "GUI.h"
+#include "XmlParsingService.h"
 #include <sstream>
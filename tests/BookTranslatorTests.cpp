@@ -1,9 +1,26 @@
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/reporters/catch_reporter_event_listener.hpp>
+#include <catch2/reporters/catch_reporter_registrars.hpp>
 #include "BookTranslatorTests.h"
 #include <filesystem>
 #include <fstream>
 
+#ifdef BOOKTRANSLATOR_XML_ARENA
+// Installs the arena allocator before any test touches libxml2, the way
+// main() does, so every test runs with the allocator hooks in place
+class XmlArenaListener : public Catch::EventListenerBase {
+public:
+    using Catch::EventListenerBase::EventListenerBase;
+
+    void testRunStarting(Catch::TestRunInfo const&) override {
+        XmlParsingService::enableDocumentArenas();
+    }
+};
+CATCH_REGISTER_LISTENER(XmlArenaListener)
+#endif
+
 // ------ EpubTranslator ------
 
 TEST_CASE("EpubTranslator: searchForOPFFiles works correctly") {
@@ -638,6 +655,35 @@ TEST_CASE("EpubTranslator: stripHtmlTags correctly removes HTML tags from string
     }
 }
 
+TEST_CASE("EpubTranslator: tag scanner benchmarks", "[.][benchmark]") {
+    TestableEpubTranslator translator;
+
+    std::string paragraph;
+    for (int i = 0; i < 200; ++i) {
+        paragraph += "<span class=\"c1\">これはテストです。</span><ruby>漢字<rt>かんじ</rt></ruby>";
+    }
+
+    std::vector<std::string> opfContent = {"<package>", "<manifest>"};
+    for (int i = 0; i < 500; ++i) {
+        opfContent.push_back("<item id=\"chapter" + std::to_string(i) + "\" href=\"Text/chapter" + std::to_string(i) + ".xhtml\" media-type=\"application/xhtml+xml\"/>");
+    }
+    opfContent.push_back("</manifest>");
+    opfContent.push_back("<spine toc=\"ncx\">");
+    for (int i = 0; i < 500; ++i) {
+        opfContent.push_back("<itemref idref=\"chapter" + std::to_string(i) + "\"/>");
+    }
+    opfContent.push_back("</spine>");
+    opfContent.push_back("</package>");
+
+    BENCHMARK("stripHtmlTags on a 200 run paragraph") {
+        return translator.stripHtmlTags(paragraph);
+    };
+
+    BENCHMARK("parseManifestAndSpine on a 500 chapter OPF") {
+        return translator.parseManifestAndSpine(opfContent);
+    };
+}
+
 TEST_CASE("EpubTranslator: readChapterFile reads file content correctly") {
     TestableEpubTranslator translator;
 
@@ -677,6 +723,18 @@ TEST_CASE("EpubTranslator: parseHtmlDocument parses valid HTML content") {
         std::string invalidContent = "";  // Empty content
         REQUIRE_THROWS_AS(translator.parseHtmlDocument(invalidContent), std::runtime_error);
     }
+
+    SECTION("Documents parsed on the reused context stay independent") {
+        htmlDocPtr first = translator.parseHtmlDocument("<html><body><p>First</p></body></html>");
+        htmlDocPtr second = translator.parseHtmlDocument("<html><body><p>Second</p></body></html>");
+        REQUIRE(first != nullptr);
+        REQUIRE(second != nullptr);
+
+        REQUIRE(translator.serializeDocument(first).find("<p>First</p>") != std::string::npos);
+        xmlFreeDoc(first);
+        REQUIRE(translator.serializeDocument(second).find("<p>Second</p>") != std::string::npos);
+        xmlFreeDoc(second);
+    }
 }
 
 TEST_CASE("EpubTranslator: cleanNodes removes unwanted tags") {
@@ -1305,6 +1363,464 @@ TEST_CASE("translator.containsJapanese", "[containsJapanese]") {
 }
 
 
+// ------ XmlParsingService ------
+
+#ifdef BOOKTRANSLATOR_XML_ARENA
+TEST_CASE("XmlParsingService: chapters parsed and freed inside nested arenas") {
+    REQUIRE(XmlParsingService::documentArenasEnabled());
+    XmlParsingService& parser = XmlParsingService::forCurrentThread();
+
+    auto chapter = [](int number) {
+        std::string html = "<html><body>";
+        for (int i = 0; i < 200; ++i) {
+            html += "<p class=\"c" + std::to_string(number) + "\">段落 " + std::to_string(i) + "</p>";
+        }
+        return html + "</body></html>";
+    };
+    auto paragraphCount = [](htmlDocPtr doc) {
+        int count = 0;
+        xmlNodePtr body = xmlDocGetRootElement(doc)->children;
+        for (xmlNodePtr node = body ? body->children : nullptr; node; node = node->next) {
+            count += node->type == XML_ELEMENT_NODE;
+        }
+        return count;
+    };
+
+    // Small blocks so documents span several of them
+    XmlParsingService::DocumentArena outer(4096);
+    REQUIRE(outer.isActive());
+    htmlDocPtr first = parser.parseHtmlMemory(chapter(1), "UTF-8", HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
+    htmlDocPtr second = parser.parseHtmlMemory(chapter(2), "UTF-8", HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
+    REQUIRE(first != nullptr);
+    REQUIRE(second != nullptr);
+    REQUIRE(outer.owns(first));
+
+    {
+        XmlParsingService::DocumentArena inner(4096);
+        for (int number = 3; number <= 5; ++number) {
+            htmlDocPtr doc = parser.parseHtmlMemory(chapter(number), "UTF-8", HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
+            REQUIRE(doc != nullptr);
+            REQUIRE(inner.owns(doc));
+            REQUIRE(paragraphCount(doc) == 200);
+            xmlFreeDoc(doc);
+        }
+
+        // A document of the enclosing arena is released with that arena, not freed here
+        REQUIRE(inner.owns(second));
+        xmlFreeDoc(second);
+    }
+
+    // Growing a buffer copies it from block to block
+    xmlBufferPtr buffer = xmlBufferCreate();
+    for (int i = 0; i < 1000; ++i) {
+        xmlBufferCat(buffer, BAD_CAST "0123456789");
+    }
+    REQUIRE(xmlBufferLength(buffer) == 10000);
+    REQUIRE(std::string(reinterpret_cast<const char*>(xmlBufferContent(buffer)), 10) == "0123456789");
+    xmlBufferFree(buffer);
+
+    REQUIRE(paragraphCount(first) == 200);
+    xmlFreeDoc(first);
+}
+
+TEST_CASE("XmlParsingService: heap documents can be freed while an arena is active") {
+    REQUIRE(XmlParsingService::documentArenasEnabled());
+    XmlParsingService& parser = XmlParsingService::forCurrentThread();
+
+    htmlDocPtr heapDoc = parser.parseHtmlMemory("<html><body><p>ヒープ</p></body></html>", "UTF-8", HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
+    REQUIRE(heapDoc != nullptr);
+
+    XmlParsingService::DocumentArena arena;
+    REQUIRE_FALSE(arena.owns(heapDoc));
+    htmlDocPtr arenaDoc = parser.parseHtmlMemory("<html><body><p>アリーナ</p></body></html>", "UTF-8", HTML_PARSE_NOERROR | HTML_PARSE_NOWARNING);
+    REQUIRE(arena.owns(arenaDoc));
+
+    // Goes back to the heap, not into the arena
+    xmlFreeDoc(heapDoc);
+    xmlFreeDoc(arenaDoc);
+}
+#endif
+
+// ------ DeepL -------
+
+TEST_CASE("EpubTranslator: translateDocumentsWithDeepL keeps several documents in flight") {
+    TestableEpubTranslator translator;
+    MockDeepLServer server(3);
+
+    std::filesystem::path testDir = "test_deepl_documents";
+    std::filesystem::create_directories(testDir);
+
+    std::vector<DeepLDocumentScheduler::Job> jobs;
+    for (size_t i = 0; i < 5; ++i) {
+        std::string path = (testDir / (std::to_string(i) + ".html")).string();
+        std::ofstream(path) << "<p>chapter " << i << "</p>";
+        jobs.push_back({i, path});
+    }
+
+    DeepLPollPolicy::Settings pollSettings;
+    pollSettings.initialDelay = std::chrono::milliseconds(10);
+    pollSettings.maxDelay = std::chrono::milliseconds(20);
+
+    translator.setDeepLApiUrl(server.documentUrl());
+    translator.setDeepLPollSettings(pollSettings);
+
+    SECTION("Downloads every document into its own slot") {
+        translator.setDeepLMaxConcurrentDocuments(2);
+        std::vector<std::string> results(jobs.size());
+
+        REQUIRE(translator.translateDocumentsWithDeepL(jobs, results, "test-key"));
+        REQUIRE(server.uploadCount() == jobs.size());
+        REQUIRE(server.peakTranslating() == 2);
+        // Uploads, status checks and downloads share a handful of kept-alive connections
+        REQUIRE(server.connectionCount() <= jobs.size());
+
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            REQUIRE(results[i] == std::string(MockDeepLServer::translatedPrefix) + "<p>chapter " + std::to_string(i) + "</p>");
+        }
+    }
+
+    SECTION("Uploads everything at once when the limit allows it") {
+        translator.setDeepLMaxConcurrentDocuments(10);
+        std::vector<std::string> results(jobs.size());
+
+        REQUIRE(translator.translateDocumentsWithDeepL(jobs, results, "test-key"));
+        REQUIRE(server.peakTranslating() == jobs.size());
+    }
+
+    SECTION("Retries status checks that fail transiently") {
+        translator.setDeepLMaxConcurrentDocuments(2);
+        server.failNextStatusChecks(3);
+        std::vector<std::string> results(jobs.size());
+
+        REQUIRE(translator.translateDocumentsWithDeepL(jobs, results, "test-key"));
+        REQUIRE(results[4] == std::string(MockDeepLServer::translatedPrefix) + "<p>chapter 4</p>");
+    }
+
+    SECTION("Gives up after too many transient failures") {
+        pollSettings.maxTransientFailures = 2;
+        translator.setDeepLPollSettings(pollSettings);
+        translator.setDeepLMaxConcurrentDocuments(1);
+        server.failNextStatusChecks(10);
+        std::vector<std::string> results(jobs.size());
+
+        REQUIRE_FALSE(translator.translateDocumentsWithDeepL(jobs, results, "test-key"));
+    }
+
+    SECTION("Fails when the upload is rejected") {
+        translator.setDeepLApiUrl(server.documentUrl() + "/missing/upload");
+        std::vector<std::string> results(jobs.size());
+
+        REQUIRE_FALSE(translator.translateDocumentsWithDeepL(jobs, results, "test-key"));
+    }
+
+    std::filesystem::remove_all(testDir);
+}
+
+TEST_CASE("DeepLTextTranslator: batches texts within the API limits") {
+    MockDeepLServer server;
+    DeepLTextTranslator translator(server.translateUrl(), "test-key");
+
+    SECTION("Splits on the text count limit") {
+        std::vector<std::string> texts(120, "短い文");
+        auto batches = translator.planBatches(texts);
+        REQUIRE(batches.size() == 3);
+        REQUIRE(batches[0] == std::make_pair<size_t, size_t>(0, 50));
+        REQUIRE(batches[1] == std::make_pair<size_t, size_t>(50, 100));
+        REQUIRE(batches[2] == std::make_pair<size_t, size_t>(100, 120));
+    }
+
+    SECTION("Splits on the request size limit") {
+        std::vector<std::string> texts(10, std::string(30 * 1024, 'a'));
+        texts.push_back(std::string(200 * 1024, 'b'));  // Too big for any batch, goes alone
+        texts.push_back("tail");
+
+        auto batches = translator.planBatches(texts);
+        REQUIRE(batches.size() == 5);
+        REQUIRE(batches[0] == std::make_pair<size_t, size_t>(0, 4));
+        REQUIRE(batches[2] == std::make_pair<size_t, size_t>(8, 10));
+        REQUIRE(batches[3] == std::make_pair<size_t, size_t>(10, 11));
+        REQUIRE(batches[4] == std::make_pair<size_t, size_t>(11, 12));
+    }
+
+    SECTION("Translates every text in order and leaves empty ones alone") {
+        std::vector<std::string> texts;
+        for (int i = 0; i < 120; ++i) {
+            texts.push_back(i % 10 == 0 ? "" : "文 " + std::to_string(i) + " <b>強調</b>");
+        }
+
+        std::vector<std::string> translations;
+        REQUIRE(translator.translate(texts, translations));
+        REQUIRE(translations.size() == texts.size());
+        REQUIRE(server.translateRequestCount() == 3);
+        REQUIRE(server.largestTranslateBatch() <= DeepLTextTranslator::maxTextsPerRequest);
+        REQUIRE(server.largestTranslateBody() <= DeepLTextTranslator::maxRequestBytes);
+
+        for (size_t i = 0; i < texts.size(); ++i) {
+            if (texts[i].empty()) {
+                REQUIRE(translations[i].empty());
+            } else {
+                REQUIRE(translations[i] == std::string(MockDeepLServer::translatedPrefix) + texts[i]);
+            }
+        }
+    }
+}
+
+TEST_CASE("EpubTranslator: handleDeepLTextRequest writes translated chapters") {
+    TestableEpubTranslator translator;
+    MockDeepLServer server;
+    translator.setDeepLTextApiUrl(server.translateUrl());
+
+    std::filesystem::create_directories("export/OEBPS/Text");
+    std::vector<std::filesystem::path> chapters = {"chapter1.xhtml", "chapter2.xhtml"};
+    std::vector<tagData> bookTags = {
+        {P_TAG, "最初の段落", 0, 0},
+        {IMG_TAG, "cover.jpg", 1, 0},
+        {P_TAG, "二番目の章", 0, 1},
+    };
+
+    REQUIRE(translator.handleDeepLTextRequest(bookTags, chapters, "test-key") == 0);
+    REQUIRE(server.translateRequestCount() == 1);
+
+    std::string first = translator.readChapterFile("export/OEBPS/Text/chapter1.xhtml");
+    std::string second = translator.readChapterFile("export/OEBPS/Text/chapter2.xhtml");
+    REQUIRE(first.find("<p>[translated] 最初の段落</p>") != std::string::npos);
+    REQUIRE(first.find("<img src=\"../Images/cover.jpg\" alt=\"\"/>") != std::string::npos);
+    REQUIRE(second.find("<p>[translated] 二番目の章</p>") != std::string::npos);
+
+    std::filesystem::remove_all("export");
+}
+
+#ifndef _WIN32
+TEST_CASE("LocalTranslationWorker: streams segments to a running process") {
+    // Stands in for the translation executable in streaming mode
+    const std::vector<std::string> echoWorker = {"-c", "while IFS= read -r line; do echo \"RESULT,$line (local)\"; done"};
+
+    SECTION("Returns one result per submitted segment") {
+        LocalTranslationWorker worker("/bin/sh", echoWorker);
+        REQUIRE(worker.start());
+        REQUIRE(worker.submit(0, 3, "最初の段落"));
+        REQUIRE(worker.submit(2, 1, "改行\nを含む, カンマ"));
+
+        std::vector<LocalTranslationWorker::Result> results = worker.finish();
+        REQUIRE(worker.submittedCount() == 2);
+        REQUIRE(results.size() == 2);
+        REQUIRE(results[0].chapterNum == 0);
+        REQUIRE(results[0].position == 3);
+        REQUIRE(results[0].output == "最初の段落 (local)");
+        REQUIRE(results[1].chapterNum == 2);
+        REQUIRE(results[1].position == 1);
+        REQUIRE(results[1].output == "改行 を含む, カンマ (local)");
+    }
+
+    SECTION("Starts on the first submitted segment") {
+        LocalTranslationWorker worker("/bin/sh", echoWorker);
+        REQUIRE_FALSE(worker.isRunning());
+        REQUIRE(worker.submit(1, 0, "テキスト"));
+        REQUIRE(worker.isRunning());
+        REQUIRE(worker.finish().size() == 1);
+    }
+
+    SECTION("Collects each batch while the process keeps running") {
+        LocalTranslationWorker worker("/bin/sh", echoWorker);
+        REQUIRE(worker.submit(0, 1, "一"));
+        REQUIRE(worker.submit(0, 2, "二"));
+        REQUIRE(worker.collect().size() == 2);
+        REQUIRE(worker.isRunning());
+
+        REQUIRE(worker.submit(0, 1, "三"));
+        std::vector<LocalTranslationWorker::Result> results = worker.collect();
+        REQUIRE(results.size() == 1);
+        REQUIRE(results[0].output == "三 (local)");
+        REQUIRE(worker.finish().empty());
+    }
+
+    SECTION("A failed segment is answered without a result") {
+        LocalTranslationWorker worker("/bin/sh", {"-c", "while IFS=, read -r chapter position text; do "
+            "if [ \"$text\" = fail ]; then echo \"FAILED,$chapter,$position\"; else echo \"RESULT,$chapter,$position,$text\"; fi; done"});
+        REQUIRE(worker.submit(0, 1, "fail"));
+        REQUIRE(worker.submit(0, 2, "ok"));
+        std::vector<LocalTranslationWorker::Result> results = worker.collect();
+        REQUIRE(results.size() == 1);
+        REQUIRE(results[0].position == 2);
+        REQUIRE(worker.finish().empty());
+    }
+
+    SECTION("Fails cleanly when the executable is missing") {
+        LocalTranslationWorker worker("does-not-exist/translation");
+        REQUIRE_FALSE(worker.submit(0, 0, "テキスト"));
+        REQUIRE(worker.finish().empty());
+    }
+}
+
+TEST_CASE("EpubTranslator: handleDeepLRequest streams untranslated text to the local worker") {
+    TestableEpubTranslator translator;
+    MockDeepLServer server;
+    server.setReturnDocumentsUnchanged(true);
+    translator.setDeepLApiUrl(server.documentUrl());
+    DeepLPollPolicy::Settings pollSettings;
+    pollSettings.initialDelay = std::chrono::milliseconds(10);
+    pollSettings.maxDelay = std::chrono::milliseconds(20);
+    translator.setDeepLPollSettings(pollSettings);
+    translator.setLocalTranslationCommand("/bin/sh", {"-c", "while IFS= read -r line; do echo \"RESULT,$line (local)\"; done"});
+
+    std::filesystem::create_directories("export/OEBPS/Text");
+    std::vector<std::filesystem::path> chapters = {"chapter1.xhtml", "chapter2.xhtml", "chapter3.xhtml"};
+    std::vector<tagData> bookTags = {
+        {P_TAG, "最初の段落", 0, 0},
+        {P_TAG, "Already English", 1, 0},
+        {IMG_TAG, "cover.jpg", 0, 1},
+        {P_TAG, "三番目の章", 0, 2},
+    };
+
+    REQUIRE(translator.handleDeepLRequest(bookTags, chapters, "test-key") == 0);
+
+    std::string first = translator.readChapterFile("export/OEBPS/Text/chapter1.xhtml");
+    std::string second = translator.readChapterFile("export/OEBPS/Text/chapter2.xhtml");
+    std::string third = translator.readChapterFile("export/OEBPS/Text/chapter3.xhtml");
+    REQUIRE(first.find("<p>最初の段落 (local)</p>") != std::string::npos);
+    REQUIRE(first.find("Already English</p>") != std::string::npos);
+    REQUIRE(second.find("<img src=\"../Images/cover.jpg\" alt=\"\"/>") != std::string::npos);
+    REQUIRE(third.find("<p>三番目の章 (local)</p>") != std::string::npos);
+
+    std::filesystem::remove_all("export");
+    std::filesystem::remove_all("testHTML");
+    std::filesystem::remove_all("translatedHTML");
+}
+#endif
+
+TEST_CASE("DeepLPollPolicy: interprets status responses and picks delays") {
+    DeepLPollPolicy::Settings settings;
+    settings.initialDelay = std::chrono::milliseconds(1000);
+    settings.maxDelay = std::chrono::milliseconds(8000);
+    settings.maxTransientFailures = 2;
+
+    auto makeResponse = [](long httpStatus, const std::string& body) {
+        DeepLResponse response;
+        response.httpStatus = httpStatus;
+        response.body = body;
+        return response;
+    };
+
+    SECTION("Maps DeepL states to outcomes") {
+        REQUIRE(DeepLPollPolicy::interpret(makeResponse(200, "{\"status\":\"done\"}")).outcome == DeepLPollPolicy::Outcome::Done);
+        REQUIRE(DeepLPollPolicy::interpret(makeResponse(200, "{\"status\":\"queued\"}")).outcome == DeepLPollPolicy::Outcome::InProgress);
+        REQUIRE(DeepLPollPolicy::interpret(makeResponse(200, "{\"status\":\"error\",\"error_message\":\"bad file\"}")).message == "bad file");
+        REQUIRE(DeepLPollPolicy::interpret(makeResponse(403, "{\"message\":\"Forbidden\"}")).outcome == DeepLPollPolicy::Outcome::Failed);
+
+        DeepLPollPolicy::Status status = DeepLPollPolicy::interpret(makeResponse(200, "{\"status\":\"translating\",\"seconds_remaining\":3}"));
+        REQUIRE(status.outcome == DeepLPollPolicy::Outcome::InProgress);
+        REQUIRE(status.secondsRemaining.has_value());
+        REQUIRE(*status.secondsRemaining == 3);
+    }
+
+    SECTION("Treats gateway errors and garbage bodies as transient") {
+        REQUIRE(DeepLPollPolicy::interpret(makeResponse(503, "<html>oops</html>")).outcome == DeepLPollPolicy::Outcome::Transient);
+        REQUIRE(DeepLPollPolicy::interpret(makeResponse(429, "")).outcome == DeepLPollPolicy::Outcome::Transient);
+        REQUIRE(DeepLPollPolicy::interpret(makeResponse(200, "not json")).outcome == DeepLPollPolicy::Outcome::Transient);
+
+        DeepLResponse timedOut;
+        timedOut.curlCode = CURLE_OPERATION_TIMEDOUT;
+        REQUIRE(DeepLPollPolicy::interpret(timedOut).outcome == DeepLPollPolicy::Outcome::Transient);
+    }
+
+    SECTION("Follows seconds_remaining within the configured bounds") {
+        DeepLPollPolicy policy(settings);
+        DeepLPollPolicy::Status status;
+        status.outcome = DeepLPollPolicy::Outcome::InProgress;
+
+        status.secondsRemaining = 3;
+        REQUIRE(policy.nextDelay(status) == std::chrono::milliseconds(3000));
+        status.secondsRemaining = 0;
+        REQUIRE(policy.nextDelay(status) == settings.initialDelay);
+        status.secondsRemaining = 600;
+        REQUIRE(policy.nextDelay(status) == settings.maxDelay);
+    }
+
+    SECTION("Backs off exponentially with jitter") {
+        DeepLPollPolicy policy(settings);
+        DeepLPollPolicy::Status status;
+        status.outcome = DeepLPollPolicy::Outcome::InProgress;
+
+        long long expected = 1000;
+        for (int i = 0; i < 6; ++i) {
+            auto delay = policy.nextDelay(status);
+            REQUIRE(delay.has_value());
+            REQUIRE(delay->count() >= expected / 2);
+            REQUIRE(delay->count() <= expected);
+            expected = std::min<long long>(expected * 2, 8000);
+        }
+    }
+
+    SECTION("Stops after too many transient failures or the timeout") {
+        DeepLPollPolicy policy(settings);
+        DeepLPollPolicy::Status transient;
+        transient.outcome = DeepLPollPolicy::Outcome::Transient;
+
+        REQUIRE(policy.nextDelay(transient).has_value());
+        REQUIRE(policy.nextDelay(transient).has_value());
+        REQUIRE_FALSE(policy.nextDelay(transient).has_value());
+
+        settings.timeout = std::chrono::milliseconds(0);
+        DeepLPollPolicy expired(settings);
+        DeepLPollPolicy::Status inProgress;
+        inProgress.outcome = DeepLPollPolicy::Outcome::InProgress;
+        REQUIRE_FALSE(expired.nextDelay(inProgress).has_value());
+    }
+}
+
+TEST_CASE("DeepLClient: concurrent requests reuse connections") {
+    MockDeepLServer server(1);
+    DeepLClient& client = DeepLClient::shared();
+
+    SECTION("Unknown documents come back as 404 without a transport error") {
+        DeepLResponse response = client.postJson(server.documentUrl() + "/unknown", "test-key", "{\"document_key\":\"x\"}").get();
+        REQUIRE(response.curlCode == CURLE_OK);
+        REQUIRE(response.httpStatus == 404);
+        REQUIRE_FALSE(response.ok());
+    }
+
+    SECTION("Many requests in flight at once all resolve") {
+        std::vector<std::future<DeepLResponse>> pending;
+        for (int i = 0; i < 20; ++i) {
+            pending.push_back(client.postJson(server.documentUrl() + "/unknown", "test-key", "{}"));
+        }
+        for (auto& future : pending) {
+            REQUIRE(future.get().httpStatus == 404);
+        }
+    }
+
+    SECTION("Back to back requests stay on one connection") {
+        for (int i = 0; i < 5; ++i) {
+            REQUIRE(client.postJson(server.documentUrl() + "/unknown", "test-key", "{}").get().httpStatus == 404);
+        }
+        REQUIRE(server.connectionCount() == 1);
+    }
+}
+
+TEST_CASE("DeepLClient: a server that never answers times out") {
+    // Connections complete in the listen backlog but nothing ever reads them
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::acceptor silent(io, boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    const std::string url = "http://127.0.0.1:" + std::to_string(silent.local_endpoint().port()) + "/v2/document/stalled";
+
+    SECTION("A stalled transfer is aborted") {
+        DeepLPollPolicy::Settings settings;
+        settings.connectTimeout = std::chrono::milliseconds(1000);
+        settings.stallTimeout = std::chrono::milliseconds(1000);
+        DeepLResponse response = DeepLClient::shared().postJson(url, "test-key", "{}", settings.transferLimits()).get();
+        REQUIRE(response.curlCode == CURLE_OPERATION_TIMEDOUT);
+        REQUIRE(DeepLPollPolicy::interpret(response).outcome == DeepLPollPolicy::Outcome::Transient);
+    }
+
+    SECTION("The whole transfer is capped") {
+        DeepLTransferLimits limits;
+        limits.stallTimeout = std::chrono::milliseconds(0);
+        limits.timeout = std::chrono::milliseconds(500);
+        DeepLResponse response = DeepLClient::shared().postJson(url, "test-key", "{}", limits).get();
+        REQUIRE(response.curlCode == CURLE_OPERATION_TIMEDOUT);
+    }
+}
+
 // ------ GUI -------
 
 TEST_CASE("GUI: Font Loading") {
@@ -1346,6 +1862,18 @@ TEST_CASE("PDFTranslator: Extract Text from PDF") {
     REQUIRE_NOTHROW(translator.extractTextFromPDF(inputPath, outputPath));
     REQUIRE(std::filesystem::exists(outputPath));
 
+    SECTION("Each text block ends with a newline") {
+        std::ifstream textFile(outputPath, std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(textFile)), std::istreambuf_iterator<char>());
+        REQUIRE_FALSE(text.empty());
+        REQUIRE(text.back() == '\n');
+        REQUIRE(text.find("\n\n") == std::string::npos);
+
+        for (std::string_view sentence : translator.splitJapaneseSpans(text)) {
+            REQUIRE(sentence.find('\n') == std::string_view::npos);
+        }
+    }
+
     // Clean up
     std::filesystem::remove(outputPath);
 }
@@ -1402,6 +1930,173 @@ TEST_CASE("PDFTranslator: Convert PDF to Images") {
     std::filesystem::remove_all(outputDir);
 }
 
+TEST_CASE("PDFTranslator: extractTextAndImagesFromPDF") {
+    TestablePDFTranslator translator;
+    // sample.pdf has no text layer, the text is checked on lorem-ipsum.pdf
+    std::string inputPath = std::filesystem::absolute("../test_files/lorem-ipsum.pdf").string();
+    std::string imageInputPath = std::filesystem::absolute("../test_files/sample.pdf").string();
+    std::string outputDir = std::filesystem::absolute("../test_files/single_pass_images").string();
+    std::string textPath = "singlePassText.txt";
+    std::string referenceTextPath = "singlePassReference.txt";
+
+    if (std::filesystem::exists(outputDir)) {
+        std::filesystem::remove_all(outputDir);
+    }
+
+    REQUIRE_NOTHROW(translator.extractTextAndImagesFromPDF(inputPath, textPath, outputDir, 0.0f));
+    REQUIRE_NOTHROW(translator.extractTextFromPDF(inputPath, referenceTextPath));
+
+    SECTION("Text matches the text-only extraction") {
+        std::ifstream textFile(textPath, std::ios::binary);
+        std::ifstream referenceFile(referenceTextPath, std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(textFile)), std::istreambuf_iterator<char>());
+        std::string reference((std::istreambuf_iterator<char>(referenceFile)), std::istreambuf_iterator<char>());
+        REQUIRE_FALSE(text.empty());
+        REQUIRE(text == reference);
+    }
+
+    SECTION("Extracting into memory gives the same text") {
+        std::ifstream referenceFile(referenceTextPath, std::ios::binary);
+        std::string reference((std::istreambuf_iterator<char>(referenceFile)), std::istreambuf_iterator<char>());
+        std::ostringstream text;
+        REQUIRE_NOTHROW(translator.extractTextAndImagesFromPDF(inputPath, text, outputDir, 0.0f));
+        REQUIRE(text.str() == reference);
+    }
+
+    SECTION("Kept pages are written as images") {
+        std::ostringstream text;
+        REQUIRE_NOTHROW(translator.extractTextAndImagesFromPDF(imageInputPath, text, outputDir, 0.0f));
+        size_t imageCount = 0;
+        for (const auto& entry : std::filesystem::directory_iterator(outputDir)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".png") {
+                ++imageCount;
+            }
+        }
+        REQUIRE(imageCount > 0);
+    }
+
+    std::filesystem::remove_all(outputDir);
+    std::filesystem::remove(textPath);
+    std::filesystem::remove(referenceTextPath);
+}
+
+TEST_CASE("PDFTranslator: page image output formats") {
+    TestablePDFTranslator translator;
+    std::string inputPath = std::filesystem::absolute("../test_files/sample.pdf").string();
+    std::string outputDir = std::filesystem::absolute("../test_files/format_images").string();
+
+    if (std::filesystem::exists(outputDir)) {
+        std::filesystem::remove_all(outputDir);
+    }
+
+    auto countExtension = [&](const std::string& extension) {
+        size_t count = 0;
+        for (const auto& entry : std::filesystem::directory_iterator(outputDir)) {
+            if (entry.is_regular_file() && entry.path().extension() == extension) {
+                ++count;
+            }
+        }
+        return count;
+    };
+
+    SECTION("JPEG output can be read back for the output PDF") {
+        translator.setPageImageOutput(PageImageFormat::Jpeg, -1, 85);
+        REQUIRE_NOTHROW(translator.convertPdfToImages(inputPath, outputDir, 0.0f));
+        REQUIRE(countExtension(".jpg") > 0);
+        REQUIRE(countExtension(".png") == 0);
+
+        for (const auto& entry : std::filesystem::directory_iterator(outputDir)) {
+            cairo_surface_t* surface = translator.loadImageSurface(entry.path().string());
+            REQUIRE(cairo_surface_status(surface) == CAIRO_STATUS_SUCCESS);
+            REQUIRE(cairo_image_surface_get_width(surface) > 0);
+            cairo_surface_destroy(surface);
+        }
+    }
+
+    SECTION("JPEG pages are embedded in the output PDF without re-encoding") {
+        translator.setPageImageOutput(PageImageFormat::Jpeg, -1, 85);
+        REQUIRE_NOTHROW(translator.convertPdfToImages(inputPath, outputDir, 0.0f));
+
+        std::uintmax_t jpegBytes = 0;
+        std::string firstJpeg;
+        for (const auto& entry : std::filesystem::directory_iterator(outputDir)) {
+            jpegBytes += std::filesystem::file_size(entry.path());
+            if (firstJpeg.empty() || entry.path().string() < firstJpeg) {
+                firstJpeg = entry.path().string();
+            }
+        }
+        REQUIRE(jpegBytes > 0);
+
+        cairo_surface_t* surface = translator.loadImageSurface(firstJpeg);
+        const unsigned char* mimeData = nullptr;
+        unsigned long mimeLength = 0;
+        cairo_surface_get_mime_data(surface, CAIRO_MIME_TYPE_JPEG, &mimeData, &mimeLength);
+        REQUIRE(mimeData != nullptr);
+        REQUIRE(mimeLength == std::filesystem::file_size(firstJpeg));
+        cairo_surface_destroy(surface);
+
+        // Only the JPEG streams and a little PDF structure, not the decoded pixels
+        const std::string outputPdf = "test_embedded_jpeg.pdf";
+        translator.createPDF(outputPdf, std::vector<std::string>{}, outputDir);
+        REQUIRE(std::filesystem::file_size(outputPdf) < jpegBytes + 64 * 1024);
+
+        SECTION("A page that is one JPEG is saved from its original stream") {
+            std::string roundTripDir = outputDir + "_round_trip";
+            std::filesystem::remove_all(roundTripDir);
+            translator.setPageImageOutput(PageImageFormat::Png);
+            REQUIRE_NOTHROW(translator.convertPdfToImages(outputPdf, roundTripDir, 0.0f));
+
+            std::ifstream original(firstJpeg, std::ios::binary);
+            std::ifstream saved(roundTripDir + "/page_001.jpg", std::ios::binary);
+            REQUIRE(saved.is_open());
+            std::string originalBytes((std::istreambuf_iterator<char>(original)), std::istreambuf_iterator<char>());
+            std::string savedBytes((std::istreambuf_iterator<char>(saved)), std::istreambuf_iterator<char>());
+            REQUIRE(savedBytes == originalBytes);
+
+            std::filesystem::remove_all(roundTripDir);
+        }
+
+        std::filesystem::remove(outputPdf);
+    }
+
+    SECTION("PNG with an explicit compression level") {
+        translator.setPageImageOutput(PageImageFormat::Png, 1);
+        REQUIRE_NOTHROW(translator.convertPdfToImages(inputPath, outputDir, 0.0f));
+        REQUIRE(countExtension(".png") > 0);
+        REQUIRE(countExtension(".jpg") == 0);
+    }
+
+    std::filesystem::remove_all(outputDir);
+}
+
+TEST_CASE("PDFTranslator: isPhotographic and flattenOntoWhite") {
+    SECTION("Black text on white is not photographic") {
+        std::vector<unsigned char> rgb(64 * 64 * 3, 255);
+        std::fill(rgb.begin(), rgb.begin() + 64 * 3 * 8, 0);
+        REQUIRE_FALSE(TestablePDFTranslator::isPhotographic(rgb.data(), 64, 64, 3, 64 * 3));
+    }
+
+    SECTION("A colour gradient is photographic") {
+        std::vector<unsigned char> rgb(64 * 64 * 3);
+        for (int y = 0; y < 64; ++y) {
+            for (int x = 0; x < 64; ++x) {
+                unsigned char* pixel = rgb.data() + (y * 64 + x) * 3;
+                pixel[0] = static_cast<unsigned char>(x * 4);
+                pixel[1] = static_cast<unsigned char>(y * 4);
+                pixel[2] = static_cast<unsigned char>((x * y * 7) & 0xff);
+            }
+        }
+        REQUIRE(TestablePDFTranslator::isPhotographic(rgb.data(), 64, 64, 3, 64 * 3));
+    }
+
+    SECTION("Transparent pixels become white, opaque ones keep their colour") {
+        // Premultiplied RGBA: one transparent pixel, one opaque red, one half covered black
+        unsigned char rgba[] = {0, 0, 0, 0, 255, 0, 0, 255, 0, 0, 0, 128};
+        std::vector<unsigned char> rgb = TestablePDFTranslator::flattenOntoWhite(rgba, 3, 1, 4, sizeof(rgba));
+        REQUIRE(rgb == std::vector<unsigned char>{255, 255, 255, 255, 0, 0, 127, 127, 127});
+    }
+}
+
 TEST_CASE("PDFTranslator: Create PDF") {
     TestablePDFTranslator translator;
     std::string inputTextFile = std::filesystem::absolute("./input_text.txt").string();
@@ -1449,6 +2144,127 @@ TEST_CASE("PDFTranslator: isImageAboveThreshold") {
     }
 }
 
+TEST_CASE("PDFTranslator: grayscaleStdDev") {
+    SECTION("Uniform image has no deviation") {
+        std::vector<unsigned char> gray(64 * 32, 200);
+        REQUIRE(TestablePDFTranslator::grayscaleStdDev(gray.data(), 64, 32, 1, 64) == 0.0);
+    }
+
+    SECTION("Half black, half white grayscale image") {
+        std::vector<unsigned char> gray(64 * 32, 0);
+        std::fill(gray.begin() + gray.size() / 2, gray.end(), 255);
+        REQUIRE(std::abs(TestablePDFTranslator::grayscaleStdDev(gray.data(), 64, 32, 1, 64) - 127.5) < 1e-9);
+    }
+
+    SECTION("RGBA samples use the luma weights and respect the stride") {
+        // Two pixels per row plus padding that must be ignored
+        const int stride = 2 * 4 + 3;
+        std::vector<unsigned char> rgba(stride * 2, 99);
+        for (int y = 0; y < 2; ++y) {
+            unsigned char* row = rgba.data() + y * stride;
+            row[0] = 255; row[1] = 255; row[2] = 255; row[3] = 255;  // gray 255
+            row[4] = 0;   row[5] = 0;   row[6] = 0;   row[7] = 255;  // gray 0
+        }
+        REQUIRE(std::abs(TestablePDFTranslator::grayscaleStdDev(rgba.data(), 2, 2, 4, stride) - 127.5) < 1e-9);
+    }
+
+    SECTION("Empty input") {
+        REQUIRE(TestablePDFTranslator::grayscaleStdDev(nullptr, 0, 0, 1, 0) == 0.0);
+    }
+
+    SECTION("Mean is reported alongside the deviation") {
+        std::vector<unsigned char> gray(64 * 32, 0);
+        std::fill(gray.begin() + gray.size() / 2, gray.end(), 255);
+        double mean = 0.0;
+        TestablePDFTranslator::grayscaleStdDev(gray.data(), 64, 32, 1, 64, &mean);
+        REQUIRE(std::abs(mean - 127.5) < 1e-9);
+    }
+}
+
+TEST_CASE("PDFTranslator: isPixmapAboveThreshold") {
+    TestablePDFTranslator translator;
+    fz_context* ctx = translator.createMuPDFContext();
+
+    fz_irect bbox = {0, 0, 32, 32};
+    fz_pixmap* pixmap = fz_new_pixmap_with_bbox(ctx, fz_device_rgb(ctx), bbox, nullptr, 1);
+    fz_clear_pixmap_with_value(ctx, pixmap, 255);
+
+    SECTION("Blank page is below threshold") {
+        REQUIRE_FALSE(translator.isPixmapAboveThreshold(ctx, pixmap, 1.0f));
+    }
+
+    SECTION("Page with contrast is above threshold") {
+        unsigned char* samples = fz_pixmap_samples(ctx, pixmap);
+        ptrdiff_t stride = fz_pixmap_stride(ctx, pixmap);
+        for (int y = 0; y < 16; ++y) {
+            std::fill(samples + y * stride, samples + (y + 1) * stride, 0);
+        }
+        REQUIRE(translator.isPixmapAboveThreshold(ctx, pixmap, 50.0f));
+    }
+
+    fz_drop_pixmap(ctx, pixmap);
+    fz_drop_context(ctx);
+}
+
+TEST_CASE("PDFTranslator: isPageImageCandidate") {
+    TestablePDFTranslator translator;
+    fz_context* ctx = translator.createMuPDFContext();
+    fz_document* doc = fz_open_document(ctx, "../test_files/blank.pdf");
+    REQUIRE(doc != nullptr);
+    fz_page* page = fz_load_page(ctx, doc, 0);
+    fz_display_list* list = fz_new_display_list_from_page(ctx, page);
+
+    SECTION("Blank page is ruled out from the thumbnail") {
+        REQUIRE_FALSE(translator.isPageImageCandidate(ctx, list, 50.0f));
+    }
+
+    SECTION("A zero threshold keeps every page") {
+        REQUIRE(translator.isPageImageCandidate(ctx, list, 0.0f));
+    }
+
+    fz_drop_display_list(ctx, list);
+    fz_drop_page(ctx, page);
+    fz_drop_document(ctx, doc);
+    fz_drop_context(ctx);
+}
+
+TEST_CASE("PDFTranslator: isPageImageCandidate keeps halftone pages") {
+    TestablePDFTranslator translator;
+    fz_context* ctx = translator.createMuPDFContext();
+
+    // A page covered by a fine checkerboard, the way screentone or a halftone
+    // print looks, averages to flat gray in the thumbnail
+    const int width = 612;
+    const int height = 792;
+    fz_pixmap* tone = fz_new_pixmap(ctx, fz_device_gray(ctx), width, height, nullptr, 0);
+    unsigned char* samples = fz_pixmap_samples(ctx, tone);
+    ptrdiff_t stride = fz_pixmap_stride(ctx, tone);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            samples[y * stride + x] = ((x / 2 + y / 2) % 2) ? 255 : 0;
+        }
+    }
+    fz_image* image = fz_new_image_from_pixmap(ctx, tone, nullptr);
+    fz_drop_pixmap(ctx, tone);
+
+    fz_rect pageRect = {0, 0, static_cast<float>(width), static_cast<float>(height)};
+    fz_display_list* list = fz_new_display_list(ctx, pageRect);
+    fz_device* dev = fz_new_list_device(ctx, list);
+    fz_fill_image(ctx, dev, image, fz_scale(width, height), 1.0f, fz_default_color_params);
+    fz_close_device(ctx, dev);
+    fz_drop_device(ctx, dev);
+    fz_drop_image(ctx, image);
+
+    fz_pixmap* fullRender = fz_new_pixmap_from_display_list(ctx, list, fz_identity, fz_device_rgb(ctx), 1);
+    REQUIRE(translator.isPixmapAboveThreshold(ctx, fullRender, 50.0f));
+    fz_drop_pixmap(ctx, fullRender);
+
+    REQUIRE(translator.isPageImageCandidate(ctx, list, 50.0f));
+
+    fz_drop_display_list(ctx, list);
+    fz_drop_context(ctx);
+}
+
 TEST_CASE("PDFTranslator: splitLongSentences") {
     TestablePDFTranslator translator;
     
@@ -1480,6 +2296,86 @@ TEST_CASE("PDFTranslator: splitLongSentences") {
     }
 }
 
+TEST_CASE("PDFTranslator: splitJapaneseSpans") {
+    TestablePDFTranslator translator;
+
+    SECTION("Spans cover the source text in order without copying it") {
+        std::string text = "「そうだ。」と言った。しかし、彼は来なかった！ Why? 本当に？終わり";
+        auto spans = translator.splitJapaneseSpans(text, 300);
+
+        std::string joined;
+        for (std::string_view span : spans) {
+            REQUIRE(span.data() >= text.data());
+            REQUIRE(span.data() + span.size() <= text.data() + text.size());
+            joined += span;
+        }
+        REQUIRE(joined == text);
+        REQUIRE(spans[0] == "「そうだ。」と言った。");
+        REQUIRE(spans[1] == "しかし、彼は来なかった！");
+        REQUIRE(spans.back() == "終わり");
+    }
+
+    SECTION("Matches the string results") {
+        std::string text = "これは非常に長い文章で区切り文字がないため強制的に分割されるべきです。短い文。そして、また長い文章が続きますがここで終わります";
+        auto spans = translator.splitJapaneseSpans(text, 20);
+        auto sentences = translator.splitJapaneseText(text, 20);
+        REQUIRE(spans.size() == sentences.size());
+        for (size_t i = 0; i < spans.size(); ++i) {
+            REQUIRE(spans[i] == sentences[i]);
+        }
+    }
+
+    SECTION("Text block boundaries end a sentence") {
+        std::string text = "見出し\n本文です。続き\n「閉じない引用\n次の文。";
+        auto spans = translator.splitJapaneseSpans(text, 300);
+        REQUIRE(spans == std::vector<std::string_view>{"見出し", "本文です。", "続き", "「閉じない引用", "次の文。"});
+    }
+
+    SECTION("A truncated character at the end is dropped") {
+        std::string text = "文です。途中";
+        text += "\xE3\x81";
+        auto sentences = translator.splitJapaneseText(text, 300);
+        REQUIRE(sentences == std::vector<std::string>{"文です。", "途中"});
+    }
+
+    SECTION("Invalid lead bytes still throw") {
+        std::string text = "文です";
+        text += "\x80";
+        REQUIRE_THROWS_AS(translator.splitJapaneseText(text, 300), std::runtime_error);
+    }
+}
+
+TEST_CASE("PDFTranslator: sentence splitter benchmark", "[.][benchmark]") {
+    TestablePDFTranslator translator;
+
+    std::string text;
+    while (text.size() < 4 * 1024 * 1024) {
+        text += "これは長い文章です、しかし途中で区切るべきです。「引用の中の文。」そして適切に分割されることを期待します！ Some ASCII text. ";
+    }
+
+    BENCHMARK("splitJapaneseText on 4 MB") {
+        return translator.splitJapaneseText(text, 300);
+    };
+
+    BENCHMARK("splitJapaneseSpans on 4 MB") {
+        return translator.splitJapaneseSpans(text, 300);
+    };
+}
+
+TEST_CASE("PDFTranslator: text extraction benchmark", "[.][benchmark]") {
+    TestablePDFTranslator translator;
+    translator.setExtractionThreads(1);
+    std::string inputPath = std::filesystem::absolute("../test_files/lorem-ipsum.pdf").string();
+
+    BENCHMARK("extractTextFromPDF into memory") {
+        std::ostringstream text;
+        fz_context* ctx = translator.createMuPDFContext();
+        translator.processPDF(ctx, inputPath, text);
+        fz_drop_context(ctx);
+        return text.str().size();
+    };
+}
+
 TEST_CASE("PDFTranslator: getUtf8CharLength") {
     TestablePDFTranslator translator;
 
@@ -1713,14 +2609,93 @@ TEST_CASE("PDFTranslator: processPDF") {
     }
 }
 
-TEST_CASE("PDFTranslator: collectImageFiles") {
+TEST_CASE("PDFTranslator: processPDF with several extraction threads") {
     TestablePDFTranslator translator;
+    fz_context* ctx = translator.createMuPDFContext();
 
-    SECTION("Positive Test - Directory with Images")
+    SECTION("Output matches sequential extraction in page order")
     {
-        // Create a temporary directory for valid images
-        auto imagesDir = std::filesystem::temp_directory_path() / "test_images_valid";
-        if (!std::filesystem::exists(imagesDir)) {
+        std::ostringstream sequential;
+        translator.setExtractionThreads(1);
+        REQUIRE_NOTHROW(translator.processPDF(ctx, "../test_files/lorem-ipsum.pdf", sequential));
+
+        std::ostringstream parallel;
+        translator.setExtractionThreads(4);
+        REQUIRE_NOTHROW(translator.processPDF(ctx, "../test_files/lorem-ipsum.pdf", parallel));
+
+        REQUIRE_FALSE(sequential.str().empty());
+        REQUIRE(parallel.str() == sequential.str());
+    }
+
+    SECTION("More threads than pages")
+    {
+        std::ostringstream sequential;
+        translator.setExtractionThreads(1);
+        REQUIRE_NOTHROW(translator.processPDF(ctx, "../test_files/lorem-ipsum.pdf", sequential));
+
+        std::ostringstream parallel;
+        translator.setExtractionThreads(64);
+        REQUIRE_NOTHROW(translator.processPDF(ctx, "../test_files/lorem-ipsum.pdf", parallel));
+
+        REQUIRE(parallel.str() == sequential.str());
+    }
+
+    fz_drop_context(ctx);
+}
+
+TEST_CASE("PDFTranslator: processPDF over page ranges") {
+    TestablePDFTranslator translator;
+    fz_context* ctx = translator.createMuPDFContext();
+    const std::string inputPath = "../test_files/lorem-ipsum.pdf";
+
+    int pageCount = 0;
+    REQUIRE_NOTHROW(pageCount = translator.countPages(ctx, inputPath));
+    REQUIRE(pageCount > 0);
+
+    std::ostringstream whole;
+    REQUIRE_NOTHROW(translator.processPDF(ctx, inputPath, whole));
+
+    SECTION("Windows of one page add up to the whole document")
+    {
+        for (size_t threads : {size_t(1), size_t(4)}) {
+            translator.setExtractionThreads(threads);
+            std::string windowed;
+            for (int page = 0; page < pageCount; ++page) {
+                std::ostringstream window;
+                REQUIRE_NOTHROW(translator.processPDF(ctx, inputPath, window, PageProcessingOptions(), nullptr, page, page + 1));
+                windowed += window.str();
+            }
+            REQUIRE(windowed == whole.str());
+        }
+    }
+
+    SECTION("Ranges past the last page are clamped")
+    {
+        std::ostringstream window;
+        REQUIRE_NOTHROW(translator.processPDF(ctx, inputPath, window, PageProcessingOptions(), nullptr, 0, pageCount + 10));
+        REQUIRE(window.str() == whole.str());
+
+        std::ostringstream empty;
+        REQUIRE_NOTHROW(translator.processPDF(ctx, inputPath, empty, PageProcessingOptions(), nullptr, pageCount, pageCount + 1));
+        REQUIRE(empty.str().empty());
+    }
+
+    SECTION("countPages fails for a missing file")
+    {
+        REQUIRE_THROWS_AS(translator.countPages(ctx, "../test_files/does_not_exist.pdf"), std::runtime_error);
+    }
+
+    fz_drop_context(ctx);
+}
+
+TEST_CASE("PDFTranslator: collectImageFiles") {
+    TestablePDFTranslator translator;
+
+    SECTION("Positive Test - Directory with Images")
+    {
+        // Create a temporary directory for valid images
+        auto imagesDir = std::filesystem::temp_directory_path() / "test_images_valid";
+        if (!std::filesystem::exists(imagesDir)) {
             std::filesystem::create_directories(imagesDir);
         }
 
@@ -1748,6 +2723,24 @@ TEST_CASE("PDFTranslator: collectImageFiles") {
 
     }
 
+    SECTION("Pages past 999 stay in page order")
+    {
+        auto imagesDir = std::filesystem::temp_directory_path() / "test_images_order";
+        std::filesystem::create_directories(imagesDir);
+        for (const char* name : {"page_1000.png", "page_999.png", "page_101.png", "page_002.png"}) {
+            std::ofstream((imagesDir / name).string(), std::ios::binary) << "DUMMY_PNG_DATA";
+        }
+
+        auto imageFiles = translator.collectImageFiles(imagesDir.string());
+        REQUIRE(imageFiles.size() == 4);
+        REQUIRE(std::filesystem::path(imageFiles[0]).filename() == "page_002.png");
+        REQUIRE(std::filesystem::path(imageFiles[1]).filename() == "page_101.png");
+        REQUIRE(std::filesystem::path(imageFiles[2]).filename() == "page_999.png");
+        REQUIRE(std::filesystem::path(imageFiles[3]).filename() == "page_1000.png");
+
+        std::filesystem::remove_all(imagesDir);
+    }
+
     SECTION("Negative Test - Nonexistent Directory")
     {
         // We intentionally don't create this directory, so it doesn't exist
@@ -1895,6 +2888,382 @@ TEST_CASE("PDFTranslator: createPDF") {
     }
 }
 
+TEST_CASE("TextLayout: breakLines") {
+    // One unit per character keeps the expected widths easy to count
+    size_t measureCalls = 0;
+    TextLayout layout([&measureCalls](const std::string& token) {
+        ++measureCalls;
+        double width = 0.0;
+        for (unsigned char c : token) {
+            if ((c & 0xC0) != 0x80) {
+                width += 1.0;
+            }
+        }
+        return width;
+    });
+
+    SECTION("Fills each line greedily") {
+        std::string text = "the quick brown fox jumps over the lazy dog";
+        auto lines = layout.breakLines(text, 15.0);
+        REQUIRE(lines == std::vector<std::string_view>{"the quick brown", "fox jumps over", "the lazy dog"});
+    }
+
+    SECTION("Lines are views into the paragraph without surrounding whitespace") {
+        std::string text = "  leading   and trailing  ";
+        auto lines = layout.breakLines(text, 100.0);
+        REQUIRE(lines.size() == 1);
+        REQUIRE(lines[0] == "leading   and trailing");
+        REQUIRE(lines[0].data() == text.data() + 2);
+    }
+
+    SECTION("Each distinct word is measured once") {
+        std::string text;
+        for (int i = 0; i < 1000; ++i) {
+            text += "alpha beta gamma ";
+        }
+        layout.breakLines(text, 40.0);
+        // Three words and the space
+        REQUIRE(measureCalls == 4);
+        REQUIRE(layout.measuredTokenCount() == 4);
+    }
+
+    SECTION("A word wider than the line gets a line of its own") {
+        std::string text = "a extraordinarily b";
+        auto lines = layout.breakLines(text, 5.0);
+        REQUIRE(lines == std::vector<std::string_view>{"a", "extraordinarily", "b"});
+    }
+
+    SECTION("CJK text breaks between characters") {
+        std::string text = "日本語の文章です";
+        auto lines = layout.breakLines(text, 3.0);
+        REQUIRE(lines == std::vector<std::string_view>{"日本語", "の文章", "です"});
+    }
+
+    SECTION("Closing punctuation never starts a line and opening punctuation never ends one") {
+        std::string text = "ああ。「いい」";
+        auto lines = layout.breakLines(text, 4.0);
+        REQUIRE(lines == std::vector<std::string_view>{"ああ。", "「いい」"});
+    }
+
+    SECTION("Latin words inside CJK text stay whole") {
+        std::string text = "日本PDF変換";
+        auto lines = layout.breakLines(text, 4.0);
+        REQUIRE(lines == std::vector<std::string_view>{"日本", "PDF変", "換"});
+    }
+
+    SECTION("Empty and blank paragraphs produce no lines") {
+        REQUIRE(layout.breakLines("", 10.0).empty());
+        REQUIRE(layout.breakLines("   ", 10.0).empty());
+    }
+}
+
+TEST_CASE("FontManager: glyph runs") {
+    FontManager fonts("../fonts", 12.0);
+    REQUIRE(fonts.hasFonts());
+
+    SECTION("CJK text is mapped to real glyphs") {
+        const auto& run = fonts.glyphRun("日本語");
+        REQUIRE(run.glyphs.size() == 3);
+        for (const auto& glyph : run.glyphs) {
+            REQUIRE(glyph.index != 0);
+        }
+        REQUIRE(run.advance > 0.0);
+        REQUIRE(run.glyphs[1].x > run.glyphs[0].x);
+    }
+
+    SECTION("Each distinct word is converted once") {
+        const auto& first = fonts.glyphRun("translation");
+        const auto& second = fonts.glyphRun("translation");
+        REQUIRE(&first == &second);
+        REQUIRE(fonts.cachedRunCount() == 1);
+        REQUIRE(fonts.advance("translation") == first.advance);
+    }
+
+    SECTION("Lines are cached per layout token and whitespace is never drawn") {
+        cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 200, 50);
+        cairo_t* cr = cairo_create(surface);
+
+        // The space run, then 日, 本, 語 and の
+        fonts.showText(cr, 0, 20, "日本語の本");
+        REQUIRE(fonts.cachedRunCount() == 5);
+
+        // Same tokens, separated by a tab and a newline
+        fonts.showText(cr, 0, 40, "本\t日本\n語");
+        REQUIRE(fonts.cachedRunCount() == 5);
+
+        cairo_destroy(cr);
+        cairo_surface_destroy(surface);
+    }
+
+    SECTION("A missing directory loads no fonts") {
+        FontManager missing("../does_not_exist", 12.0);
+        REQUIRE_FALSE(missing.hasFonts());
+        REQUIRE(missing.fontCount() == 0);
+    }
+}
+
+TEST_CASE("PDFTranslator: addTextToPdf reuses the fonts and measurements it is given") {
+    TestablePDFTranslator translator;
+    const std::string outputPdf = "test_reflow_reuse.pdf";
+    auto [surface, cr] = translator.initCairoPdfSurface(outputPdf, 612, 792);
+    translator.configureTextRendering(cr, "Helvetica", 12);
+
+    FontManager fonts("../fonts", 12);
+    TextLayout layout = TestablePDFTranslator::reflowLayout(fonts, cr);
+
+    // Two windows of the same words, the second one measures nothing new
+    const std::vector<std::string> window = {"翻訳された 文章 translated text", "translated 文章"};
+    double y = translator.addTextToPdf(cr, surface, fonts, layout, window, 612, 792, 72, 2, 12, 72);
+    const size_t measured = layout.measuredTokenCount();
+    const size_t runs = fonts.cachedRunCount();
+    REQUIRE(measured > 0);
+
+    translator.addTextToPdf(cr, surface, fonts, layout, window, 612, 792, 72, 2, 12, y);
+    REQUIRE(layout.measuredTokenCount() == measured);
+    REQUIRE(fonts.cachedRunCount() == runs);
+
+    translator.cleanupCairo(cr, surface);
+    std::filesystem::remove(outputPdf);
+}
+
+TEST_CASE("PDFTranslator: createPDF layout benchmark", "[.][benchmark]") {
+    TestablePDFTranslator translator;
+    auto imagesDir = std::filesystem::temp_directory_path() / "test_images_layout_benchmark";
+    std::filesystem::create_directories(imagesDir);
+
+    // Roughly a 300k word novel
+    std::vector<std::string> paragraphs;
+    for (int i = 0; i < 3000; ++i) {
+        std::string paragraph;
+        for (int j = 0; j < 100; ++j) {
+            paragraph += "word" + std::to_string((i * 100 + j) % 5000) + " ";
+        }
+        paragraphs.push_back(paragraph);
+    }
+
+    BENCHMARK("createPDF with 300k words") {
+        translator.createPDF("layout_benchmark.pdf", paragraphs, imagesDir.string());
+        return std::filesystem::file_size("layout_benchmark.pdf");
+    };
+
+    std::filesystem::remove("layout_benchmark.pdf");
+    std::filesystem::remove_all(imagesDir);
+}
+
+TEST_CASE("PDFTranslator: createPDF from translated sentences") {
+    TestablePDFTranslator translator;
+
+    SECTION("Writes the sentences without an input file") {
+        const std::string outputPdf = "test_createPDF_sentences.pdf";
+        auto imagesDir = std::filesystem::temp_directory_path() / "test_images_sentences";
+        std::filesystem::create_directories(imagesDir);
+
+        std::vector<std::string> sentences = {"A sentence without a comma.", "Another one, with a comma."};
+        REQUIRE_NOTHROW(translator.createPDF(outputPdf, sentences, imagesDir.string()));
+
+        {
+            std::ifstream ifs(outputPdf, std::ios::ate | std::ios::binary);
+            REQUIRE(ifs.is_open());
+            REQUIRE(ifs.tellg() > 0);
+        }
+
+        std::filesystem::remove(outputPdf);
+        std::filesystem::remove_all(imagesDir);
+    }
+
+    SECTION("Japanese text embeds a subset of the bundled font") {
+        const std::string outputPdf = "test_createPDF_cjk.pdf";
+        auto imagesDir = std::filesystem::temp_directory_path() / "test_images_cjk";
+        std::filesystem::create_directories(imagesDir);
+
+        translator.setFontsDirectory("../fonts");
+        std::vector<std::string> sentences = {"日本語の文章です。", "「翻訳された」テキストと English text."};
+        REQUIRE_NOTHROW(translator.createPDF(outputPdf, sentences, imagesDir.string()));
+
+        // Only the used glyphs are embedded, not the whole font file
+        auto fontSize = std::filesystem::file_size("../fonts/NotoSansCJKjp-Regular.ttf");
+        REQUIRE(std::filesystem::file_size(outputPdf) > 0);
+        REQUIRE(std::filesystem::file_size(outputPdf) < fontSize / 4);
+
+        std::filesystem::remove(outputPdf);
+        std::filesystem::remove_all(imagesDir);
+    }
+
+    SECTION("readNumberedLines keeps the text after the first comma") {
+        auto inputFile = std::filesystem::temp_directory_path() / "numbered_lines.txt";
+        {
+            std::ofstream txt(inputFile.string());
+            txt << "1,First, sentence\nno comma here\n2,Second\n";
+        }
+
+        std::vector<std::string> texts;
+        REQUIRE(translator.readNumberedLines(inputFile.string(), texts));
+        REQUIRE(texts == std::vector<std::string>{"First, sentence", "Second"});
+
+        std::filesystem::remove(inputFile);
+    }
+
+    SECTION("readNumberedLines fails for a missing file") {
+        std::vector<std::string> texts;
+        REQUIRE_FALSE(translator.readNumberedLines((std::filesystem::temp_directory_path() / "does_not_exist.txt").string(), texts));
+        REQUIRE(texts.empty());
+    }
+}
+
+TEST_CASE("PDFTranslator: layout preserving output") {
+    TestablePDFTranslator translator;
+    std::string inputPath = std::filesystem::absolute("../test_files/lorem-ipsum.pdf").string();
+    const std::string outputPdf = "test_layout_preserving.pdf";
+
+    std::ostringstream text;
+    std::vector<PdfTextBlock> blocks;
+    REQUIRE_NOTHROW(translator.extractTextBlocksFromPDF(inputPath, text, blocks));
+    REQUIRE_FALSE(blocks.empty());
+
+    SECTION("Blocks are the lines of the extracted text") {
+        std::string joined;
+        for (const auto& block : blocks) {
+            REQUIRE(block.bbox.x1 > block.bbox.x0);
+            REQUIRE(block.bbox.y1 > block.bbox.y0);
+            joined += block.text + "\n";
+        }
+        REQUIRE(joined == text.str());
+    }
+
+    SECTION("Translations replace the source text on the original pages") {
+        std::vector<std::string> translations;
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            translations.push_back("Translated block " + std::to_string(i));
+        }
+        REQUIRE(translator.createLayoutPreservingPDF(inputPath, outputPdf, blocks, translations));
+
+        std::ostringstream outputText;
+        std::vector<PdfTextBlock> outputBlocks;
+        REQUIRE_NOTHROW(translator.extractTextBlocksFromPDF(outputPdf, outputText, outputBlocks));
+        REQUIRE(outputText.str().find("Translated block 0") != std::string::npos);
+        REQUIRE(outputText.str().find(blocks[0].text) == std::string::npos);
+
+        fz_context* ctx = translator.createMuPDFContext();
+        fz_document* source = fz_open_document(ctx, inputPath.c_str());
+        fz_document* output = fz_open_document(ctx, outputPdf.c_str());
+        REQUIRE(fz_count_pages(ctx, output) == fz_count_pages(ctx, source));
+        fz_drop_document(ctx, output);
+        fz_drop_document(ctx, source);
+        fz_drop_context(ctx);
+
+        std::filesystem::remove(outputPdf);
+    }
+
+    SECTION("Translations are set in the bundled font") {
+        translator.setFontsDirectory("../fonts");
+        std::vector<std::string> translations(blocks.size(), "翻訳されたブロック");
+        REQUIRE(translator.createLayoutPreservingPDF(inputPath, outputPdf, blocks, translations));
+
+        std::ostringstream outputText;
+        std::vector<PdfTextBlock> outputBlocks;
+        REQUIRE_NOTHROW(translator.extractTextBlocksFromPDF(outputPdf, outputText, outputBlocks));
+        REQUIRE(outputText.str().find("翻訳されたブロック") != std::string::npos);
+
+        std::ifstream outputFile(outputPdf, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(outputFile)), std::istreambuf_iterator<char>());
+        REQUIRE(bytes.find("Noto") != std::string::npos);
+
+        std::filesystem::remove(outputPdf);
+    }
+
+    SECTION("Needs one translation per block") {
+        REQUIRE_FALSE(translator.createLayoutPreservingPDF(inputPath, outputPdf, blocks, {}));
+        REQUIRE_FALSE(std::filesystem::exists(outputPdf));
+    }
+}
+
+TEST_CASE("PDFTranslator: each job gets its own working directory") {
+    TestablePDFTranslator translator;
+
+    std::filesystem::path first = translator.createJobDirectory();
+    std::filesystem::path second = translator.createJobDirectory();
+
+    REQUIRE_FALSE(first.empty());
+    REQUIRE_FALSE(second.empty());
+    REQUIRE(first != second);
+    REQUIRE(std::filesystem::is_directory(first));
+    REQUIRE(std::filesystem::is_directory(second));
+
+    std::filesystem::remove_all(first);
+    std::filesystem::remove_all(second);
+}
+
+#ifndef _WIN32
+TEST_CASE("PDFTranslator: translateSentencesLocally streams sentences to the worker") {
+    TestablePDFTranslator translator;
+    translator.setLocalTranslationCommand("/bin/sh", {"-c", "while IFS= read -r line; do echo \"RESULT,$line (local)\"; done"});
+
+    std::string text = "最初の文。二番目の文。";
+    std::vector<std::string_view> sentences = translator.splitJapaneseSpans(text);
+    std::vector<std::string> translated;
+
+    REQUIRE(translator.translateSentencesLocally(sentences, "eng", translated) == 0);
+    REQUIRE(translated.size() == 2);
+    REQUIRE(translated[0] == ">>eng<< 最初の文。 (local)");
+    REQUIRE(translated[1] == ">>eng<< 二番目の文。 (local)");
+}
+
+TEST_CASE("PDFTranslator: translateSentencesLocally reuses a shared worker") {
+    TestablePDFTranslator translator;
+    // Numbers every line it reads, a second process would start again at 1
+    LocalTranslationWorker worker("/bin/sh", {"-c", "n=0; while IFS= read -r line; do n=$((n+1)); echo \"RESULT,$line #$n\"; done"});
+
+    std::string text = "最初の文。二番目の文。";
+    std::vector<std::string_view> sentences = translator.splitJapaneseSpans(text);
+    std::vector<std::string> translated;
+
+    REQUIRE(translator.translateSentencesLocally(sentences, "eng", translated, &worker) == 0);
+    REQUIRE(translated[1] == ">>eng<< 二番目の文。 #2");
+    REQUIRE(worker.isRunning());
+
+    REQUIRE(translator.translateSentencesLocally(sentences, "eng", translated, &worker) == 0);
+    REQUIRE(translated.size() == 2);
+    REQUIRE(translated[0] == ">>eng<< 最初の文。 #3");
+    REQUIRE(translated[1] == ">>eng<< 二番目の文。 #4");
+    worker.finish();
+}
+
+TEST_CASE("PDFTranslator: run in page windows") {
+    TestablePDFTranslator translator;
+    translator.setLocalTranslationCommand("/bin/sh", {"-c", "while IFS= read -r line; do echo \"RESULT,$line\"; done"});
+    translator.setFontsDirectory("../fonts");
+
+    auto outputDir = std::filesystem::temp_directory_path() / "test_pdf_page_windows";
+    std::filesystem::create_directories(outputDir);
+    const auto outputPdf = outputDir / "output.pdf";
+
+    SECTION("One page at a time with a small MuPDF store")
+    {
+        translator.setPageWindow(1, 32 * 1024 * 1024);
+        REQUIRE(translator.run("../test_files/lorem-ipsum.pdf", outputDir.string(), 0, "", "eng") == 0);
+        REQUIRE(std::filesystem::file_size(outputPdf) > 0);
+    }
+
+    SECTION("Kept page images are written with their window")
+    {
+        translator.setPageWindow(2);
+        REQUIRE(translator.run("../test_files/sample.pdf", outputDir.string(), 0, "", "eng") == 0);
+        REQUIRE(std::filesystem::file_size(outputPdf) > 0);
+    }
+
+    std::filesystem::remove_all(outputDir);
+}
+
+TEST_CASE("PDFTranslator: translateSentencesLocally fails without the executable") {
+    TestablePDFTranslator translator;
+    translator.setLocalTranslationCommand("does-not-exist/translation", {"-", "2"});
+
+    std::string text = "最初の文。";
+    std::vector<std::string> translated;
+    REQUIRE(translator.translateSentencesLocally(translator.splitJapaneseSpans(text), "eng", translated) != 0);
+}
+#endif
+
 TEST_CASE("PDFTranslator: isImageFile") {
     TestablePDFTranslator translator;
 
@@ -1941,18 +3310,6 @@ TEST_CASE("escapeForDocx: Properly escapes XML special characters") {
     }
 }
 
-TEST_CASE("getNodePath: Constructs correct XPath from XML node") {
-    TestableDocxTranslator translator;
-
-    xmlDocPtr doc = xmlParseDoc(BAD_CAST "<root><child><subchild/></child></root>");
-    xmlNodePtr root = xmlDocGetRootElement(doc);
-    xmlNodePtr subchild = root->children->children;
-
-    REQUIRE(translator.getNodePath(subchild) == "/root/child/subchild");
-
-    xmlFreeDoc(doc);
-}
-
 TEST_CASE("extractTextNodes: Extracts <w:t> nodes from DOCX XML") {
     TestableDocxTranslator translator;
 
@@ -1966,7 +3323,7 @@ TEST_CASE("extractTextNodes: Extracts <w:t> nodes from DOCX XML") {
     
     xmlNodePtr root = xmlDocGetRootElement(doc);
 
-    std::vector<TextNode> nodes = translator.extractTextNodes(root);
+    std::vector<DocxTextNode> nodes = translator.extractTextNodes(root);
     // Print out the extracted nodes
     for (const auto& node : nodes) {
         std::cout << "Node: " << node.text << std::endl;
@@ -1975,6 +3332,9 @@ TEST_CASE("extractTextNodes: Extracts <w:t> nodes from DOCX XML") {
     REQUIRE(nodes.size() == 2);
     REQUIRE(nodes[0].text == "Hello");
     REQUIRE(nodes[1].text == "World");
+    // The nodes are kept in document order for reinsertion
+    REQUIRE(nodes[0].node == root->children);
+    REQUIRE(nodes[1].node == root->children->next);
 
     xmlFreeDoc(doc);
 }
@@ -1984,58 +3344,158 @@ TEST_CASE("saveTextToFile: Saves extracted text to files") {
 
     std::string langcode = "jpn";
 
-    std::vector<TextNode> nodes = {
-        {"path1", "Hello"},
-        {"path2", "World"}
-    };
+    std::vector<std::string> texts = {"Hello", "World"};
 
-    translator.saveTextToFile(nodes, "test_positions.txt", "test_texts.txt", langcode);
+    translator.saveTextToFile(texts, "test_texts.txt", langcode);
 
-    std::ifstream posFile("test_positions.txt");
     std::ifstream textFile("test_texts.txt");
 
-    std::string posLine, textLine;
-    std::getline(posFile, posLine);
+    std::string textLine;
     std::getline(textFile, textLine);
 
-    REQUIRE(posLine == "1,path1");
     REQUIRE(textLine == "1,>>jpn<< Hello");
 
-    std::getline(posFile, posLine);
     std::getline(textFile, textLine);
 
-    REQUIRE(posLine == "2,path2");
     REQUIRE(textLine == "2,>>jpn<< World");
 
-    posFile.close();
     textFile.close();
-    std::filesystem::remove("test_positions.txt");
     std::filesystem::remove("test_texts.txt");
 }
 
 TEST_CASE("loadTranslations: Loads translations from files") {
     TestableDocxTranslator translator;
 
-    // Prepare test files
-    std::ofstream posFile("test_positions.txt");
-    std::ofstream textFile("test_translations.txt");
+    SECTION("Each translation goes to the slot of its counter") {
+        std::ofstream textFile("test_translations.txt");
+        // Out of order, with a comma in the text and a missing node 3
+        textFile << "2,World, again\n1,Hello\n4,Last\n";
+        textFile.close();
 
-    posFile << "1,/root/child\n2,/root/child/subchild\n";
-    textFile << "1,Hello\n2,World\n";
+        auto translations = translator.loadTranslations("test_translations.txt", 4);
 
-    posFile.close();
-    textFile.close();
+        REQUIRE(translations == std::vector<std::string>{"Hello", "World, again", "", "Last"});
+    }
+
+    SECTION("Counters outside the extracted nodes are ignored") {
+        std::ofstream textFile("test_translations.txt");
+        textFile << "0,Zero\n1,One\n3,Three\nnot a counter,Text\n";
+        textFile.close();
 
-    auto translations = translator.loadTranslations("test_positions.txt", "test_translations.txt");
+        auto translations = translator.loadTranslations("test_translations.txt", 2);
+
+        REQUIRE(translations == std::vector<std::string>{"One", ""});
+    }
 
-    REQUIRE(translations.size() == 2);
-    REQUIRE(translations.count("/root/child") == 1);
-    REQUIRE(translations.count("/root/child/subchild") == 1);
+    SECTION("Missing file leaves every node untranslated") {
+        auto translations = translator.loadTranslations("does_not_exist_translations.txt", 2);
+        REQUIRE(translations == std::vector<std::string>{"", ""});
+    }
 
-    std::filesystem::remove("test_positions.txt");
     std::filesystem::remove("test_translations.txt");
 }
 
+TEST_CASE("DocxTranslator: paragraph segments") {
+    TestableDocxTranslator translator;
+
+    xmlDocPtr doc = xmlParseDoc(BAD_CAST
+        "<w:document xmlns:w=\"http://schemas.openxmlformats.org/wordprocessingml/2006/main\"><w:body>"
+        "<w:p><w:r><w:t>The </w:t></w:r><w:r><w:t>quick</w:t></w:r><w:r><w:t> brown fox</w:t></w:r></w:p>"
+        "<w:p><w:r><w:t>Alone</w:t></w:r></w:p>"
+        "<w:p><w:r><w:t>前半</w:t></w:r><w:r><w:t>後半です</w:t></w:r></w:p>"
+        "</w:body></w:document>");
+    REQUIRE(doc != nullptr);
+    std::vector<DocxTextNode> nodes = translator.extractTextNodes(xmlDocGetRootElement(doc));
+    REQUIRE(nodes.size() == 6);
+
+    SECTION("Runs of a paragraph become one segment") {
+        auto segments = translator.buildSegments(nodes);
+        REQUIRE(segments.size() == 3);
+        REQUIRE(segments[0].firstNode == 0);
+        REQUIRE(segments[0].nodeCount == 3);
+        REQUIRE(segments[0].text == "The quick brown fox");
+        REQUIRE(segments[1].text == "Alone");
+        REQUIRE(segments[2].firstNode == 4);
+        REQUIRE(segments[2].text == "前半後半です");
+    }
+
+    SECTION("Every run is a segment when paragraph segments are off") {
+        translator.setParagraphSegments(false);
+        auto segments = translator.buildSegments(nodes);
+        REQUIRE(segments.size() == 6);
+        REQUIRE(segments[1].text == "quick");
+    }
+
+    SECTION("Proportional distribution splits at spaces and keeps them") {
+        auto segments = translator.buildSegments(nodes);
+        auto translations = translator.distributeTranslations(nodes, segments, {"Le renard brun rapide", "", "First half second half"});
+        REQUIRE(translations.size() == 6);
+        std::string joined;
+        for (size_t i = 0; i < 3; ++i) {
+            REQUIRE(translations[i]);
+            joined += *translations[i];
+        }
+        REQUIRE(joined == "Le renard brun rapide");
+        REQUIRE(*translations[0] == "Le ");
+        // Untranslated segments keep their runs
+        REQUIRE_FALSE(translations[3]);
+        REQUIRE(*translations[4] + *translations[5] == "First half second half");
+    }
+
+    SECTION("First run distribution empties the other runs") {
+        translator.setParagraphSegments(true, DocxRunDistribution::FirstRun);
+        auto segments = translator.buildSegments(nodes);
+        auto translations = translator.distributeTranslations(nodes, segments, {"Le renard brun rapide", "Seul"});
+        REQUIRE(*translations[0] == "Le renard brun rapide");
+        REQUIRE(*translations[1] == "");
+        REQUIRE(*translations[2] == "");
+        REQUIRE(*translations[3] == "Seul");
+        REQUIRE_FALSE(translations[4]);
+    }
+
+    SECTION("Split pieces keep their spaces in the document") {
+        auto segments = translator.buildSegments(nodes);
+        auto translations = translator.distributeTranslations(nodes, segments, {"Le renard brun rapide"});
+        translator.reinsertTranslations(nodes, translations);
+        xmlChar* space = xmlGetProp(nodes[0].node, BAD_CAST "space");
+        REQUIRE(space != nullptr);
+        REQUIRE(std::string((char*)space) == "preserve");
+        xmlFree(space);
+    }
+
+    xmlFreeDoc(doc);
+}
+
+TEST_CASE("DocxTranslator: splitProportionally") {
+    TestableDocxTranslator translator;
+
+    SECTION("Equal runs get equal shares") {
+        auto pieces = translator.splitProportionally("aaa bbb ccc", {3, 3, 3});
+        REQUIRE(pieces == std::vector<std::string>{"aaa ", "bbb ", "ccc"});
+    }
+
+    SECTION("Short translations leave the later runs empty") {
+        auto pieces = translator.splitProportionally("word", {5, 5, 5});
+        std::string joined = pieces[0] + pieces[1] + pieces[2];
+        REQUIRE(joined == "word");
+        REQUIRE(pieces.size() == 3);
+    }
+
+    SECTION("Text without spaces is cut between characters") {
+        auto pieces = translator.splitProportionally("日本語です", {1, 1});
+        REQUIRE(pieces[0] + pieces[1] == "日本語です");
+        for (const auto& piece : pieces) {
+            REQUIRE_FALSE(piece.empty());
+            REQUIRE((static_cast<unsigned char>(piece[0]) & 0xC0) != 0x80);
+        }
+    }
+
+    SECTION("Runs without text get nothing") {
+        auto pieces = translator.splitProportionally("one two", {0, 4});
+        REQUIRE(pieces == std::vector<std::string>{"", "one two"});
+    }
+}
+
 TEST_CASE("updateNodeWithTranslation: Replaces text content in XML nodes") {
     TestableDocxTranslator translator;
 
@@ -2056,7 +3516,7 @@ TEST_CASE("updateNodeWithTranslation: Replaces text content in XML nodes") {
     xmlFreeDoc(doc);
 }
 
-TEST_CASE("reinsertTranslations: Replaces text nodes with translations from multimap") {
+TEST_CASE("reinsertTranslations: Replaces text nodes by their document order") {
     TestableDocxTranslator translator;
 
     // Sample XML Document (DOCX-like structure)
@@ -2079,15 +3539,19 @@ TEST_CASE("reinsertTranslations: Replaces text nodes with translations from mult
     xmlNodePtr root = xmlDocGetRootElement(doc);
     REQUIRE(root != nullptr);
 
-    // Simulated translations from a multimap
-    std::unordered_multimap<std::string, std::string> translations = {
-        {"/document/body/p/r/t", "Translated1"},
-        {"/document/body/p/r/t", "Translated2"},
-        {"/document/body/p/r/t", "Translated3"}
-    };
+    // Every w:t shares the same element path, only the ordinal tells them apart
+    std::vector<DocxTextNode> nodes = translator.extractTextNodes(root);
+    REQUIRE(nodes.size() == 3);
+    std::vector<std::optional<std::string>> translations = {"Translated1", "Translated2", "Translated3"};
 
-    // Perform the translation insertion
-    translator.reinsertTranslations(root, translations);
+    SECTION("Every node gets its own translation") {
+        translator.reinsertTranslations(nodes, translations);
+    }
+
+    SECTION("Nodes without a translation keep their text") {
+        translations[1].reset();
+        translator.reinsertTranslations(nodes, translations);
+    }
 
     // Collect the content from the nodes
     std::vector<std::string> nodeContents;
@@ -2111,7 +3575,7 @@ TEST_CASE("reinsertTranslations: Replaces text nodes with translations from mult
     // Verify that translations were inserted correctly in order
     REQUIRE(nodeContents.size() == 3);
     REQUIRE(nodeContents[0] == "Translated1");
-    REQUIRE(nodeContents[1] == "Translated2");
+    REQUIRE(nodeContents[1] == (translations[1] ? "Translated2" : "Original2"));
     REQUIRE(nodeContents[2] == "Translated3");
 
     // Clean up
@@ -2119,6 +3583,310 @@ TEST_CASE("reinsertTranslations: Replaces text nodes with translations from mult
 }
 
 
+TEST_CASE("DocxTranslator: streaming document.xml passes") {
+    TestableDocxTranslator translator;
+
+    const auto xmlPath = std::filesystem::temp_directory_path() / "streaming_document.xml";
+    const auto outputPath = std::filesystem::temp_directory_path() / "streaming_document_out.xml";
+    {
+        std::ofstream xml(xmlPath, std::ios::binary);
+        xml << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+               "<w:document xmlns:w=\"http://schemas.openxmlformats.org/wordprocessingml/2006/main\">"
+               "<w:body>"
+               "<w:p><w:pPr><w:jc w:val=\"center\"/></w:pPr><w:r><w:t>最初</w:t></w:r><w:r><w:t xml:space=\"preserve\"> &amp; 次</w:t></w:r></w:p>"
+               "<w:tbl><w:tr><w:tc><w:p><w:r><w:t>表の中</w:t></w:r></w:p></w:tc></w:tr></w:tbl>"
+               "<w:p><w:r><w:t></w:t></w:r></w:p>"
+               "<!-- comment -->"
+               "<w:p><w:r><w:t>最後</w:t></w:r></w:p>"
+               "<w:sectPr><w:pgSz w:w=\"11906\"/></w:sectPr>"
+               "</w:body>"
+               "</w:document>";
+    }
+
+    auto domTexts = [&](const std::filesystem::path& path) {
+        xmlDocPtr doc = xmlReadFile(path.string().c_str(), NULL, 0);
+        REQUIRE(doc != nullptr);
+        std::vector<std::string> texts;
+        for (const auto& node : translator.extractTextNodes(xmlDocGetRootElement(doc))) {
+            texts.push_back(node.text);
+        }
+        xmlFreeDoc(doc);
+        return texts;
+    };
+
+    SECTION("Extraction matches the DOM in document order") {
+        std::vector<DocxTextNode> nodes;
+        REQUIRE(translator.extractTextNodesStreaming(xmlPath.string(), nodes));
+
+        std::vector<std::string> texts;
+        for (const auto& node : nodes) {
+            REQUIRE(node.node == nullptr);
+            texts.push_back(node.text);
+        }
+        REQUIRE(texts == domTexts(xmlPath));
+        REQUIRE(texts == std::vector<std::string>{"最初", " & 次", "表の中", "最後"});
+    }
+
+    SECTION("Rewrite puts each translation in its element and keeps the rest") {
+        std::vector<std::optional<std::string>> translations = {"First", " &amp; next", std::nullopt, "Last"};
+        REQUIRE(translator.rewriteDocumentStreaming(xmlPath.string(), outputPath.string(), translations));
+
+        REQUIRE(domTexts(outputPath) == std::vector<std::string>{"First", " & next", "表の中", "Last"});
+
+        std::ifstream output(outputPath, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(output)), std::istreambuf_iterator<char>());
+        REQUIRE(content.rfind("<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>", 0) == 0);
+        REQUIRE(content.find("xmlns:w=\"http://schemas.openxmlformats.org/wordprocessingml/2006/main\"") != std::string::npos);
+        REQUIRE(content.find("<w:jc w:val=\"center\"/>") != std::string::npos);
+        REQUIRE(content.find("<w:tbl><w:tr><w:tc>") != std::string::npos);
+        REQUIRE(content.find("<!-- comment -->") != std::string::npos);
+        REQUIRE(content.find("<w:pgSz w:w=\"11906\"/>") != std::string::npos);
+    }
+
+    SECTION("A malformed document fails") {
+        {
+            std::ofstream xml(xmlPath, std::ios::binary);
+            xml << "<w:document xmlns:w=\"urn:w\"><w:p><w:t>text</w:t></w:document>";
+        }
+        std::vector<DocxTextNode> nodes;
+        REQUIRE_FALSE(translator.extractTextNodesStreaming(xmlPath.string(), nodes));
+        REQUIRE_FALSE(translator.rewriteDocumentStreaming(xmlPath.string(), outputPath.string(), {}));
+    }
+
+    SECTION("Matches the DOM on a real document") {
+        const std::string unzipped = "test_streaming_unzipped";
+        std::filesystem::remove_all(unzipped);
+        REQUIRE(translator.unzip_file(std::filesystem::absolute("../test_files/lorem-ipsum.docx").string(), unzipped));
+        const std::filesystem::path documentXml = std::filesystem::path(unzipped) / "word" / "document.xml";
+
+        std::vector<DocxTextNode> nodes;
+        REQUIRE(translator.extractTextNodesStreaming(documentXml.string(), nodes));
+        std::vector<std::string> texts;
+        for (const auto& node : nodes) {
+            texts.push_back(node.text);
+        }
+        REQUIRE_FALSE(texts.empty());
+        REQUIRE(texts == domTexts(documentXml));
+
+        // Without translations the rewritten document has the same text
+        REQUIRE(translator.rewriteDocumentStreaming(documentXml.string(), outputPath.string(), {}));
+        REQUIRE(domTexts(outputPath) == texts);
+
+        std::filesystem::remove_all(unzipped);
+    }
+
+    std::filesystem::remove(xmlPath);
+    std::filesystem::remove(outputPath);
+}
+
+TEST_CASE("DocxTranslator: text parts") {
+    TestableDocxTranslator translator;
+
+    const auto unzipped = std::filesystem::temp_directory_path() / "docx_text_parts";
+    std::filesystem::remove_all(unzipped);
+    std::filesystem::create_directories(unzipped / "word");
+
+    auto writeFile = [&](const std::string& name, const std::string& content) {
+        std::ofstream file(unzipped / name, std::ios::binary);
+        file << content;
+    };
+    auto wordPart = [](const std::string& root, const std::string& paragraphs) {
+        return "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+               "<w:" + root + " xmlns:w=\"http://schemas.openxmlformats.org/wordprocessingml/2006/main\">" +
+               paragraphs + "</w:" + root + ">";
+    };
+    const std::string wml = "application/vnd.openxmlformats-officedocument.wordprocessingml.";
+
+    writeFile("[Content_Types].xml",
+        "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+        "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+        "<Default Extension=\"xml\" ContentType=\"application/xml\"/>"
+        "<Override PartName=\"/word/header1.xml\" ContentType=\"" + wml + "header+xml\"/>"
+        "<Override PartName=\"/word/document.xml\" ContentType=\"" + wml + "document.main+xml\"/>"
+        "<Override PartName=\"/word/styles.xml\" ContentType=\"" + wml + "styles+xml\"/>"
+        "<Override PartName=\"/word/footer1.xml\" ContentType=\"" + wml + "footer+xml\"/>"
+        "<Override PartName=\"/word/footnotes.xml\" ContentType=\"" + wml + "footnotes+xml\"/>"
+        "<Override PartName=\"/word/../outside.xml\" ContentType=\"" + wml + "comments+xml\"/>"
+        "</Types>");
+    writeFile("word/document.xml", wordPart("document", "<w:body><w:p><w:r><w:t>本文</w:t></w:r></w:p><w:p><w:r><w:t>第一章</w:t></w:r></w:p></w:body>"));
+    writeFile("word/header1.xml", wordPart("hdr", "<w:p><w:r><w:t>第一章</w:t></w:r></w:p>"));
+    writeFile("word/footer1.xml", wordPart("ftr", "<w:p><w:r><w:t>第一章</w:t></w:r></w:p><w:p><w:r><w:t>頁</w:t></w:r></w:p>"));
+    writeFile("word/styles.xml", wordPart("styles", "<w:p><w:r><w:t>見出し</w:t></w:r></w:p>"));
+
+    SECTION("Parts come from [Content_Types].xml with the document first") {
+        // styles.xml has no text type, footnotes.xml is listed but missing, outside.xml is not under word/
+        REQUIRE(translator.findTextParts(unzipped.string()) == std::vector<std::string>{"word/document.xml", "word/header1.xml", "word/footer1.xml"});
+    }
+
+    SECTION("Without [Content_Types].xml only the document is translated") {
+        std::filesystem::remove(unzipped / "[Content_Types].xml");
+        REQUIRE(translator.findTextParts(unzipped.string()) == std::vector<std::string>{"word/document.xml"});
+    }
+
+    auto partTexts = [&](const std::string& name) {
+        xmlDocPtr doc = xmlReadFile((unzipped / name).string().c_str(), NULL, 0);
+        REQUIRE(doc != nullptr);
+        std::vector<std::string> texts;
+        for (const auto& node : translator.extractTextNodes(xmlDocGetRootElement(doc))) {
+            texts.push_back(node.text);
+        }
+        xmlFreeDoc(doc);
+        return texts;
+    };
+
+    auto translateParts = [&](bool streaming) {
+        translator.setStreamingXml(streaming);
+        translator.setPartThreads(3);
+
+        std::vector<DocxPart> parts;
+        for (const std::string& name : translator.findTextParts(unzipped.string())) {
+            DocxPart part;
+            part.name = name;
+            part.xmlPath = (unzipped / name).string();
+            parts.push_back(std::move(part));
+        }
+        REQUIRE(parts.size() == 3);
+
+        REQUIRE(translator.forEachPart(parts, [&](DocxPart& part) { return translator.extractPart(part); }));
+
+        // The chapter title in the header and footer is sent once
+        std::vector<std::string> batch = translator.buildTranslationBatch(parts);
+        REQUIRE(batch == std::vector<std::string>{"本文", "第一章", "頁"});
+        REQUIRE(parts[0].batchLines == std::vector<size_t>{0, 1});
+        REQUIRE(parts[1].batchLines == std::vector<size_t>{1});
+        REQUIRE(parts[2].batchLines == std::vector<size_t>{1, 2});
+
+        std::vector<std::string> batchTranslations = {"Body", "Chapter One", "Page"};
+        REQUIRE(translator.forEachPart(parts, [&](DocxPart& part) { return translator.writePart(part, batchTranslations); }));
+
+        REQUIRE(partTexts("word/document.xml") == std::vector<std::string>{"Body", "Chapter One"});
+        REQUIRE(partTexts("word/header1.xml") == std::vector<std::string>{"Chapter One"});
+        REQUIRE(partTexts("word/footer1.xml") == std::vector<std::string>{"Chapter One", "Page"});
+        REQUIRE(partTexts("word/styles.xml") == std::vector<std::string>{"見出し"});
+    };
+
+    SECTION("Segments are batched once and written back to every part") {
+        translateParts(false);
+    }
+
+    SECTION("Segments are batched once and written back to every part while streaming") {
+        translateParts(true);
+    }
+
+    SECTION("Parts above the streaming threshold are streamed without streaming turned on") {
+        // The body is the largest part, only it reaches the threshold
+        translator.setStreamingThreshold(std::filesystem::file_size(unzipped / "word/document.xml"));
+        translateParts(false);
+
+        std::vector<DocxPart> parts(2);
+        parts[0].name = "word/document.xml";
+        parts[0].xmlPath = (unzipped / parts[0].name).string();
+        parts[1].name = "word/header1.xml";
+        parts[1].xmlPath = (unzipped / parts[1].name).string();
+        REQUIRE(translator.forEachPart(parts, [&](DocxPart& part) { return translator.extractPart(part); }));
+        REQUIRE(parts[0].streaming);
+        REQUIRE(parts[0].doc == nullptr);
+        REQUIRE_FALSE(parts[1].streaming);
+        REQUIRE(parts[1].doc != nullptr);
+        xmlFreeDoc(parts[1].doc);
+    }
+
+    SECTION("Parts read into memory are rewritten in memory") {
+        for (bool streaming : {false, true}) {
+            translator.setStreamingXml(streaming);
+
+            std::vector<DocxPart> parts(1);
+            parts[0].name = "word/footer1.xml";
+            parts[0].xml = wordPart("ftr", "<w:p><w:r><w:t>第一章</w:t></w:r></w:p><w:p><w:r><w:t>頁</w:t></w:r></w:p>");
+
+            REQUIRE(translator.forEachPart(parts, [&](DocxPart& part) { return translator.extractPart(part); }));
+            REQUIRE(translator.buildTranslationBatch(parts) == std::vector<std::string>{"第一章", "頁"});
+            REQUIRE(translator.writePart(parts[0], {"Chapter One", "Page"}));
+
+            xmlDocPtr doc = xmlReadMemory(parts[0].xml.data(), static_cast<int>(parts[0].xml.size()), NULL, NULL, 0);
+            REQUIRE(doc != nullptr);
+            std::vector<std::string> texts;
+            for (const auto& node : translator.extractTextNodes(xmlDocGetRootElement(doc))) {
+                texts.push_back(node.text);
+            }
+            xmlFreeDoc(doc);
+            REQUIRE(texts == std::vector<std::string>{"Chapter One", "Page"});
+            // Nothing is written next to the unzipped parts
+            REQUIRE(partTexts("word/footer1.xml") == std::vector<std::string>{"第一章", "頁"});
+        }
+    }
+
+    SECTION("A part that fails to parse fails the run") {
+        writeFile("word/header1.xml", "<w:hdr xmlns:w=\"urn:w\"><w:p><w:t>text</w:t></w:hdr>");
+
+        std::vector<DocxPart> parts(2);
+        parts[0].name = "word/document.xml";
+        parts[0].xmlPath = (unzipped / parts[0].name).string();
+        parts[1].name = "word/header1.xml";
+        parts[1].xmlPath = (unzipped / parts[1].name).string();
+
+        REQUIRE_FALSE(translator.forEachPart(parts, [&](DocxPart& part) { return translator.extractPart(part); }));
+        for (DocxPart& part : parts) {
+            xmlFreeDoc(part.doc);
+        }
+    }
+
+    std::filesystem::remove_all(unzipped);
+}
+
+TEST_CASE("DocxTranslator: in-memory repack") {
+    TestableDocxTranslator translator;
+
+    const std::string inputDocx = std::filesystem::absolute("../test_files/lorem-ipsum.docx").string();
+    const std::string outputDocx = (std::filesystem::temp_directory_path() / "repacked.docx").string();
+
+    std::vector<DocxPart> parts;
+    REQUIRE(translator.readTextParts(inputDocx, parts));
+    REQUIRE_FALSE(parts.empty());
+    REQUIRE(parts[0].name == "word/document.xml");
+    REQUIRE(parts[0].xmlPath.empty());
+
+    REQUIRE(translator.forEachPart(parts, [&](DocxPart& part) { return translator.extractPart(part); }));
+    std::vector<std::string> batch = translator.buildTranslationBatch(parts);
+    REQUIRE_FALSE(batch.empty());
+    std::vector<std::string> batchTranslations(batch.size(), "Translated");
+    REQUIRE(translator.forEachPart(parts, [&](DocxPart& part) { return translator.writePart(part, batchTranslations); }));
+
+    REQUIRE(translator.repackDocx(inputDocx, outputDocx, parts));
+
+    zip_t* source = zip_open(inputDocx.c_str(), ZIP_RDONLY, nullptr);
+    zip_t* output = zip_open(outputDocx.c_str(), ZIP_RDONLY, nullptr);
+    REQUIRE(source != nullptr);
+    REQUIRE(output != nullptr);
+
+    // Same entries in the same order, only the text parts differ
+    REQUIRE(zip_get_num_entries(output, 0) == zip_get_num_entries(source, 0));
+    for (zip_int64_t i = 0; i < zip_get_num_entries(source, 0); ++i) {
+        zip_stat_t sourceStat;
+        zip_stat_t outputStat;
+        REQUIRE(zip_stat_index(source, i, 0, &sourceStat) == 0);
+        REQUIRE(zip_stat_index(output, i, 0, &outputStat) == 0);
+        REQUIRE(std::string(outputStat.name) == sourceStat.name);
+
+        bool replaced = std::any_of(parts.begin(), parts.end(), [&](const DocxPart& part) { return part.name == sourceStat.name; });
+        if (!replaced) {
+            // Copied raw: the compressed data is the same as in the source
+            REQUIRE(outputStat.comp_method == sourceStat.comp_method);
+            REQUIRE(outputStat.comp_size == sourceStat.comp_size);
+            REQUIRE(outputStat.crc == sourceStat.crc);
+        }
+    }
+
+    std::string documentXml;
+    REQUIRE(translator.readZipEntry(output, "word/document.xml", documentXml));
+    REQUIRE(documentXml == parts[0].xml);
+    REQUIRE(documentXml.find("Lorem ipsum") == std::string::npos);
+
+    zip_close(output);
+    zip_close(source);
+    std::filesystem::remove(outputDocx);
+}
+
 TEST_CASE("make_directory: Creates directories") {
     TestableDocxTranslator translator;
 
@@ -3,6 +3,7 @@
 #include "DocxTranslator.h"
 #include "HTMLTranslator.h"
 #include "GUI.h"
+#include "MockDeepLServer.h"
 #include <sys/stat.h>
 
 
@@ -37,6 +38,9 @@ public:
     using EpubTranslator::exportEpub;
     using EpubTranslator::removeUnwantedTags;
     using EpubTranslator::containsJapanese;
+    using EpubTranslator::translateDocumentsWithDeepL;
+    using EpubTranslator::handleDeepLTextRequest;
+    using EpubTranslator::handleDeepLRequest;
 };
 
 class TestableGUI : public GUI {
@@ -58,17 +62,29 @@ public:
     using PDFTranslator::processAndSplitText;
     using PDFTranslator::splitLongSentences;
     using PDFTranslator::splitJapaneseText;
+    using PDFTranslator::splitLongSentenceSpans;
+    using PDFTranslator::splitJapaneseSpans;
     using PDFTranslator::getUtf8CharLength;
     using PDFTranslator::convertPdfToImages;
+    using PDFTranslator::extractTextAndImagesFromPDF;
     using PDFTranslator::isImageAboveThreshold;
+    using PDFTranslator::isPixmapAboveThreshold;
+    using PDFTranslator::isPageImageCandidate;
+    using PDFTranslator::grayscaleStdDev;
     using PDFTranslator::createPDF;
     using PDFTranslator::createMuPDFContext;
+    using PDFTranslator::countPages;
     using PDFTranslator::extractTextFromPage;
     using PDFTranslator::pageContainsText;
     using PDFTranslator::extractTextFromBlocks;
     using PDFTranslator::extractTextFromLines;
     using PDFTranslator::extractTextFromChars;
     using PDFTranslator::processPDF;
+    using PDFTranslator::processPage;
+    using PDFTranslator::writePageImage;
+    using PDFTranslator::isPhotographic;
+    using PDFTranslator::flattenOntoWhite;
+    using PDFTranslator::loadImageSurface;
     using PDFTranslator::initCairoPdfSurface;
     using PDFTranslator::cleanupCairo;
     using PDFTranslator::collectImageFiles;
@@ -76,20 +92,37 @@ public:
     using PDFTranslator::addImagesToPdf;
     using PDFTranslator::configureTextRendering;
     using PDFTranslator::addTextToPdf;
+    using PDFTranslator::reflowLayout;
+    using PDFTranslator::readNumberedLines;
+    using PDFTranslator::createJobDirectory;
+    using PDFTranslator::translateSentencesLocally;
+    using PDFTranslator::extractTextBlocksFromPDF;
+    using PDFTranslator::createLayoutPreservingPDF;
 };
 
 class TestableDocxTranslator : public DocxTranslator {
     public:
         using DocxTranslator::unzip_file;
         using DocxTranslator::make_directory;
-        using DocxTranslator::getNodePath;
         using DocxTranslator::extractTextNodesRecursive;
         using DocxTranslator::extractTextNodes;
         using DocxTranslator::saveTextToFile;
         using DocxTranslator::loadTranslations;
         using DocxTranslator::updateNodeWithTranslation;
-        using DocxTranslator::traverseAndReinsert;
         using DocxTranslator::reinsertTranslations;
+        using DocxTranslator::extractTextNodesStreaming;
+        using DocxTranslator::rewriteDocumentStreaming;
+        using DocxTranslator::buildSegments;
+        using DocxTranslator::distributeTranslations;
+        using DocxTranslator::splitProportionally;
+        using DocxTranslator::findTextParts;
+        using DocxTranslator::extractPart;
+        using DocxTranslator::buildTranslationBatch;
+        using DocxTranslator::writePart;
+        using DocxTranslator::forEachPart;
+        using DocxTranslator::readZipEntry;
+        using DocxTranslator::readTextParts;
+        using DocxTranslator::repackDocx;
         using DocxTranslator::exportDocx;
         using DocxTranslator::escapeForDocx;
         using DocxTranslator::escapeTranslations;
@@ -0,0 +1,307 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+// Minimal stand-in for the DeepL document API, served over plain HTTP on
+// localhost. Uploaded documents report "translating" until they have been
+// polled pollsUntilDone times, and their result is the uploaded file with
+// translatedPrefix in front of it, or unchanged to mimic DeepL leaving the
+// Japanese alone. Status checks can be made to report
+// seconds_remaining or to fail with a 503 error page first. The /v2/translate
+// text endpoint answers every text with translatedPrefix in front of it.
+class MockDeepLServer {
+public:
+    static constexpr const char* translatedPrefix = "[translated] ";
+
+    explicit MockDeepLServer(int pollsUntilDone = 2)
+        : pollsUntilDone(pollsUntilDone), acceptor(io, boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0)) {
+        port = acceptor.local_endpoint().port();
+        acceptThread = std::thread([this]() { acceptLoop(); });
+    }
+
+    ~MockDeepLServer() {
+        stopping = true;
+
+        // Wake the blocking accept with a throwaway connection
+        boost::system::error_code ec;
+        boost::asio::ip::tcp::socket wake(io);
+        wake.connect(acceptor.local_endpoint(), ec);
+        acceptThread.join();
+        acceptor.close(ec);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& socket : sockets) {
+                socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+            }
+        }
+        for (auto& thread : connectionThreads) {
+            thread.join();
+        }
+    }
+
+    std::string documentUrl() const {
+        return "http://127.0.0.1:" + std::to_string(port) + "/v2/document";
+    }
+
+    size_t uploadCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return documents.size();
+    }
+
+    size_t peakTranslating() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return peak;
+    }
+
+    std::string translateUrl() const {
+        return "http://127.0.0.1:" + std::to_string(port) + "/v2/translate";
+    }
+
+    size_t translateRequestCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return translateRequests;
+    }
+
+    size_t largestTranslateBatch() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return largestBatch;
+    }
+
+    size_t largestTranslateBody() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return largestBody;
+    }
+
+    void setReturnDocumentsUnchanged(bool unchanged) {
+        std::lock_guard<std::mutex> lock(mutex);
+        returnDocumentsUnchanged = unchanged;
+    }
+
+    void setSecondsRemaining(double seconds) {
+        std::lock_guard<std::mutex> lock(mutex);
+        secondsRemaining = seconds;
+    }
+
+    void failNextStatusChecks(int count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        statusFailures = count;
+    }
+
+    size_t statusCheckCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return statusChecks;
+    }
+
+    size_t connectionCount() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return sockets.size();
+    }
+
+private:
+    struct Document {
+        std::string key;
+        std::string content;
+        int polls = 0;
+        bool done = false;
+    };
+
+    struct Request {
+        std::string method;
+        std::string target;
+        std::map<std::string, std::string> headers;
+        std::string body;
+    };
+
+    void acceptLoop() {
+        while (true) {
+            auto socket = std::make_shared<boost::asio::ip::tcp::socket>(io);
+            boost::system::error_code ec;
+            acceptor.accept(*socket, ec);
+            if (stopping || ec) {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            sockets.push_back(socket);
+            connectionThreads.emplace_back([this, socket]() { serveConnection(*socket); });
+        }
+    }
+
+    static std::string lower(std::string value) {
+        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return value;
+    }
+
+    bool readRequest(boost::asio::ip::tcp::socket& socket, boost::asio::streambuf& buffer, Request& request) {
+        boost::system::error_code ec;
+        boost::asio::read_until(socket, buffer, "\r\n\r\n", ec);
+        if (ec) {
+            return false;
+        }
+
+        std::istream stream(&buffer);
+        std::string line;
+        std::getline(stream, line);
+        std::istringstream requestLine(line);
+        requestLine >> request.method >> request.target;
+
+        while (std::getline(stream, line) && line != "\r") {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            std::string value = line.substr(colon + 1);
+            value.erase(0, value.find_first_not_of(' '));
+            if (!value.empty() && value.back() == '\r') value.pop_back();
+            request.headers[lower(line.substr(0, colon))] = value;
+        }
+
+        if (lower(request.headers["expect"]) == "100-continue") {
+            boost::asio::write(socket, boost::asio::buffer(std::string("HTTP/1.1 100 Continue\r\n\r\n")), ec);
+        }
+
+        size_t contentLength = request.headers.count("content-length") ? std::stoul(request.headers["content-length"]) : 0;
+        if (buffer.size() < contentLength) {
+            boost::asio::read(socket, buffer, boost::asio::transfer_exactly(contentLength - buffer.size()), ec);
+            if (ec) {
+                return false;
+            }
+        }
+        request.body.resize(contentLength);
+        stream.read(&request.body[0], contentLength);
+        return true;
+    }
+
+    void serveConnection(boost::asio::ip::tcp::socket& socket) {
+        boost::asio::streambuf buffer;
+        Request request;
+        // Keep-alive: serve requests until the client hangs up
+        while (readRequest(socket, buffer, request)) {
+            int statusCode = 200;
+            std::string body = route(request, statusCode);
+
+            std::string response = "HTTP/1.1 " + std::to_string(statusCode) + (statusCode == 200 ? " OK" : statusCode == 400 ? " Bad Request" : statusCode == 404 ? " Not Found" : " Service Unavailable") + "\r\n"
+                "Content-Type: application/json\r\n"
+                "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+
+            boost::system::error_code ec;
+            boost::asio::write(socket, boost::asio::buffer(response), ec);
+            if (ec) {
+                return;
+            }
+            request = Request();
+        }
+    }
+
+    static std::string extractUploadedFile(const std::string& body) {
+        size_t part = body.find("name=\"file\"");
+        if (part == std::string::npos) return "";
+        size_t start = body.find("\r\n\r\n", part);
+        if (start == std::string::npos) return "";
+        start += 4;
+        size_t end = body.find("\r\n--", start);
+        return body.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    }
+
+    std::string translateTexts(const Request& request, int& statusCode) {
+        nlohmann::json payload = nlohmann::json::parse(request.body, nullptr, false);
+        if (payload.is_discarded() || !payload.contains("text") || !payload["text"].is_array() || payload.value("tag_handling", "") != "html") {
+            statusCode = 400;
+            return "{\"message\":\"Bad request\"}";
+        }
+
+        translateRequests++;
+        largestBatch = std::max(largestBatch, payload["text"].size());
+        largestBody = std::max(largestBody, request.body.size());
+
+        nlohmann::json response;
+        response["translations"] = nlohmann::json::array();
+        for (const auto& text : payload["text"]) {
+            response["translations"].push_back({{"detected_source_language", "JA"}, {"text", translatedPrefix + text.get<std::string>()}});
+        }
+        return response.dump();
+    }
+
+    std::string route(const Request& request, int& statusCode) {
+        const std::string prefix = "/v2/document";
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (request.method == "POST" && request.target == "/v2/translate") {
+            return translateTexts(request, statusCode);
+        }
+
+        if (request.method != "POST" || request.target.compare(0, prefix.size(), prefix) != 0) {
+            statusCode = 404;
+            return "{\"message\":\"Not found\"}";
+        }
+
+        std::string rest = request.target.substr(prefix.size());
+        if (rest.empty()) {
+            std::string id = "doc" + std::to_string(documents.size());
+            Document& document = documents[id];
+            document.key = "key" + id;
+            document.content = extractUploadedFile(request.body);
+            translating++;
+            peak = std::max(peak, translating);
+            return "{\"document_id\":\"" + id + "\",\"document_key\":\"" + document.key + "\"}";
+        }
+
+        bool wantsResult = rest.size() > 7 && rest.compare(rest.size() - 7, 7, "/result") == 0;
+        std::string id = rest.substr(1, wantsResult ? rest.size() - 8 : std::string::npos);
+        auto it = documents.find(id);
+        if (it == documents.end()) {
+            statusCode = 404;
+            return "{\"message\":\"Document not found\"}";
+        }
+
+        Document& document = it->second;
+        if (wantsResult) {
+            return returnDocumentsUnchanged ? document.content : translatedPrefix + document.content;
+        }
+
+        statusChecks++;
+        if (statusFailures > 0) {
+            statusFailures--;
+            statusCode = 503;
+            return "<html><body>Service Unavailable</body></html>";
+        }
+
+        if (!document.done && ++document.polls >= pollsUntilDone) {
+            document.done = true;
+            translating--;
+        }
+        std::string remaining = (!document.done && secondsRemaining >= 0) ? ",\"seconds_remaining\":" + std::to_string(secondsRemaining) : "";
+        return "{\"document_id\":\"" + id + "\",\"status\":\"" + (document.done ? "done" : "translating") + "\"" + remaining + "}";
+    }
+
+    int pollsUntilDone;
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::acceptor acceptor;
+    unsigned short port = 0;
+    std::atomic<bool> stopping{false};
+    std::thread acceptThread;
+
+    std::mutex mutex;
+    std::vector<std::shared_ptr<boost::asio::ip::tcp::socket>> sockets;
+    std::vector<std::thread> connectionThreads;
+    std::map<std::string, Document> documents;
+    size_t translating = 0;
+    size_t peak = 0;
+    double secondsRemaining = -1;
+    bool returnDocumentsUnchanged = false;
+    int statusFailures = 0;
+    size_t statusChecks = 0;
+    size_t translateRequests = 0;
+    size_t largestBatch = 0;
+    size_t largestBody = 0;
+};
@@ -122,6 +122,45 @@ def run_model(input_file_path="rawTags.txt", chapter_num_mode=0):
     print(f"Processed {len(results)} results.", flush=True)
     return results
 
+def run_stream():
+    """Translate "chapter,position,text" lines from stdin as they arrive.
+
+    The caller keeps this process running while it is still discovering
+    segments, so the model is only loaded once and stays busy. Each result is
+    written straight back as "RESULT,chapter,position,translation", a segment
+    that could not be translated as "FAILED,chapter,position".
+    """
+    print("Starting streaming processing.", flush=True)
+    stdin = io.TextIOWrapper(sys.stdin.buffer, encoding="utf-8")
+
+    processed = 0
+    for line in stdin:
+        parts = line.rstrip("\r\n").split(",", 2)
+        if len(parts) < 3:
+            continue
+
+        chapter_num, position, text = parts
+        try:
+            with torch.no_grad():
+                encoded_data = tokenizer(text, return_tensors="pt")
+                generated = model.generate(
+                    **encoded_data,
+                    **params
+                )
+                translated_text = tokenizer.decode(generated[0], skip_special_tokens=True)
+            translated_text = translated_text.encode('utf-8', errors='replace').decode('utf-8')
+            translated_text = translated_text.replace("\r", " ").replace("\n", " ")
+        except Exception as e:
+            print(f"Error processing task: {parts}, Details: {e}", flush=True)
+            print(f"FAILED,{chapter_num},{position}", flush=True)
+            continue
+
+        print(f"RESULT,{chapter_num},{position},{translated_text}", flush=True)
+        processed += 1
+
+    print(f"Processed {processed} results.", flush=True)
+    return 0
+
 def main(input_file_path="rawTags.txt", chapter_num_mode=0):
     """Main function to handle file input/output."""
     print("Starting sequential processing.", flush=True)
@@ -147,7 +186,7 @@ if __name__ == "__main__":
 
     # Ensure proper usage
     if len(sys.argv) != 3:
-        print("Usage: translation.py <input_file_path> <chapter_num_mode>", flush=True)
+        print("Usage: translation.py <input_file_path|-> <chapter_num_mode>", flush=True)
         sys.exit(1)
 
     input_file_path = str(sys.argv[1])
@@ -161,5 +200,9 @@ if __name__ == "__main__":
     print("Translation parameters:", json.dumps(params, indent=4), flush=True)
     print(providers, flush=True)
     print(sess_options, flush=True)
+    # Mode 2 reads segments from stdin instead of input_file_path
+    if chapter_num_mode == 2:
+        sys.exit(run_stream())
+
     # Run the main function
     sys.exit(main(input_file_path, chapter_num_mode))